@@ -0,0 +1,235 @@
+/*
+ * AutoTuner.cpp
+ *
+ *  Auto-tuning of the tiled engines.
+ */
+
+#include "AutoTuner.h"
+#include "EdgeFilters.h"
+#include "ImageGenerator.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <tbb/tick_count.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+using namespace std;
+using namespace tbb;
+
+static const char *classNames[TUNE_CLASS_COUNT] = {"small", "medium", "large"};
+static const int classSizes[TUNE_CLASS_COUNT][2] = {{768, 768}, {2048, 2048}, {4096, 4096}};
+
+static const int tuneCutoffs[] = {16, 32, 64, 128, 256, 512};
+static const int tuneAspects[] = {0, 1, 2, 4, 8};
+static const int tuneOrders[] = {TILE_ORDER_RECURSIVE, TILE_ORDER_ROWS};
+
+
+string tuner_cpu_model()
+{
+	string model;
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	unsigned int regs[12];
+	memset(regs, 0, sizeof(regs));
+	for (unsigned int leaf = 0; leaf < 3; leaf++) {
+#if defined(_MSC_VER)
+		__cpuid((int *)&regs[4 * leaf], 0x80000002 + leaf);
+#else
+		__get_cpuid(0x80000002 + leaf, &regs[4 * leaf], &regs[4 * leaf + 1], &regs[4 * leaf + 2], &regs[4 * leaf + 3]);
+#endif
+	}
+	model.assign((const char *)regs, strnlen((const char *)regs, sizeof(regs)));
+#else
+	ifstream cpuinfo("/proc/cpuinfo");
+	string line;
+	while (getline(cpuinfo, line)) {
+		if (line.compare(0, 10, "model name") == 0 && line.find(':') != string::npos) {
+			model = line.substr(line.find(':') + 1);
+			break;
+		}
+	}
+#endif
+
+	// trim and drop tabs, tabs separate profile fields
+	replace(model.begin(), model.end(), '\t', ' ');
+	size_t first = model.find_first_not_of(' ');
+	size_t last = model.find_last_not_of(' ');
+	if (first == string::npos) return "unknown";
+	return model.substr(first, last - first + 1);
+}
+
+int tuner_size_class(long long pixels)
+{
+	if (pixels < (1LL << 20)) return TUNE_CLASS_SMALL;
+	if (pixels < (16LL << 20)) return TUNE_CLASS_MEDIUM;
+	return TUNE_CLASS_LARGE;
+}
+
+string tuner_profile_path()
+{
+	const char *path = getenv("EDGE_TUNING_PROFILE");
+	return path != NULL && path[0] ? path : TUNE_DEFAULT_PROFILE;
+}
+
+/**
+* @brief Median time in ms of Prewitt plus edge detection with current globals.
+*/
+static double tuner_measure(int engine, const vector<int> &image, vector<int> &work, vector<int> &out, int width, int height, int repetitions)
+{
+	vector<double> times;
+
+	for (int r = 0; r < repetitions; r++) {
+		work = image;
+		tick_count startCount = tick_count::now();
+		filter_prewitt(engine, &work[0], &out[0], width, height);
+		filter_edge_detection(engine, &work[0], &out[0], width, height);
+		times.push_back((tick_count::now() - startCount).seconds() * 1000);
+	}
+
+	sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+void tuner_run(TuneProfile &profile, int engine, int repetitions)
+{
+	int savedCutoff = CUTOFF, savedAspect = TILE_ASPECT, savedOrder = TILE_ORDER;
+
+	profile.cpu = tuner_cpu_model();
+	profile.engine = engine;
+	if (repetitions < 1) repetitions = 1;
+
+	for (int c = 0; c < TUNE_CLASS_COUNT; c++) {
+		int width = classSizes[c][0], height = classSizes[c][1];
+		vector<int> image((size_t)width * height), work, out(image.size());
+		TuneConfig &best = profile.configs[c];
+
+		generate_image(&image[0], width, height, width, GEN_MIXED, GEN_DEFAULT_SEED);
+		best.valid = false;
+
+		for (int cutoff : tuneCutoffs) {
+			if (cutoff > height) continue;
+			for (int aspect : tuneAspects) {
+				for (int order : tuneOrders) {
+					CUTOFF = cutoff;
+					TILE_ASPECT = aspect;
+					TILE_ORDER = order;
+
+					// warm-up run, then timed runs
+					tuner_measure(engine, image, work, out, width, height, 1);
+					double ms = tuner_measure(engine, image, work, out, width, height, repetitions);
+
+					if (!best.valid || ms < best.ms) {
+						best.valid = true;
+						best.cutoff = cutoff;
+						best.tileAspect = aspect;
+						best.tileOrder = order;
+						best.ms = ms;
+					}
+				}
+			}
+		}
+
+		cout << "Tuned " << classNames[c] << " (" << width << "x" << height << "): CUTOFF=" << best.cutoff;
+		cout << " aspect=" << best.tileAspect << " order=" << (best.tileOrder == TILE_ORDER_ROWS ? "rows" : "recursive");
+		cout << " " << best.ms << " ms" << endl;
+	}
+
+	CUTOFF = savedCutoff;
+	TILE_ASPECT = savedAspect;
+	TILE_ORDER = savedOrder;
+}
+
+static int class_from_name(const string &name)
+{
+	for (int c = 0; c < TUNE_CLASS_COUNT; c++) {
+		if (name == classNames[c]) return c;
+	}
+	return -1;
+}
+
+bool tuner_save_profile(const char *path, const TuneProfile &profile)
+{
+	vector<string> kept;
+	string line;
+
+	// keep entries of other machines and engines
+	string prefix = profile.cpu + '\t' + engine_name(profile.engine) + '\t';
+	ifstream in(path);
+	while (getline(in, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		if (line.compare(0, prefix.size(), prefix) != 0) kept.push_back(line);
+	}
+	in.close();
+
+	ofstream out(path);
+	if (!out) {
+		cout << "ERROR: cannot write tuning profile " << path << endl;
+		return false;
+	}
+
+	out << "# cpu\tengine\tclass\tcutoff\taspect\torder\tms" << endl;
+	for (size_t k = 0; k < kept.size(); k++) out << kept[k] << endl;
+	for (int c = 0; c < TUNE_CLASS_COUNT; c++) {
+		const TuneConfig &config = profile.configs[c];
+		if (!config.valid) continue;
+		out << profile.cpu << '\t' << engine_name(profile.engine) << '\t' << classNames[c] << '\t' << config.cutoff << '\t' << config.tileAspect << '\t';
+		out << (config.tileOrder == TILE_ORDER_ROWS ? "rows" : "recursive") << '\t' << config.ms << endl;
+	}
+
+	return true;
+}
+
+bool tuner_load_profile(const char *path, int engine, TuneProfile &profile)
+{
+	bool found = false;
+	string line;
+
+	profile.cpu = tuner_cpu_model();
+	profile.engine = engine;
+	for (int c = 0; c < TUNE_CLASS_COUNT; c++) profile.configs[c].valid = false;
+
+	ifstream in(path);
+	while (getline(in, line)) {
+		if (line.empty() || line[0] == '#') continue;
+
+		vector<string> fields;
+		stringstream stream(line);
+		string field;
+		while (getline(stream, field, '\t')) fields.push_back(field);
+		// entries without an engine column were tuned for an unknown engine
+		if (fields.size() < 6 || fields[0] != profile.cpu || engine_from_name(fields[1].c_str()) != engine) continue;
+
+		int c = class_from_name(fields[2]);
+		if (c < 0) continue;
+
+		TuneConfig &config = profile.configs[c];
+		config.cutoff = atoi(fields[3].c_str());
+		config.tileAspect = atoi(fields[4].c_str());
+		config.tileOrder = fields[5] == "rows" ? TILE_ORDER_ROWS : TILE_ORDER_RECURSIVE;
+		config.ms = fields.size() > 6 ? atof(fields[6].c_str()) : 0;
+		config.valid = config.cutoff > 0 && config.tileAspect >= 0;
+		found = found || config.valid;
+	}
+
+	return found;
+}
+
+bool tuner_apply(const TuneProfile &profile, long long pixels)
+{
+	const TuneConfig &config = profile.configs[tuner_size_class(pixels)];
+	if (!config.valid) return false;
+
+	CUTOFF = config.cutoff;
+	TILE_ASPECT = config.tileAspect;
+	TILE_ORDER = config.tileOrder;
+	return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * AutoTuner.h
+ *
+ *  Auto-tuning of the tiled engines. Sweeps CUTOFF (tile height / grain),
+ *  TILE_ASPECT and TILE_ORDER on synthetic images of every size class and
+ *  keeps the fastest configuration per size class, CPU model and engine in
+ *  a profile file that is loaded at startup.
+ *
+ *  Profile file: one tab separated line per entry,
+ *    cpu model | engine | size class | cutoff | aspect | order | milliseconds
+ *  entries of other CPU models and engines are kept, so one file can serve
+ *  a heterogeneous cluster; a run only uses entries of its own engine.
+ */
+
+#ifndef AUTOTUNER_H_
+#define AUTOTUNER_H_
+
+#include <string>
+
+#define TUNE_CLASS_SMALL		0		// below 1 MP
+#define TUNE_CLASS_MEDIUM		1		// below 16 MP
+#define TUNE_CLASS_LARGE		2
+#define TUNE_CLASS_COUNT		3
+
+#define TUNE_DEFAULT_PROFILE	"edge_tuning.profile"
+
+struct TuneConfig {
+	bool valid;
+	int cutoff;
+	int tileAspect;
+	int tileOrder;
+	double ms;
+};
+
+struct TuneProfile {
+	std::string cpu;
+	int engine;						// engine the entries were tuned with
+	TuneConfig configs[TUNE_CLASS_COUNT];
+};
+
+/**
+* @brief CPU model string, from cpuid brand string or /proc/cpuinfo
+*/
+std::string tuner_cpu_model();
+
+/**
+* @brief Size class of an image with given number of pixels
+*/
+int tuner_size_class(long long pixels);
+
+/**
+* @brief Profile path, EDGE_TUNING_PROFILE environment variable or TUNE_DEFAULT_PROFILE
+*/
+std::string tuner_profile_path();
+
+/**
+* @brief Sweeps all configurations for every size class and stores the best ones.
+*
+* @param profile filled for the current CPU
+* @param engine tiled engine to tune (ENGINE_TILED or ENGINE_SIMD_TILED)
+* @param repetitions timed runs per configuration, median is used
+*/
+void tuner_run(TuneProfile &profile, int engine, int repetitions);
+
+/**
+* @brief Writes profile, replacing earlier entries of the same CPU model and engine.
+*/
+bool tuner_save_profile(const char *path, const TuneProfile &profile);
+
+/**
+* @brief Loads entries of the current CPU model and given engine from profile file.
+*
+* @return false if file is missing or holds nothing for this CPU and engine
+*/
+bool tuner_load_profile(const char *path, int engine, TuneProfile &profile);
+
+/**
+* @brief Sets CUTOFF, TILE_ASPECT and TILE_ORDER for an image of given size.
+*
+* @return false if profile has no entry for the size class
+*/
+bool tuner_apply(const TuneProfile &profile, long long pixels);
+
+#endif /* AUTOTUNER_H_ */
@@ -0,0 +1,208 @@
+/*
+ * BatchProcessor.cpp
+ *
+ *  Batch mode: many images processed concurrently in one process.
+ */
+
+#include "BatchProcessor.h"
+#include "BitmapRawConverter.h"
+#include "EdgeFilters.h"
+#include "EdgeEngine.h"
+#include "ImageGenerator.h"
+#include "ImageProbe.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/tick_count.h>
+#include <tbb/info.h>
+
+using namespace std;
+using namespace tbb;
+namespace fs = std::filesystem;
+
+struct BatchResult {
+	bool ok;
+	long long pixels;
+};
+
+
+static bool has_image_extension(const fs::path &path)
+{
+	string ext = path.extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".bmp" || ext == ".qog";
+}
+
+static string output_name(const BatchOptions &options, const string &input)
+{
+	string suffix = options.op == OP_PREWITT ? "_prewitt" : "_edge";
+	string stem = fs::path(input).stem().string();
+	// generator specs (gen:edges:640x480) are not valid file names everywhere
+	replace(stem.begin(), stem.end(), ':', '_');
+	fs::path out = fs::path(options.outputDir) / (stem + suffix + options.extension);
+	return out.string();
+}
+
+void batch_default_options(BatchOptions &options)
+{
+	options.outputDir = ".";
+	options.extension = ".bmp";
+	options.op = OP_PREWITT;
+	options.maxInFlight = 2 * info::default_concurrency();
+	options.tilePixels = 1 << 20;
+}
+
+/**
+* @brief Probes the inputs and orders jobs by size class, largest first. Inside a
+* class larger images go first, ties keep their order.
+*/
+static void batch_order_jobs(vector<BatchJob> &jobs)
+{
+	vector<string> inputs(jobs.size());
+	for (size_t k = 0; k < jobs.size(); k++) inputs[k] = jobs[k].input;
+
+	vector<ImageInfo> infos;
+	probe_images(inputs, infos);
+	for (size_t k = 0; k < jobs.size(); k++) {
+		jobs[k].pixels = infos[k].valid ? infos[k].pixels : 0;
+		jobs[k].sizeClass = probe_size_class(jobs[k].pixels);
+	}
+
+	stable_sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b) {
+		if (a.sizeClass != b.sizeClass) return a.sizeClass > b.sizeClass;
+		return a.pixels > b.pixels;
+	});
+}
+
+bool batch_collect_jobs(const BatchOptions &options, vector<BatchJob> &jobs)
+{
+	error_code ec;
+
+	if (fs::is_directory(options.input, ec)) {
+		for (fs::directory_iterator it(options.input, ec), end; !ec && it != end; it.increment(ec)) {
+			if (!it->is_regular_file() || !has_image_extension(it->path())) continue;
+			BatchJob job;
+			job.input = it->path().string();
+			job.output = output_name(options, job.input);
+			jobs.push_back(job);
+		}
+		sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b) { return a.input < b.input; });
+		batch_order_jobs(jobs);
+		return !ec;
+	}
+
+	ifstream manifest(options.input.c_str());
+	if (!manifest) {
+		cout << "ERROR: cannot open batch input " << options.input << endl;
+		return false;
+	}
+
+	string line;
+	while (getline(manifest, line)) {
+		istringstream fields(line);
+		BatchJob job;
+		if (!(fields >> job.input) || job.input[0] == '#') continue;
+		if (!(fields >> job.output)) job.output = output_name(options, job.input);
+		jobs.push_back(job);
+	}
+	batch_order_jobs(jobs);
+	return true;
+}
+
+/**
+* @brief Decodes, filters and encodes one image. Runs inside a pipeline token,
+* big images spawn tile tasks in the same arena as the tokens.
+*/
+static BatchResult batch_process_job(EdgeEngine &engine, const BatchOptions &options, const BatchJob &job)
+{
+	BatchResult result = {false, 0};
+
+	error_code ec;
+	int pattern, genWidth, genHeight;
+	unsigned long long seed;
+	bool generated = generator_parse_spec(job.input.c_str(), &pattern, &genWidth, &genHeight, &seed);
+	if (!generated && !fs::is_regular_file(job.input, ec)) {
+		cout << "ERROR: cannot open " << job.input << endl;
+		return result;
+	}
+
+	BitmapRawConverter image((char *)job.input.c_str());
+	if (!image.isLoaded()) {
+		cout << "ERROR: cannot decode " << job.input << endl;
+		return result;
+	}
+	int width = image.getWidth();
+	int height = image.getHeight();
+	long long pixels = (long long)width * height;
+
+	// output buffers come from the size class pool, images of one class run
+	// next to each other and take the blocks the previous ones returned
+	int *outBuffer = pool_alloc_image(width, height);
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		engine.run(options.op, image.getBuffer(), outBuffer, width, height);
+	}
+
+	image.setBuffer(outBuffer);
+	result.ok = image.pixelsToFile((char *)job.output.c_str());
+	pool_free_image(outBuffer, width, height);
+	if (!result.ok) cout << "ERROR: cannot write " << job.output << endl;
+
+	result.pixels = pixels;
+	return result;
+}
+
+void batch_run(const BatchOptions &options, const vector<BatchJob> &jobs, BatchReport &report)
+{
+	report.images = 0;
+	report.failed = 0;
+	report.megapixels = 0;
+
+	size_t next = 0;
+	EdgeEngine engine;
+	engine.setSerialPixels(options.tilePixels);
+	// tiles and tokens share one scheduler, a token waiting for its tiles helps with others
+	engine.setCallerArena(true);
+	tick_count startCount = tick_count::now();
+
+	parallel_pipeline(max(1, options.maxInFlight),
+		make_filter<void, size_t>(filter_mode::serial_in_order, [&](flow_control &fc) -> size_t {
+			if (next >= jobs.size()) {
+				fc.stop();
+				return 0;
+			}
+			return next++;
+		}) &
+		make_filter<size_t, BatchResult>(filter_mode::parallel, [&](size_t k) {
+			return batch_process_job(engine, options, jobs[k]);
+		}) &
+		make_filter<BatchResult, void>(filter_mode::serial_out_of_order, [&](BatchResult result) {
+			if (!result.ok) {
+				report.failed++;
+				return;
+			}
+			report.images++;
+			report.megapixels += result.pixels / 1e6;
+		})
+	);
+
+	report.seconds = (tick_count::now() - startCount).seconds();
+	// not while tokens run: they return blocks the next images of their class take,
+	// the class and total limits of the pool bound what is kept until here
+	pool_trim();
+}
+
+void batch_print_report(const BatchReport &report)
+{
+	double seconds = report.seconds > 0 ? report.seconds : 1e-9;
+
+	cout << "Batch: " << report.images << " images";
+	if (report.failed) cout << " (" << report.failed << " failed)";
+	cout << ", " << report.megapixels << " MP in " << report.seconds * 1000 << " ms." << endl;
+	cout << "Throughput: " << report.images / seconds << " images/s, " << report.megapixels / seconds << " MP/s." << endl;
+}
@@ -0,0 +1,65 @@
+/*
+ * BatchProcessor.h
+ *
+ *  Batch mode: many images processed concurrently in one process.
+ *  Images flow through a tbb::parallel_pipeline whose token count bounds
+ *  the number of decoded images held in memory. Large images are filtered
+ *  tile by tile, small ones as a single task, all on the same scheduler.
+ */
+
+#ifndef BATCHPROCESSOR_H_
+#define BATCHPROCESSOR_H_
+
+#include <string>
+#include <vector>
+#include "EdgeFilters.h"
+
+struct BatchJob {
+	std::string input;
+	std::string output;
+	long long pixels;				// from the header, 0 if it cannot be read
+	int sizeClass;					// probe_size_class of pixels
+};
+
+struct BatchOptions {
+	std::string input;				// directory or manifest file
+	std::string outputDir;
+	std::string extension;			// ".bmp" or ".qog"
+	int op;
+	int maxInFlight;
+	long long tilePixels;			// images with at least this many pixels are tiled
+};
+
+struct BatchReport {
+	int images;
+	int failed;
+	double megapixels;
+	double seconds;
+};
+
+/**
+* @brief Fills options with default values (in-flight limit follows thread count).
+*/
+void batch_default_options(BatchOptions &options);
+
+/**
+* @brief Collects jobs from a directory (every .bmp and .qog file) or a manifest
+* (one "input [output]" pair per line, # starts a comment). Headers of all
+* inputs are probed in parallel, jobs are ordered by size class, largest first,
+* so the biggest images start early and images of one class run together.
+*
+* @return false if input cannot be read
+*/
+bool batch_collect_jobs(const BatchOptions &options, std::vector<BatchJob> &jobs);
+
+/**
+* @brief Runs all jobs and fills the report.
+*/
+void batch_run(const BatchOptions &options, const std::vector<BatchJob> &jobs, BatchReport &report);
+
+/**
+* @brief Prints throughput summary of a batch run.
+*/
+void batch_print_report(const BatchReport &report);
+
+#endif /* BATCHPROCESSOR_H_ */
@@ -0,0 +1,357 @@
+/*
+ * Benchmark.cpp
+ *
+ *  Benchmark suite and baseline comparison.
+ */
+
+#include "Benchmark.h"
+#include "EdgeFilters.h"
+#include "ImageBuffer.h"
+#include "AutoTuner.h"
+#include "ImageGenerator.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <math.h>
+#include <tbb/tick_count.h>
+#include <tbb/global_control.h>
+#include <tbb/info.h>
+
+using namespace std;
+using namespace tbb;
+
+
+static const char *op_name(int op)
+{
+	return op == OP_PREWITT ? "prewitt" : "edge";
+}
+
+static bool single_threaded(int engine)
+{
+	return engine == ENGINE_SERIAL || engine == ENGINE_SIMD;
+}
+
+void bench_default_config(BenchConfig &config)
+{
+	int cores = info::default_concurrency();
+
+	config.megapixels = {1, 4, 16};
+	config.aspects = {1, 4.0 / 3};
+	config.cutoffs = {64, 200};
+	config.distances = {1, 2};
+	config.kernels = {3, 7};
+	config.threads = {1};
+	if (cores > 1) config.threads.push_back(cores);
+	config.engines.clear();
+	for (int engine = 0; engine < ENGINE_COUNT; engine++) config.engines.push_back(engine);
+	config.ops = {OP_PREWITT, OP_EDGE};
+	config.repetitions = 5;
+	config.warmup = 1;
+	config.referenceMegapixels = 4;
+	config.pattern = GEN_MIXED;
+	config.seed = GEN_DEFAULT_SEED;
+	config.counters = false;
+}
+
+BenchResult bench_measure(int op, int engine, const vector<int> &image, ImageBuffer &in, ImageBuffer &out, int warmup, int repetitions, PerfCounters *counters)
+{
+	BenchResult result;
+	vector<double> times;
+	double counted[PERF_COUNTER_COUNT] = {0};
+
+	for (int r = 0; r < warmup + max(1, repetitions); r++) {
+		bool timed = r >= warmup;
+		image_buffer_load(in, &image[0]);
+		if (timed && counters != NULL) counters->start();
+		tick_count startCount = tick_count::now();
+		image_filter(op, engine, in, out);
+		double ms = (tick_count::now() - startCount).seconds() * 1000;
+		if (timed && counters != NULL) {
+			counters->stop();
+			for (int c = 0; c < PERF_COUNTER_COUNT; c++) counted[c] += counters->value(c);
+		}
+		if (timed) times.push_back(ms);
+	}
+
+	sort(times.begin(), times.end());
+	size_t p95 = (size_t)ceil(0.95 * times.size());
+
+	result.op = op;
+	result.engine = engine;
+	result.width = in.width;
+	result.height = in.height;
+	result.samples = (int)times.size();
+	result.medianMs = times[times.size() / 2];
+	result.p95Ms = times[max((size_t)1, p95) - 1];
+	result.minMs = times[0];
+	result.megapixelsPerSecond = (double)in.width * in.height / 1e6 / (result.medianMs / 1000);
+	result.cutoff = CUTOFF;
+	result.distance = DISTANCE;
+	result.kernel = FILTER_SIZE;
+	result.threads = 0;
+
+	double pixelRuns = (double)in.width * in.height * times.size();
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		bool measured = counters != NULL && counters->value(c) >= 0;
+		result.counters[c] = measured ? counted[c] / pixelRuns : -1;
+	}
+	return result;
+}
+
+static void bench_print_result(const BenchResult &result)
+{
+	cout << op_name(result.op) << " " << engine_name(result.engine) << " " << result.width << "x" << result.height;
+	cout << " cutoff=" << result.cutoff << " threads=" << result.threads;
+	if (result.op == OP_PREWITT) cout << " kernel=" << result.kernel;
+	else cout << " distance=" << result.distance;
+	cout << ": median " << result.medianMs << " ms, p95 " << result.p95Ms << " ms, ";
+	cout << result.megapixelsPerSecond << " MP/s";
+	if (result.counters[PERF_CYCLES] >= 0) {
+		cout << " | cycles/px " << result.counters[PERF_CYCLES];
+		if (result.counters[PERF_INSTRUCTIONS] > 0) cout << ", IPC " << result.counters[PERF_INSTRUCTIONS] / result.counters[PERF_CYCLES];
+	}
+	cout << endl;
+}
+
+void bench_run(const BenchConfig &config, vector<BenchResult> &results)
+{
+	int savedCutoff = CUTOFF, savedDistance = DISTANCE, savedKernel = FILTER_SIZE;
+
+	PerfCounters *counters = NULL;
+	if (config.counters) {
+		counters = new PerfCounters();
+		if (!counters->available()) {
+			cout << "Hardware counters unavailable: " << counters->error() << ", measuring time only." << endl;
+			delete counters;
+			counters = NULL;
+		}
+	}
+
+	for (double megapixels : config.megapixels) {
+		for (double aspect : config.aspects) {
+			double pixels = megapixels * 1e6;
+			int height = max(1, (int)lround(sqrt(pixels / aspect)));
+			int width = max(1, (int)lround(pixels / height));
+
+			vector<int> image((size_t)width * height);
+			ImageBuffer in, out;
+			if (!image_buffer_alloc(in, width, height) || !image_buffer_alloc(out, width, height)) {
+				cout << "ERROR: cannot allocate " << width << "x" << height << " image." << endl;
+				continue;
+			}
+			generate_image(&image[0], width, height, width, config.pattern, config.seed);
+
+			for (int op : config.ops) {
+				for (int engine : config.engines) {
+					if ((engine == ENGINE_SERIAL || engine == ENGINE_PARALLEL) && megapixels > config.referenceMegapixels) continue;
+
+					vector<int> threadCounts = single_threaded(engine) ? vector<int>(1, 1) : config.threads;
+					vector<int> cutoffs = single_threaded(engine) ? vector<int>(1, 0) : config.cutoffs;
+					const vector<int> &params = op == OP_PREWITT ? config.kernels : config.distances;
+
+					for (int threads : threadCounts) {
+						global_control threadLimit(global_control::max_allowed_parallelism, max(1, threads));
+
+						for (int cutoff : cutoffs) {
+							for (int param : params) {
+								if (cutoff > 0) CUTOFF = cutoff;
+								if (op == OP_PREWITT) FILTER_SIZE = param;
+								else DISTANCE = param;
+
+								BenchResult result = bench_measure(op, engine, image, in, out, config.warmup, config.repetitions, counters);
+								result.cutoff = cutoff;
+								result.threads = threads;
+								result.kernel = op == OP_PREWITT ? param : 0;
+								result.distance = op == OP_PREWITT ? 0 : param;
+								bench_print_result(result);
+								results.push_back(result);
+							}
+						}
+					}
+				}
+			}
+
+			image_buffer_free(in);
+			image_buffer_free(out);
+		}
+	}
+
+	CUTOFF = savedCutoff;
+	DISTANCE = savedDistance;
+	FILTER_SIZE = savedKernel;
+	delete counters;
+}
+
+void bench_print_counters(const vector<BenchResult> &results)
+{
+	bool header = false;
+
+	for (int op = OP_PREWITT; op <= OP_EDGE; op++) {
+		for (int engine = 0; engine < ENGINE_COUNT; engine++) {
+			double sum[PERF_COUNTER_COUNT] = {0};
+			int count[PERF_COUNTER_COUNT] = {0};
+			for (const BenchResult &r : results) {
+				if (r.op != op || r.engine != engine) continue;
+				for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+					if (r.counters[c] < 0) continue;
+					sum[c] += r.counters[c];
+					count[c]++;
+				}
+			}
+			if (count[PERF_CYCLES] == 0 && count[PERF_INSTRUCTIONS] == 0) continue;
+
+			if (!header) {
+				cout << endl << "Hardware counters per pixel, mean over points (- unavailable):" << endl;
+				header = true;
+			}
+			cout << op_name(op) << " " << engine_name(engine) << ":";
+			for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+				cout << " " << perf_counter_name(c) << " ";
+				if (count[c] > 0) cout << sum[c] / count[c];
+				else cout << "-";
+			}
+			cout << endl;
+		}
+	}
+}
+
+#define BENCH_CSV_HEADER	"op,engine,width,height,cutoff,distance,kernel,threads,samples,median_ms,p95_ms,min_ms,mp_per_s," \
+							"cycles_px,instructions_px,l1d_misses_px,llc_misses_px,dtlb_misses_px,branch_misses_px"
+
+bool bench_write_csv(const char *path, const vector<BenchResult> &results)
+{
+	ofstream out(path);
+	if (!out) {
+		cout << "ERROR: cannot write " << path << endl;
+		return false;
+	}
+
+	out << BENCH_CSV_HEADER << endl;
+	for (const BenchResult &r : results) {
+		out << op_name(r.op) << ',' << engine_name(r.engine) << ',' << r.width << ',' << r.height << ',';
+		out << r.cutoff << ',' << r.distance << ',' << r.kernel << ',' << r.threads << ',' << r.samples << ',';
+		out << r.medianMs << ',' << r.p95Ms << ',' << r.minMs << ',' << r.megapixelsPerSecond;
+		for (int c = 0; c < PERF_COUNTER_COUNT; c++) out << ',' << r.counters[c];
+		out << endl;
+	}
+	return true;
+}
+
+static string json_string(const string &text)
+{
+	string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+bool bench_write_json(const char *path, const BenchConfig &config, const vector<BenchResult> &results)
+{
+	ofstream out(path);
+	if (!out) {
+		cout << "ERROR: cannot write " << path << endl;
+		return false;
+	}
+
+	out << "{" << endl;
+	out << "  \"cpu\": " << json_string(tuner_cpu_model()) << "," << endl;
+	out << "  \"pattern\": \"" << generator_pattern_name(config.pattern) << "\", \"seed\": " << config.seed << "," << endl;
+	out << "  \"results\": [" << endl;
+	for (size_t k = 0; k < results.size(); k++) {
+		const BenchResult &r = results[k];
+		out << "    {\"op\": \"" << op_name(r.op) << "\", \"engine\": \"" << engine_name(r.engine) << "\"";
+		out << ", \"width\": " << r.width << ", \"height\": " << r.height;
+		out << ", \"cutoff\": " << r.cutoff << ", \"distance\": " << r.distance << ", \"kernel\": " << r.kernel;
+		out << ", \"threads\": " << r.threads << ", \"samples\": " << r.samples;
+		out << ", \"median_ms\": " << r.medianMs << ", \"p95_ms\": " << r.p95Ms << ", \"min_ms\": " << r.minMs;
+		out << ", \"mp_per_s\": " << r.megapixelsPerSecond;
+		for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+			if (r.counters[c] >= 0) out << ", \"" << perf_counter_name(c) << "_px\": " << r.counters[c];
+		}
+		out << "}" << (k + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+	return true;
+}
+
+bool bench_read_csv(const char *path, vector<BenchResult> &results)
+{
+	ifstream in(path);
+	if (!in) {
+		cout << "ERROR: cannot open " << path << endl;
+		return false;
+	}
+
+	string line;
+	while (getline(in, line)) {
+		if (line.empty() || line == BENCH_CSV_HEADER) continue;
+
+		vector<string> fields;
+		stringstream ss(line);
+		string field;
+		while (getline(ss, field, ',')) fields.push_back(field);
+		// files written before counters were added have 13 fields
+		if (fields.size() != 13 && fields.size() != 13 + PERF_COUNTER_COUNT) continue;
+
+		BenchResult r;
+		r.op = fields[0] == "prewitt" ? OP_PREWITT : OP_EDGE;
+		r.engine = engine_from_name(fields[1].c_str());
+		if (r.engine < 0) continue;
+		r.width = atoi(fields[2].c_str());
+		r.height = atoi(fields[3].c_str());
+		r.cutoff = atoi(fields[4].c_str());
+		r.distance = atoi(fields[5].c_str());
+		r.kernel = atoi(fields[6].c_str());
+		r.threads = atoi(fields[7].c_str());
+		r.samples = atoi(fields[8].c_str());
+		r.medianMs = atof(fields[9].c_str());
+		r.p95Ms = atof(fields[10].c_str());
+		r.minMs = atof(fields[11].c_str());
+		r.megapixelsPerSecond = atof(fields[12].c_str());
+		for (int c = 0; c < PERF_COUNTER_COUNT; c++) r.counters[c] = fields.size() > 13 ? atof(fields[13 + c].c_str()) : -1;
+		results.push_back(r);
+	}
+	return true;
+}
+
+static bool same_point(const BenchResult &a, const BenchResult &b)
+{
+	return a.op == b.op && a.engine == b.engine && a.width == b.width && a.height == b.height &&
+		a.cutoff == b.cutoff && a.distance == b.distance && a.kernel == b.kernel && a.threads == b.threads;
+}
+
+int bench_compare(const vector<BenchResult> &baseline, const vector<BenchResult> &current, double tolerance)
+{
+	int regressions = 0, compared = 0;
+
+	for (const BenchResult &now : current) {
+		const BenchResult *base = NULL;
+		for (const BenchResult &b : baseline) {
+			if (same_point(b, now)) {
+				base = &b;
+				break;
+			}
+		}
+		if (base == NULL || base->medianMs <= 0) continue;
+
+		double change = now.medianMs / base->medianMs - 1;
+		compared++;
+
+		cout << op_name(now.op) << " " << engine_name(now.engine) << " " << now.width << "x" << now.height;
+		cout << " cutoff=" << now.cutoff << " threads=" << now.threads;
+		cout << (now.op == OP_PREWITT ? " kernel=" : " distance=") << (now.op == OP_PREWITT ? now.kernel : now.distance);
+		cout << ": " << base->medianMs << " -> " << now.medianMs << " ms (" << (change >= 0 ? "+" : "") << change * 100 << " %)";
+		if (change > tolerance) {
+			cout << " REGRESSION";
+			regressions++;
+		}
+		cout << endl;
+	}
+
+	cout << compared << " points compared, " << regressions << " regressions (tolerance " << tolerance * 100 << " %)." << endl;
+	return regressions;
+}
@@ -0,0 +1,98 @@
+/*
+ * Benchmark.h
+ *
+ *  Benchmark suite. Sweeps image size, aspect ratio, CUTOFF, DISTANCE,
+ *  kernel size, thread count, operator and engine on generated images.
+ *  Every point gets warm-up runs and timed samples; median, 95th
+ *  percentile, minimum and throughput (MP/s at the median) are reported
+ *  and can be written as CSV or JSON. A stored CSV serves as a baseline:
+ *  bench_compare flags points that got slower than a tolerance.
+ *
+ *  With counters enabled every timed run is also measured with hardware
+ *  performance counters (see PerfCounters.h), reported per pixel; when
+ *  the counters are unavailable the benchmark runs without them.
+ *
+ *  Parameters that do not affect an engine are not swept for it: single
+ *  threaded engines (serial, simd) run once with 1 thread and CUTOFF 0,
+ *  Prewitt is swept over kernels only, edge detection over distances only.
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <string>
+#include <vector>
+#include "ImageBuffer.h"
+#include "PerfCounters.h"
+
+struct BenchConfig {
+	std::vector<double> megapixels;		// image sizes, 1 MP = 10^6 pixels
+	std::vector<double> aspects;		// width / height
+	std::vector<int> cutoffs;
+	std::vector<int> distances;
+	std::vector<int> kernels;
+	std::vector<int> threads;
+	std::vector<int> engines;
+	std::vector<int> ops;
+	int repetitions;
+	int warmup;
+	double referenceMegapixels;			// serial and parallel engines are skipped on bigger images
+	int pattern;						// GEN_* image pattern
+	unsigned long long seed;
+	bool counters;						// collect hardware performance counters
+};
+
+struct BenchResult {
+	int op;
+	int engine;
+	int width;
+	int height;
+	int cutoff;
+	int distance;
+	int kernel;
+	int threads;
+	int samples;
+	double medianMs;
+	double p95Ms;
+	double minMs;
+	double megapixelsPerSecond;
+	double counters[PERF_COUNTER_COUNT];	// per pixel and run, -1 if not measured
+};
+
+void bench_default_config(BenchConfig &config);
+
+/**
+* @brief Times op with engine and the current globals. Input is reloaded from
+* image before every run (edge detection thresholds it), outside the timing.
+*
+* @param image dense input pixels, in.width * in.height
+* @param warmup untimed runs
+* @param repetitions timed runs
+* @param counters counts every timed run when not NULL
+* @return timings; cutoff, distance and kernel are the current globals, threads is 0
+*/
+BenchResult bench_measure(int op, int engine, const std::vector<int> &image, ImageBuffer &in, ImageBuffer &out, int warmup, int repetitions, PerfCounters *counters);
+
+/**
+* @brief Runs every point of the sweep, printing one line per point.
+*/
+void bench_run(const BenchConfig &config, std::vector<BenchResult> &results);
+
+/**
+* @brief Prints mean counters per pixel of every engine over its points.
+*/
+void bench_print_counters(const std::vector<BenchResult> &results);
+
+bool bench_write_csv(const char *path, const std::vector<BenchResult> &results);
+bool bench_write_json(const char *path, const BenchConfig &config, const std::vector<BenchResult> &results);
+bool bench_read_csv(const char *path, std::vector<BenchResult> &results);
+
+/**
+* @brief Compares medians of points present in both runs and prints them.
+*
+* @param tolerance allowed slowdown, 0.1 is 10 %
+* @return number of regressions
+*/
+int bench_compare(const std::vector<BenchResult> &baseline, const std::vector<BenchResult> &current, double tolerance);
+
+#endif /* BENCHMARK_H_ */
@@ -7,10 +7,36 @@
 
 
 #include "BitmapRawConverter.h"
+#include "GrayCodec.h"
+#include "BmpDecoder.h"
+#include "NumaPlacement.h"
+#include "ImageGenerator.h"
+#include "Trace.h"
 #include <stdlib.h>
 
 BitmapRawConverter::BitmapRawConverter(char *filename) {
-	bitmap.ReadFromFile(filename);
+	TRACE_SCOPE("decode", TRACE_STAGE);
+	loaded = true;
+
+	// synthetic input, created in memory
+	int pattern;
+	unsigned long long seed;
+	if (generator_parse_spec(filename, &pattern, &width, &height, &seed)) {
+		pixels = numa_alloc_image(width, height);
+		// any size parses, a huge one may not fit into memory
+		if (pixels == NULL) loaded = false;
+		else generate_image(pixels, width, height, width, pattern, seed);
+		return;
+	}
+
+	// QOG files already hold grayscale values, no color conversion needed
+	if (qog_is_filename(filename) && qog_read(filename, &pixels, &width, &height)) return;
+
+	// direct SIMD decode to grayscale, EasyBMP is kept for files it cannot handle
+	if (bmp_decode_gray(filename, &pixels, &width, &height)) return;
+
+	// a file EasyBMP cannot read either leaves a 1x1 image
+	loaded = bitmap.ReadFromFile(filename);
 	width = bitmap.TellWidth();
 	height = bitmap.TellHeight();
 
@@ -18,7 +44,8 @@ BitmapRawConverter::BitmapRawConverter(char *filename) {
 }
 
 void BitmapRawConverter::bitmapToPixels() {
-	pixels = (int *) malloc(width * height * sizeof(int));  //new int[width * height];
+	TRACE_SCOPE("grayscale", TRACE_STAGE);
+	pixels = numa_alloc_image(width, height);  //new int[width * height];
 
 	for (int i = 0; i < width; i++) {
 		for (int j = 0; j < height; j++) {
@@ -28,17 +55,56 @@ void BitmapRawConverter::bitmapToPixels() {
 	}
 }
 
-void BitmapRawConverter::pixelsToBitmap(char *outFilename) {
+bool BitmapRawConverter::pixelsToBitmap(char *outFilename) {
 	BMP out;
-	out.SetSize(width, height);
-	out.SetBitDepth(24);
-
-	for (int i = 0; i < width; i++) {
-		for (int j = 0; j < height; j++) {
-			out.SetPixel(i, j, getPixel(i,j));
+	{
+		TRACE_SCOPE("to bitmap", TRACE_STAGE);
+		out.SetSize(width, height);
+		out.SetBitDepth(24);
+
+		for (int i = 0; i < width; i++) {
+			for (int j = 0; j < height; j++) {
+				out.SetPixel(i, j, getPixel(i,j));
+			}
 		}
 	}
-	out.WriteToFile(outFilename);
+	TRACE_SCOPE("write bmp", TRACE_STAGE);
+	return out.WriteToFile(outFilename);
+}
+
+bool BitmapRawConverter::pixelsToCodec(char *outFilename) {
+	TRACE_SCOPE("write qog", TRACE_STAGE);
+	return qog_write(outFilename, pixels, width, height);
+}
+
+bool BitmapRawConverter::pixelsToFile(char *outFilename) {
+	if (qog_is_filename(outFilename)) return pixelsToCodec(outFilename);
+	return pixelsToBitmap(outFilename);
+}
+
+/**
+* @brief Writes an image of another size, e.g. a crop of this one.
+*
+* @param format 0: from file extension, 1: bmp, 2: qog
+* @return false if the file could not be written
+*/
+bool BitmapRawConverter::bufferToFile(char *outFilename, int *buffer, int bufferWidth, int bufferHeight, int format) {
+	// the writers work on the members, lend them the buffer for one call
+	int *ownPixels = pixels;
+	int ownWidth = width, ownHeight = height;
+	pixels = buffer;
+	width = bufferWidth;
+	height = bufferHeight;
+
+	bool ok;
+	if (format == 1) ok = pixelsToBitmap(outFilename);
+	else if (format == 2) ok = pixelsToCodec(outFilename);
+	else ok = pixelsToFile(outFilename);
+
+	pixels = ownPixels;
+	width = ownWidth;
+	height = ownHeight;
+	return ok;
 }
 
 RGBApixel BitmapRawConverter::getPixel(int i, int j) {
@@ -62,7 +128,16 @@ int *BitmapRawConverter::getBuffer()
 
 void BitmapRawConverter::setBuffer(int *buffer)
 {
-	memcpy((void *)pixels, (void *)buffer, width * height * sizeof(int));
+	TRACE_SCOPE("set buffer", TRACE_STAGE);
+	memcpy((void *)pixels, (void *)buffer, (size_t)width * height * sizeof(int));
+}
+
+/**
+* @brief False if the input could not be decoded.
+*/
+bool BitmapRawConverter::isLoaded() const
+{
+    return loaded;
 }
 
 int BitmapRawConverter::getHeight() const
@@ -86,6 +161,6 @@ void BitmapRawConverter::setWidth(int width)
 }
 
 BitmapRawConverter::~BitmapRawConverter() {
-	delete pixels;
+	numa_free_image(pixels, width, height);
 }
 
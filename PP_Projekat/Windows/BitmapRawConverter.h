@@ -16,9 +16,13 @@ private:
 	int width;
 	int height;
 	int *pixels;
+	bool loaded;
 public:
 	void bitmapToPixels();
-	void pixelsToBitmap(char *outFilename);
+	bool pixelsToBitmap(char *outFilename);
+	bool pixelsToCodec(char *outFilename);
+	bool pixelsToFile(char *outFilename);
+	bool bufferToFile(char *outFilename, int *buffer, int bufferWidth, int bufferHeight, int format);
 
 	RGBApixel getPixel(int i, int j);
 	void putPixel(int i, int j, RGBApixel value);
@@ -30,6 +34,7 @@ public:
 
 	BitmapRawConverter(char *filename);
 	virtual ~BitmapRawConverter();
+	bool isLoaded() const;
     int getHeight() const;
     int getWidth() const;
     void setHeight(int height);
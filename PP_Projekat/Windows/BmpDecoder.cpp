@@ -0,0 +1,346 @@
+/*
+ * BmpDecoder.cpp
+ *
+ *  Direct BMP to grayscale decoder.
+ */
+
+#include "BmpDecoder.h"
+#include "NumaPlacement.h"
+#include "ImagePool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BMP_DECODER_SSE2
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#define BMP_DECODER_SSSE3
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BMP_DECODER_AVX2
+#endif
+
+// x / 100 == mulhi(x, 5243) >> 3 for every 0 <= x <= 25500
+#define GRAY_DIV_MUL		5243
+#define GRAY_DIV_SHIFT		3
+
+using namespace std;
+using namespace tbb;
+
+/**
+* @brief Layout of one BMP file as EasyBMP interprets it.
+*/
+struct BmpLayout {
+	int width;
+	int height;
+	int bitDepth;
+	size_t rowSize;
+	size_t dataOffset;
+	int redMask, greenMask, blueMask;
+	int redShift, greenShift, blueShift;
+	int gray[256];
+};
+
+static unsigned int read_le16(const unsigned char *src)
+{
+	return src[0] | (src[1] << 8);
+}
+
+static unsigned int read_le32(const unsigned char *src)
+{
+	return src[0] | (src[1] << 8) | (src[2] << 16) | ((unsigned int)src[3] << 24);
+}
+
+/**
+* @brief Number of right shifts EasyBMP applies to bring a 16-bit channel mask below 32.
+*/
+static int mask_shift(int mask)
+{
+	int shift = 0;
+	while (mask > 31) {
+		mask >>= 1;
+		shift++;
+	}
+	return shift;
+}
+
+/**
+* @brief Parses headers, palette and 16-bit masks. Returns false for everything
+* EasyBMP does not read cleanly, so the fallback reproduces its behaviour.
+*/
+static bool parse_layout(const unsigned char *data, size_t size, BmpLayout &layout)
+{
+	if (size < 54 || read_le16(data) != 19778) return false;
+
+	unsigned int offBits = read_le32(data + 10);
+	unsigned int compression = read_le32(data + 30);
+	int bitDepth = read_le16(data + 28);
+
+	layout.width = (int)read_le32(data + 18);
+	layout.height = (int)read_le32(data + 22);
+	layout.bitDepth = bitDepth;
+
+	if (compression == 1 || compression == 2 || compression > 3) return false;
+	if (compression == 3 && bitDepth != 16) return false;
+	if (bitDepth != 1 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16 && bitDepth != 24 && bitDepth != 32) return false;
+	if (layout.width <= 0 || layout.height <= 0) return false;
+
+	layout.rowSize = ((size_t)layout.width * bitDepth + 31) / 32 * 4;
+
+	// data offset is computed exactly like ReadFromFile does it
+	long long skip = (long long)offBits - 54;
+	size_t pos = 54;
+
+	if (bitDepth < 16) {
+		int numberOfColors = 1 << bitDepth;
+		int colorsToRead = ((int)offBits - 54) / 4;
+		if (colorsToRead > numberOfColors) colorsToRead = numberOfColors;
+		if (colorsToRead < numberOfColors) return false;	// EasyBMP pads and warns, let it
+		if (pos + 4 * (size_t)numberOfColors > size) return false;
+
+		for (int n = 0; n < numberOfColors; n++) {
+			const unsigned char *c = data + pos + 4 * n;
+			layout.gray[n] = bmp_gray_value(c[2], c[1], c[0]);
+		}
+		pos += 4 * numberOfColors;
+		skip -= 4 * numberOfColors;
+	}
+
+	if (bitDepth == 16) {
+		layout.redMask = 31744;
+		layout.greenMask = 992;
+		layout.blueMask = 31;
+		if (compression == 3) {
+			if (pos + 12 > size) return false;
+			layout.redMask = read_le16(data + pos);
+			layout.greenMask = read_le16(data + pos + 4);
+			layout.blueMask = read_le16(data + pos + 8);
+			pos += 12;
+			skip -= 12;
+		}
+		layout.redShift = mask_shift(layout.redMask);
+		layout.greenShift = mask_shift(layout.greenMask);
+		layout.blueShift = mask_shift(layout.blueMask);
+	}
+
+	if (skip > 0) {
+		if (bitDepth != 16) return false;	// EasyBMP warns about meta data, let it
+		pos += (size_t)skip;
+	}
+
+	layout.dataOffset = pos;
+	if (pos > size || (size - pos) / layout.rowSize < (size_t)layout.height) return false;
+
+	return true;
+}
+
+/*
+* Row kernels. Every kernel converts one file row into width gray ints.
+*/
+
+static void decode_row_24(const unsigned char *src, int *dst, int width, size_t rowSize)
+{
+	int i = 0;
+
+#ifdef BMP_DECODER_SSSE3
+	const __m128i toBGRx = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i weights = _mm_setr_epi8(11, 59, 30, 0, 11, 59, 30, 0, 11, 59, 30, 0, 11, 59, 30, 0);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i divMul = _mm_set1_epi16(GRAY_DIV_MUL);
+	const __m128i zero = _mm_setzero_si128();
+
+	// 8 pixels per step, the second load reads 4 bytes past the 24 used ones
+	for (; i + 8 <= width && 3 * (size_t)i + 28 <= rowSize; i += 8) {
+		__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3 * i)), toBGRx);
+		__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3 * i + 12)), toBGRx);
+		__m128i sumLo = _mm_madd_epi16(_mm_maddubs_epi16(lo, weights), ones);
+		__m128i sumHi = _mm_madd_epi16(_mm_maddubs_epi16(hi, weights), ones);
+		__m128i gray = _mm_srli_epi16(_mm_mulhi_epu16(_mm_packs_epi32(sumLo, sumHi), divMul), GRAY_DIV_SHIFT);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(gray, zero));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(gray, zero));
+	}
+#endif
+
+	for (; i < width; i++) dst[i] = bmp_gray_value(src[3 * i + 2], src[3 * i + 1], src[3 * i]);
+}
+
+static void decode_row_32(const unsigned char *src, int *dst, int width)
+{
+	int i = 0;
+
+#ifdef BMP_DECODER_SSSE3
+	const __m128i weights = _mm_setr_epi8(11, 59, 30, 0, 11, 59, 30, 0, 11, 59, 30, 0, 11, 59, 30, 0);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i divMul = _mm_set1_epi16(GRAY_DIV_MUL);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 8 <= width; i += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + 4 * i + 16));
+		__m128i sumLo = _mm_madd_epi16(_mm_maddubs_epi16(lo, weights), ones);
+		__m128i sumHi = _mm_madd_epi16(_mm_maddubs_epi16(hi, weights), ones);
+		__m128i gray = _mm_srli_epi16(_mm_mulhi_epu16(_mm_packs_epi32(sumLo, sumHi), divMul), GRAY_DIV_SHIFT);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(gray, zero));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(gray, zero));
+	}
+#endif
+
+	for (; i < width; i++) dst[i] = bmp_gray_value(src[4 * i + 2], src[4 * i + 1], src[4 * i]);
+}
+
+static void decode_row_16(const unsigned char *src, int *dst, int width, const BmpLayout &layout)
+{
+	int i = 0;
+
+#ifdef BMP_DECODER_SSE2
+	const __m128i redMask = _mm_set1_epi16((short)layout.redMask);
+	const __m128i greenMask = _mm_set1_epi16((short)layout.greenMask);
+	const __m128i blueMask = _mm_set1_epi16((short)layout.blueMask);
+	const __m128i redShift = _mm_cvtsi32_si128(layout.redShift);
+	const __m128i greenShift = _mm_cvtsi32_si128(layout.greenShift);
+	const __m128i blueShift = _mm_cvtsi32_si128(layout.blueShift);
+	const __m128i byteMask = _mm_set1_epi16(0xff);
+	const __m128i divMul = _mm_set1_epi16(GRAY_DIV_MUL);
+	const __m128i zero = _mm_setzero_si128();
+
+	// channel byte is (ebmpBYTE)(8 * ((word & mask) >> shift)), same as ReadFromFile
+	for (; i + 8 <= width; i += 8) {
+		__m128i words = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		__m128i r = _mm_and_si128(_mm_slli_epi16(_mm_srl_epi16(_mm_and_si128(words, redMask), redShift), 3), byteMask);
+		__m128i g = _mm_and_si128(_mm_slli_epi16(_mm_srl_epi16(_mm_and_si128(words, greenMask), greenShift), 3), byteMask);
+		__m128i b = _mm_and_si128(_mm_slli_epi16(_mm_srl_epi16(_mm_and_si128(words, blueMask), blueShift), 3), byteMask);
+		__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(30)), _mm_mullo_epi16(g, _mm_set1_epi16(59))), _mm_mullo_epi16(b, _mm_set1_epi16(11)));
+		__m128i gray = _mm_srli_epi16(_mm_mulhi_epu16(sum, divMul), GRAY_DIV_SHIFT);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(gray, zero));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(gray, zero));
+	}
+#endif
+
+	for (; i < width; i++) {
+		int word = read_le16(src + 2 * i);
+		int r = (8 * ((word & layout.redMask) >> layout.redShift)) & 0xff;
+		int g = (8 * ((word & layout.greenMask) >> layout.greenShift)) & 0xff;
+		int b = (8 * ((word & layout.blueMask) >> layout.blueShift)) & 0xff;
+		dst[i] = bmp_gray_value(r, g, b);
+	}
+}
+
+static void decode_row_8(const unsigned char *src, int *dst, int width, const int *gray)
+{
+	int i = 0;
+
+#ifdef BMP_DECODER_AVX2
+	for (; i + 8 <= width; i += 8) {
+		__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_i32gather_epi32(gray, index, 4));
+	}
+#endif
+
+	for (; i < width; i++) dst[i] = gray[src[i]];
+}
+
+/**
+* @brief Palette expansion for 1 and 4 bit images through a byte lookup table:
+* one source byte maps to pixelsPerByte ready gray ints, copied as a block.
+*/
+static void decode_row_packed(const unsigned char *src, int *dst, int width, const int *expanded, int pixelsPerByte)
+{
+	int fullBytes = width / pixelsPerByte;
+
+	for (int k = 0; k < fullBytes; k++) {
+		memcpy(dst + k * pixelsPerByte, expanded + src[k] * pixelsPerByte, pixelsPerByte * sizeof(int));
+	}
+	int rest = width - fullBytes * pixelsPerByte;
+	if (rest) memcpy(dst + fullBytes * pixelsPerByte, expanded + src[fullBytes] * pixelsPerByte, rest * sizeof(int));
+}
+
+void bmp_gray_row(const unsigned char *src, int *dst, int width, int bytesPerPixel, size_t rowBytes)
+{
+	switch (bytesPerPixel) {
+		case 4: decode_row_32(src, dst, width); break;
+		case 3: decode_row_24(src, dst, width, rowBytes); break;
+		default:
+			for (int i = 0; i < width; i++) dst[i] = src[i];
+			break;
+	}
+}
+
+bool bmp_decode_gray_memory(const unsigned char *data, size_t size, int **pixels, int *width, int *height)
+{
+	BmpLayout layout;
+	if (data == NULL || !parse_layout(data, size, layout)) return false;
+
+	int w = layout.width;
+	int h = layout.height;
+	int pixelsPerByte = layout.bitDepth == 1 ? 8 : 2;
+	vector<int> expanded;
+
+	if (layout.bitDepth == 1 || layout.bitDepth == 4) {
+		int mask = (1 << layout.bitDepth) - 1;
+		expanded.resize(256 * pixelsPerByte);
+		for (int byte = 0; byte < 256; byte++) {
+			for (int k = 0; k < pixelsPerByte; k++) {
+				int index = (byte >> (8 - layout.bitDepth * (k + 1))) & mask;
+				expanded[byte * pixelsPerByte + k] = layout.gray[index];
+			}
+		}
+	}
+
+	int *out = pool_alloc_image(w, h);
+	if (out == NULL) return false;
+
+	// file stores rows bottom-up, image row j is file row h - 1 - j.
+	// Every node decodes its own band, so the first touch places the pages there.
+	NumaArenas::instance().runBands(h, [&](int y0, int y1) {
+		parallel_for(blocked_range<int>(y0, y1), [&](const blocked_range<int> &r) {
+			for (int j = r.begin(); j != r.end(); j++) {
+				const unsigned char *src = data + layout.dataOffset + (size_t)(h - 1 - j) * layout.rowSize;
+				int *dst = out + (size_t)j * w;
+
+				switch (layout.bitDepth) {
+					case 32: decode_row_32(src, dst, w); break;
+					case 24: decode_row_24(src, dst, w, layout.rowSize); break;
+					case 16: decode_row_16(src, dst, w, layout); break;
+					case 8: decode_row_8(src, dst, w, layout.gray); break;
+					default: decode_row_packed(src, dst, w, &expanded[0], pixelsPerByte); break;
+				}
+			}
+		});
+	});
+
+	*pixels = out;
+	*width = w;
+	*height = h;
+	return true;
+}
+
+bool bmp_decode_gray(const char *filename, int **pixels, int *width, int *height)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) return false;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (size <= 0) {
+		fclose(fp);
+		return false;
+	}
+
+	unsigned char *data = (unsigned char *) pool_alloc(size);
+	bool ok = data != NULL && fread(data, 1, size, fp) == (size_t)size;
+	fclose(fp);
+
+	ok = ok && bmp_decode_gray_memory(data, size, pixels, width, height);
+	pool_free(data, size);
+
+	return ok;
+}
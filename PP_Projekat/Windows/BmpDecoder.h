@@ -0,0 +1,53 @@
+/*
+ * BmpDecoder.h
+ *
+ *  Direct BMP to grayscale decoder. Rows are converted straight into the
+ *  int working buffer with SIMD kernels for every bit depth EasyBMP reads
+ *  (1, 4, 8, 16, 24 and 32 bits), skipping the RGBApixel** intermediate.
+ *  The result is bit-exact with BMP::ReadFromFile followed by
+ *  BitmapRawConverter::bitmapToPixels.
+ */
+
+#ifndef BMPDECODER_H_
+#define BMPDECODER_H_
+
+#include <stddef.h>
+
+/**
+* @brief Gray value used by the whole project: (30 * R + 59 * G + 11 * B) / 100
+*/
+inline int bmp_gray_value(int red, int green, int blue)
+{
+	return ((30 * red) + (59 * green) + (11 * blue)) / 100;
+}
+
+/**
+* @brief Decodes BMP file directly into a grayscale buffer.
+*
+* Files EasyBMP would reject, warn about or read only partially (compressed,
+* truncated, non-positive size) are not handled, false is returned and the
+* caller should fall back to BMP::ReadFromFile.
+*
+* @param filename input file
+* @param pixels decoded buffer of width * height ints, from pool_alloc_image
+* @param width image width
+* @param height image height
+* @return true if image was decoded
+*/
+bool bmp_decode_gray(const char *filename, int **pixels, int *width, int *height);
+
+/**
+* @brief Same as bmp_decode_gray, but decodes from a BMP file image in memory.
+*/
+bool bmp_decode_gray_memory(const unsigned char *data, size_t size, int **pixels, int *width, int *height);
+
+/**
+* @brief Converts one row of 8 bit gray, BGR or BGRA pixels to gray ints, with
+* the SIMD kernels of the decoder.
+*
+* @param bytesPerPixel 1 (gray), 3 (B, G, R) or 4 (B, G, R, A)
+* @param rowBytes readable bytes from src on, at least width * bytesPerPixel
+*/
+void bmp_gray_row(const unsigned char *src, int *dst, int width, int bytesPerPixel, size_t rowBytes);
+
+#endif /* BMPDECODER_H_ */
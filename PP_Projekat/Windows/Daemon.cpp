@@ -0,0 +1,551 @@
+/*
+ * Daemon.cpp
+ *
+ *  Job server on a Unix domain socket.
+ */
+
+#include "Daemon.h"
+#include "BitmapRawConverter.h"
+#include "EdgeFilters.h"
+#include "EdgeEngine.h"
+#include "GrayCodec.h"
+#include "ImageGenerator.h"
+#include "SharedImage.h"
+#include "IncrementalFilter.h"
+#include "ImagePool.h"
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <tbb/tick_count.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+using namespace std;
+using namespace tbb;
+
+#ifndef _WIN32
+
+struct DaemonStats {
+	long long jobs;
+	long long failed;
+	double megapixels;
+	double totalMicroseconds;
+};
+
+static EdgeEngine *engine = NULL;
+static mutex filterMutex;					// filters read the parameter globals, one job at a time
+static int defaultKernel, defaultDistance, defaultThreshold;
+static int configuredKernel, configuredDistance;
+static map<string, IncrementalFilter *> streams;	// stream= frame sequences, guarded by filterMutex
+
+static mutex stateMutex;
+static condition_variable clientsDone;
+static DaemonStats stats = {0, 0, 0, 0};
+static set<int> clients;
+static atomic<bool> stopping(false);
+static int listenFd = -1;
+static string outputRoot;					// resolved output directory, ends with '/'
+
+
+static bool socket_address(const char *path, sockaddr_un &address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) return false;
+	strcpy(address.sun_path, path);
+	return true;
+}
+
+static bool send_line(int fd, const string &line)
+{
+	string data = line + "\n";
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) return false;
+		sent += n;
+	}
+	return true;
+}
+
+/**
+* @brief Splits "JOB key=value key=value" into a map, words without '=' are ignored.
+*/
+static map<string, string> parse_fields(const string &line)
+{
+	map<string, string> fields;
+	istringstream words(line);
+	string word;
+	while (words >> word) {
+		size_t equals = word.find('=');
+		if (equals != string::npos) fields[word.substr(0, equals)] = word.substr(equals + 1);
+	}
+	return fields;
+}
+
+static string field(const map<string, string> &fields, const char *key, const string &fallback)
+{
+	map<string, string>::const_iterator it = fields.find(key);
+	return it == fields.end() ? fallback : it->second;
+}
+
+static string job_error(const string &id, const string &message)
+{
+	lock_guard<mutex> lock(stateMutex);
+	stats.failed++;
+	return "ERR id=" + id + " " + message;
+}
+
+static bool is_shared(const string &name)
+{
+	return name.compare(0, 4, "shm:") == 0;
+}
+
+/**
+* @brief Maps the segment named by a shm:NAME field and places the image described by
+* the prefix_format, prefix_stride and prefix_offset fields in it.
+*/
+static bool map_shared_field(const map<string, string> &fields, const string &name, const char *prefix, int width, int height,
+		const char *defaultFormat, bool writable, int peerPid, SharedMapping &mapping, SharedImage &image, string &error)
+{
+	string key = prefix;
+	int format = shared_format_from_name(field(fields, (key + "_format").c_str(), defaultFormat).c_str());
+	size_t stride = strtoull(field(fields, (key + "_stride").c_str(), "0").c_str(), NULL, 10);
+	size_t offset = strtoull(field(fields, (key + "_offset").c_str(), "0").c_str(), NULL, 10);
+
+	if (format < 0) {
+		error = "unknown " + key + "_format";
+		return false;
+	}
+	if (!shared_map(name.c_str() + 4, writable, peerPid, mapping)) {
+		error = "cannot map " + name;
+		return false;
+	}
+	if (!shared_image_at(mapping, offset, format, width, height, stride, image)) {
+		shared_unmap(mapping);
+		error = "image does not fit into " + name;
+		return false;
+	}
+	return true;
+}
+
+/**
+* @brief Whether a file output stays inside outputRoot: its directory must resolve
+* there and an existing file must not be a link (or anything but a regular file).
+*/
+static bool output_allowed(const string &output)
+{
+	size_t slash = output.rfind('/');
+	string directory = slash == string::npos ? "." : slash == 0 ? "/" : output.substr(0, slash);
+	char resolved[PATH_MAX];
+	if (realpath(directory.c_str(), resolved) == NULL) return false;
+
+	string path = string(resolved) + "/";
+	if (path.compare(0, outputRoot.size(), outputRoot) != 0) return false;
+
+	struct stat info;
+	return lstat(output.c_str(), &info) != 0 || S_ISREG(info.st_mode);
+}
+
+static bool input_exists(const string &input)
+{
+	int pattern, width, height;
+	unsigned long long seed;
+	struct stat info;
+	return generator_parse_spec(input.c_str(), &pattern, &width, &height, &seed) || (stat(input.c_str(), &info) == 0 && S_ISREG(info.st_mode));
+}
+
+static string job_reply(const string &id, int width, int height, tick_count startCount, tick_count decodedCount, tick_count filteredCount)
+{
+	tick_count endCount = tick_count::now();
+	double totalMicroseconds = (endCount - startCount).seconds() * 1e6;
+	{
+		lock_guard<mutex> lock(stateMutex);
+		stats.jobs++;
+		stats.megapixels += (double)width * height / 1e6;
+		stats.totalMicroseconds += totalMicroseconds;
+	}
+
+	ostringstream reply;
+	reply << "OK id=" << id << " width=" << width << " height=" << height;
+	reply << " decode_us=" << (long long)((decodedCount - startCount).seconds() * 1e6);
+	reply << " filter_us=" << (long long)((filteredCount - decodedCount).seconds() * 1e6);
+	reply << " write_us=" << (long long)((endCount - filteredCount).seconds() * 1e6);
+	reply << " total_us=" << (long long)totalMicroseconds;
+	return reply.str();
+}
+
+/**
+* @brief Sets the filter parameters of a job, caller holds filterMutex.
+*/
+static void apply_parameters(int kernel, int distance, int threshold)
+{
+	FILTER_SIZE = kernel;
+	DISTANCE = distance;
+	THRESHOLD = threshold;
+	if (kernel != configuredKernel || distance != configuredDistance) {
+		engine->configure();
+		configuredKernel = kernel;
+		configuredDistance = distance;
+		// results kept by the streams were computed with the old kernels
+		for (map<string, IncrementalFilter *>::iterator it = streams.begin(); it != streams.end(); ++it) it->second->reset();
+	}
+}
+
+/**
+* @brief Incremental filter of a stream, created on its first frame. Caller holds filterMutex.
+*/
+static IncrementalFilter &stream_filter(const string &name)
+{
+	IncrementalFilter *&filter = streams[name];
+	if (filter == NULL) filter = new IncrementalFilter(*engine);
+	return *filter;
+}
+
+static string stream_reply(const string &reply, const string &stream, int dirtyTiles, int tiles)
+{
+	if (stream.empty() || reply.compare(0, 2, "OK") != 0) return reply;
+	return reply + " dirty_tiles=" + to_string(dirtyTiles) + " tiles=" + to_string(tiles);
+}
+
+/**
+* @brief JOB with shm: output. The input is a shm: segment of raw pixels or an image
+* file; conversion and filtering happen between the mappings, nothing is written to disk.
+*/
+static string daemon_shared_job(const map<string, string> &fields, const string &id, int op, int kernel, int distance, int threshold,
+		int peerPid, tick_count startCount)
+{
+	string input = field(fields, "input", "");
+	string output = field(fields, "output", "");
+	SharedMapping inMapping = {NULL, 0}, outMapping = {NULL, 0};
+	SharedImage in, out;
+	BitmapRawConverter *image = NULL;
+	string error;
+
+	if (is_shared(input)) {
+		int width = atoi(field(fields, "width", "0").c_str());
+		int height = atoi(field(fields, "height", "0").c_str());
+		if (!map_shared_field(fields, input, "in", width, height, "gray8", false, peerPid, inMapping, in, error)) return job_error(id, error);
+	}
+	else {
+		image = new BitmapRawConverter((char *)input.c_str());
+		if (!image->isLoaded()) {
+			delete image;
+			return job_error(id, "cannot decode " + input);
+		}
+		in.data = (unsigned char *)image->getBuffer();
+		in.format = SHARED_GRAY32;
+		in.width = image->getWidth();
+		in.height = image->getHeight();
+		in.stride = in.width * sizeof(int);
+	}
+	tick_count decodedCount = tick_count::now();
+
+	if (!map_shared_field(fields, output, "out", in.width, in.height, "gray8", true, peerPid, outMapping, out, error)) {
+		shared_unmap(inMapping);
+		delete image;
+		return job_error(id, error);
+	}
+
+	bool ok;
+	string stream = field(fields, "stream", "");
+	int dirtyTiles = 0, tiles = 0;
+	{
+		lock_guard<mutex> lock(filterMutex);
+		apply_parameters(kernel, distance, threshold);
+		if (stream.empty()) ok = shared_filter(*engine, op, in, out, threshold);
+		else {
+			IncrementalFilter &filter = stream_filter(stream);
+			ok = shared_filter_incremental(filter, op, in, out, threshold);
+			dirtyTiles = filter.dirtyTiles();
+			tiles = filter.tileCount();
+		}
+	}
+	tick_count filteredCount = tick_count::now();
+
+	shared_unmap(inMapping);
+	shared_unmap(outMapping);
+	delete image;
+	if (!ok) return job_error(id, "unsupported formats");
+	return stream_reply(job_reply(id, in.width, in.height, startCount, decodedCount, filteredCount), stream, dirtyTiles, tiles);
+}
+
+/**
+* @brief Runs one JOB request and builds its reply.
+*
+* @param peerPid process of the client, its descriptors may be named as shm:/proc/PID/fd/N
+*/
+static string daemon_job(const map<string, string> &fields, int peerPid)
+{
+	tick_count startCount = tick_count::now();
+	string id = field(fields, "id", "-");
+	string opName = field(fields, "op", "prewitt");
+	string input = field(fields, "input", "");
+	string output = field(fields, "output", "-");
+	string format = field(fields, "format", "");
+	int kernel = atoi(field(fields, "kernel", to_string(defaultKernel)).c_str());
+	int distance = atoi(field(fields, "distance", to_string(defaultDistance)).c_str());
+	int threshold = atoi(field(fields, "threshold", to_string(defaultThreshold)).c_str());
+
+	if (opName != "prewitt" && opName != "edge") return job_error(id, "unknown op " + opName);
+	if (kernel < 1 || kernel > MAX_FILTER_SIZE || kernel % 2 == 0) return job_error(id, "invalid kernel");
+	if (distance < 0 || 2 * distance + 1 > MAX_FILTER_SIZE) return job_error(id, "invalid distance");
+	if (format != "" && format != "bmp" && format != "qog") return job_error(id, "unknown format " + format);
+	if (input.empty() || (!is_shared(input) && !input_exists(input))) return job_error(id, "cannot open " + input);
+	if (is_shared(input) && !is_shared(output)) return job_error(id, "shared memory input needs a shm: output");
+	if (!is_shared(output) && output != "-" && !output_allowed(output)) return job_error(id, "output outside " + outputRoot + ": " + output);
+	int op = opName == "prewitt" ? OP_PREWITT : OP_EDGE;
+
+	if (is_shared(output)) return daemon_shared_job(fields, id, op, kernel, distance, threshold, peerPid, startCount);
+
+	BitmapRawConverter image((char *)input.c_str());
+	if (!image.isLoaded()) return job_error(id, "cannot decode " + input);
+	int width = image.getWidth();
+	int height = image.getHeight();
+	tick_count decodedCount = tick_count::now();
+
+	int *outBuffer = engine->acquire(width, height);
+	string stream = field(fields, "stream", "");
+	int dirtyTiles = 0, tiles = 0;
+	bool ok = true;
+	{
+		lock_guard<mutex> lock(filterMutex);
+		apply_parameters(kernel, distance, threshold);
+		if (stream.empty()) engine->run(op, image.getBuffer(), outBuffer, width, height);
+		else {
+			// the result is only valid until the next frame of the stream, copy it under the lock
+			IncrementalFilter &filter = stream_filter(stream);
+			ImageView<const int> result = filter.run(op, ImageView<const int>(image.getBuffer(), width, height), threshold);
+			ok = result.data != NULL;
+			for (int j = 0; ok && j < height; j++) copy(result.row(j), result.row(j) + width, outBuffer + (size_t)j * width);
+			dirtyTiles = filter.dirtyTiles();
+			tiles = filter.tileCount();
+		}
+	}
+	tick_count filteredCount = tick_count::now();
+	if (!ok) {
+		engine->release(outBuffer, width, height);
+		return job_error(id, "out of memory");
+	}
+
+	if (output != "-") {
+		image.setBuffer(outBuffer);
+		if (format == "bmp") ok = image.pixelsToBitmap((char *)output.c_str());
+		else if (format == "qog") ok = image.pixelsToCodec((char *)output.c_str());
+		else ok = image.pixelsToFile((char *)output.c_str());
+	}
+	engine->release(outBuffer, width, height);
+	if (!ok) return job_error(id, "cannot write " + output);
+	return stream_reply(job_reply(id, width, height, startCount, decodedCount, filteredCount), stream, dirtyTiles, tiles);
+}
+
+/**
+* @brief CLOSE stream=NAME, frees the frames kept for a stream.
+*/
+static string daemon_close(const map<string, string> &fields)
+{
+	string stream = field(fields, "stream", "");
+	lock_guard<mutex> lock(filterMutex);
+	map<string, IncrementalFilter *>::iterator it = streams.find(stream);
+	if (it == streams.end()) return "ERR unknown stream " + stream;
+	delete it->second;
+	streams.erase(it);
+	return "CLOSED stream=" + stream;
+}
+
+static void daemon_stop()
+{
+	stopping = true;
+	shutdown(listenFd, SHUT_RDWR);
+}
+
+/**
+* @brief Answers requests of one connection until it closes or the daemon stops.
+*/
+static void daemon_client(int fd, int peerPid)
+{
+	string pending;
+	char buffer[4096];
+
+	while (true) {
+		size_t newline;
+		while ((newline = pending.find('\n')) != string::npos) {
+			string line = pending.substr(0, newline);
+			pending.erase(0, newline + 1);
+			if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+			if (line.empty()) continue;
+
+			string command = line.substr(0, line.find(' '));
+			string reply;
+			if (command == "JOB") {
+				reply = daemon_job(parse_fields(line), peerPid);
+				pool_trim(DAEMON_POOL_RETAIN);
+			}
+			else if (command == "CLOSE") reply = daemon_close(parse_fields(line));
+			else if (command == "PING") reply = "PONG";
+			else if (command == "STATS") {
+				lock_guard<mutex> lock(stateMutex);
+				ostringstream out;
+				out << "STATS jobs=" << stats.jobs << " failed=" << stats.failed << " megapixels=" << stats.megapixels;
+				out << " mean_us=" << (stats.jobs ? (long long)(stats.totalMicroseconds / stats.jobs) : 0);
+				reply = out.str();
+			}
+			else if (command == "SHUTDOWN") reply = "BYE";
+			else reply = "ERR unknown command " + command;
+
+			if (!send_line(fd, reply)) break;
+			if (command == "SHUTDOWN") daemon_stop();
+		}
+
+		// no newline in sight, do not buffer it without limit
+		if (pending.size() > DAEMON_MAX_LINE) {
+			send_line(fd, "ERR request line too long");
+			break;
+		}
+
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0) break;
+		pending.append(buffer, n);
+	}
+
+	close(fd);
+	lock_guard<mutex> lock(stateMutex);
+	clients.erase(fd);
+	clientsDone.notify_all();
+}
+
+/**
+* @brief Whether the peer of a connection runs as our user or as root.
+*
+* @param peerPid set to the process of the peer
+*/
+static bool peer_allowed(int fd, int &peerPid)
+{
+	ucred credentials;
+	socklen_t length = sizeof(credentials);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) return false;
+	peerPid = credentials.pid;
+	return credentials.uid == geteuid() || credentials.uid == 0;
+}
+
+int daemon_run(const char *socketPath, const char *outputDir)
+{
+	sockaddr_un address;
+	if (!socket_address(socketPath, address)) {
+		cout << "ERROR: socket path too long: " << socketPath << endl;
+		return 1;
+	}
+	char resolved[PATH_MAX];
+	if (realpath(outputDir != NULL ? outputDir : ".", resolved) == NULL) {
+		cout << "ERROR: cannot open output directory " << (outputDir != NULL ? outputDir : ".") << endl;
+		return 1;
+	}
+	outputRoot = resolved;
+	if (outputRoot[outputRoot.size() - 1] != '/') outputRoot += '/';
+
+	// nobody can connect before listen, so the mode is set before the first client
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socketPath);
+	if (listenFd < 0 || bind(listenFd, (sockaddr *)&address, sizeof(address)) != 0 || chmod(socketPath, 0600) != 0 || listen(listenFd, 64) != 0) {
+		cout << "ERROR: cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+		if (listenFd >= 0) close(listenFd);
+		return 1;
+	}
+
+	// warm arena and kernel tables for the parameters the daemon was started with
+	engine = new EdgeEngine();
+	defaultKernel = configuredKernel = FILTER_SIZE;
+	defaultDistance = configuredDistance = DISTANCE;
+	defaultThreshold = THRESHOLD;
+	cout << "Listening on " << socketPath << endl;
+
+	while (!stopping) {
+		int fd = accept(listenFd, NULL, NULL);
+		if (fd < 0) {
+			if (stopping) break;
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			cout << "ERROR: accept failed: " << strerror(errno) << endl;
+			break;
+		}
+		int peerPid;
+		if (!peer_allowed(fd, peerPid)) {
+			send_line(fd, "ERR permission denied");
+			close(fd);
+			continue;
+		}
+		{
+			lock_guard<mutex> lock(stateMutex);
+			if (clients.size() < DAEMON_MAX_CLIENTS) {
+				clients.insert(fd);
+				thread(daemon_client, fd, peerPid).detach();
+				continue;
+			}
+		}
+		send_line(fd, "ERR too many clients");
+		close(fd);
+	}
+
+	// let running jobs finish, idle connections see end of input
+	{
+		unique_lock<mutex> lock(stateMutex);
+		for (int fd : clients) shutdown(fd, SHUT_RD);
+		clientsDone.wait(lock, [] { return clients.empty(); });
+	}
+	close(listenFd);
+	unlink(socketPath);
+
+	cout << "Daemon stopped after " << stats.jobs << " jobs (" << stats.failed << " failed)." << endl;
+	for (map<string, IncrementalFilter *>::iterator it = streams.begin(); it != streams.end(); ++it) delete it->second;
+	streams.clear();
+	delete engine;
+	engine = NULL;
+	return 0;
+}
+
+bool daemon_send(const char *socketPath, const string &request, string &reply)
+{
+	sockaddr_un address;
+	if (!socket_address(socketPath, address)) return false;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return false;
+	if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0 || !send_line(fd, request)) {
+		close(fd);
+		return false;
+	}
+
+	reply.clear();
+	char c;
+	while (recv(fd, &c, 1, 0) == 1 && c != '\n') reply += c;
+	close(fd);
+	return true;
+}
+
+#else
+
+int daemon_run(const char *socketPath)
+{
+	cout << "ERROR: daemon mode needs Unix domain sockets, not available in this build." << endl;
+	return 1;
+}
+
+bool daemon_send(const char *socketPath, const string &request, string &reply)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Daemon.h
+ *
+ *  Long-running service on a Unix domain socket. The process, the TBB
+ *  workers (one warm EdgeEngine arena), the kernel tables and the pooled
+ *  buffers stay alive between jobs, so a small image costs its decode and
+ *  filter time only. Clients connect, send one request per line and get
+ *  one reply line per request, in order:
+ *
+ *    JOB [id=ID] op=prewitt|edge input=PATH|GENSPEC [output=PATH|-]
+ *        [format=bmp|qog] [kernel=K] [distance=D] [threshold=T] [stream=NAME]
+ *    OK id=ID width=W height=H decode_us=.. filter_us=.. write_us=.. total_us=..
+ *    ERR id=ID message
+ *
+ *    CLOSE stream=NAME -> CLOSED stream=NAME
+ *    PING      -> PONG
+ *    STATS     -> STATS jobs=.. failed=.. megapixels=.. mean_us=..
+ *    SHUTDOWN  -> BYE, the daemon stops after the running jobs
+ *
+ *  Images can also be handed over in memory (see SharedImage.h): input and
+ *  output name a POSIX shared memory object or a memfd as shm:NAME, e.g.
+ *  shm:/frames or shm:/proc/PID/fd/N, where PID must be the process of the
+ *  connected client (devices and other paths are refused). For a shm: input width= and height=
+ *  are required, in_format= (gray8, bgr24, bgra32, gray32, default gray8),
+ *  in_stride= (bytes, default packed) and in_offset= describe its pixels;
+ *  out_format= (gray8 or gray32), out_stride= and out_offset= the output,
+ *  which has the size of the input. A file input may have a shm: output.
+ *  decode_us then covers mapping the input, filter_us the pixel conversions.
+ *
+ *  Jobs with the same stream= are successive frames of one sequence (a
+ *  camera, repeated scans): the daemon keeps the last frame and its result
+ *  and recomputes only the tiles that changed (see IncrementalFilter.h).
+ *  Their replies add dirty_tiles= and tiles=. CLOSE frees a stream.
+ *
+ *  The socket is created 0600 and only clients running as the daemon's
+ *  user (or root) are served, others get "ERR permission denied". File
+ *  outputs must resolve to a path inside the output directory (-outdir,
+ *  default the working directory of the daemon) and must not be links.
+ *
+ *  At most DAEMON_MAX_CLIENTS connections are served at once, a further
+ *  client gets "ERR too many clients" and is closed. A request line longer
+ *  than DAEMON_MAX_LINE bytes gets "ERR request line too long" and closes
+ *  its connection.
+ *
+ *  After every job the buffer pool is trimmed to DAEMON_POOL_RETAIN bytes,
+ *  so an idle daemon does not hold the memory of the largest job it ran.
+ *
+ *  Omitted parameters take the values the daemon was started with. Jobs of
+ *  several clients are decoded and written concurrently, filters run one
+ *  at a time on the shared arena (each uses all its workers).
+ */
+
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include <string>
+
+#define DAEMON_DEFAULT_SOCKET	"/tmp/edgedetect.sock"
+#define DAEMON_POOL_RETAIN		((size_t)256 << 20)		// pooled bytes kept between jobs
+#define DAEMON_MAX_CLIENTS		64						// connections served at once
+#define DAEMON_MAX_LINE			(64 << 10)				// bytes of one request line
+
+/**
+* @brief Serves jobs on socketPath until SHUTDOWN. An existing socket file is replaced.
+*
+* @param outputDir directory file outputs are written to, NULL for the working directory
+* @return 0 after SHUTDOWN, 1 if the socket cannot be created or outputDir does not exist
+*/
+int daemon_run(const char *socketPath, const char *outputDir = NULL);
+
+/**
+* @brief Sends one request line to a daemon and stores its reply line.
+*
+* @return false if the daemon cannot be reached
+*/
+bool daemon_send(const char *socketPath, const std::string &request, std::string &reply);
+
+#endif /* DAEMON_H_ */
@@ -0,0 +1,458 @@
+/*
+ * Differential.cpp
+ *
+ *  Randomized differential testing against the serial reference.
+ */
+
+#include "Differential.h"
+#include "EdgeFilters.h"
+#include "EdgeEngine.h"
+#include "ImageBuffer.h"
+#include "ImageGenerator.h"
+#include "RegionOfInterest.h"
+#include "IncrementalFilter.h"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <tbb/tick_count.h>
+
+using namespace std;
+using namespace tbb;
+
+#define DIFF_POISON				-7		// never a filter output, marks pixels nobody wrote
+#define DIFF_FRAME				1000	// around a view, changes every result that reads it
+
+static const char *pathNames[DIFF_PATH_COUNT] = {"dense", "strided", "edge-engine", "view", "regions", "incremental"};
+
+
+/**
+* @brief Globals a case changes, restored after every check.
+*/
+struct DiffGlobals {
+	int filterSize, threshold, cutoff, distance, tileAspect, tileOrder, imageStride;
+
+	DiffGlobals() : filterSize(FILTER_SIZE), threshold(THRESHOLD), cutoff(CUTOFF), distance(DISTANCE),
+		tileAspect(TILE_ASPECT), tileOrder(TILE_ORDER), imageStride(IMAGE_STRIDE) {}
+
+	~DiffGlobals() {
+		FILTER_SIZE = filterSize;
+		THRESHOLD = threshold;
+		CUTOFF = cutoff;
+		DISTANCE = distance;
+		TILE_ASPECT = tileAspect;
+		TILE_ORDER = tileOrder;
+		IMAGE_STRIDE = imageStride;
+	}
+};
+
+static EdgeEngine &diff_engine()
+{
+	static EdgeEngine engine;
+	return engine;
+}
+
+void diff_default_config(DiffConfig &config)
+{
+	config.iterations = 2000;
+	config.seed = GEN_DEFAULT_SEED;
+	config.maxSide = 300;
+	config.maxFailures = 10;
+	config.minimize = true;
+	config.engines.clear();
+	for (int engine = 0; engine < ENGINE_COUNT; engine++) config.engines.push_back(engine);
+	config.ops = {OP_PREWITT, OP_EDGE};
+	config.paths = {DIFF_PATH_DENSE, DIFF_PATH_STRIDED, DIFF_PATH_ENGINE, DIFF_PATH_VIEW, DIFF_PATH_REGIONS, DIFF_PATH_INCREMENTAL};
+}
+
+/**
+* @brief Image side: mostly tiny (all SIMD tails and borders), sometimes up to
+* maxSide, sometimes just around a power of two or the cutoff.
+*/
+static int random_side(mt19937_64 &rng, int maxSide, int cutoff)
+{
+	int kind = (int)(rng() % 20);
+	if (kind < 10) return 1 + (int)(rng() % min(32, maxSide));
+	if (kind < 17) return 1 + (int)(rng() % maxSide);
+
+	int around = kind == 17 ? cutoff : 1 << (rng() % 9);
+	int side = around + (int)(rng() % 3) - 1;
+	return max(1, min(maxSide, side));
+}
+
+DiffCase diff_random_case(const DiffConfig &config, unsigned long long caseSeed)
+{
+	mt19937_64 rng(caseSeed);
+	DiffCase c;
+	int maxSide = max(1, config.maxSide);
+
+	c.seed = caseSeed;
+	c.op = config.ops[rng() % config.ops.size()];
+	c.engine = config.engines[rng() % config.engines.size()];
+	c.path = config.paths[rng() % config.paths.size()];
+
+	// small cutoffs split the recursive engines many levels deep
+	c.cutoff = rng() % 2 ? 1 + (int)(rng() % 16) : 1 + (int)(rng() % maxSide);
+	c.width = random_side(rng, maxSide, c.cutoff);
+	c.height = random_side(rng, maxSide, c.cutoff);
+
+	int strideKind = (int)(rng() % 3);
+	c.stride = strideKind == 0 ? IMAGE_STRIDE_DENSE : strideKind == 1 ? IMAGE_STRIDE_AUTO : c.width + 1 + (int)(rng() % 40);
+
+	c.pattern = (int)(rng() % GEN_PATTERN_COUNT);
+	c.imageSeed = rng();
+
+	int kernelKind = (int)(rng() % 10);
+	c.kernel = kernelKind < 4 ? 3 : kernelKind < 7 ? 7 : 1 + 2 * (int)(rng() % ((MAX_FILTER_SIZE + 1) / 2));
+	c.distance = rng() % 2 ? 1 : (int)(rng() % ((MAX_FILTER_SIZE + 1) / 2));
+	c.threshold = c.op == OP_PREWITT ? (int)(rng() % 2048) : (int)(rng() % 257);
+	c.tileAspect = (int)(rng() % 5);
+	c.tileOrder = rng() % 2 ? TILE_ORDER_ROWS : TILE_ORDER_RECURSIVE;
+	c.serialEngine = rng() % 2 == 0;
+	return c;
+}
+
+static void diff_apply(const DiffCase &c)
+{
+	FILTER_SIZE = c.kernel;
+	THRESHOLD = c.threshold;
+	CUTOFF = c.cutoff;
+	DISTANCE = c.distance;
+	TILE_ASPECT = c.tileAspect;
+	TILE_ORDER = c.tileOrder;
+	IMAGE_STRIDE = c.stride;
+}
+
+/**
+* @brief Places the image as a rectangle inside larger input and output buffers of
+* different strides, runs the view filters and checks that nothing outside the
+* rectangles was written.
+*
+* @return false if the frame around a view changed
+*/
+static bool diff_view(const DiffCase &c, vector<int> &input, vector<int> &output)
+{
+	int width = c.width, height = c.height;
+	unsigned long long bits = c.imageSeed;
+	int left = (int)(bits % 5), top = (int)((bits >> 8) % 3);
+	int inStride = left + width + (int)((bits >> 16) % 9);
+	int outStride = left + width + (int)((bits >> 24) % 17);
+
+	vector<int> inFrame((size_t)inStride * (top + height + 2), DIFF_FRAME);
+	vector<int> outFrame((size_t)outStride * (top + height + 2), DIFF_POISON);
+	ImageView<int> in = ImageView<int>(&inFrame[0], inStride, top + height + 2).sub(left, top, left + width, top + height);
+	ImageView<int> out = ImageView<int>(&outFrame[0], outStride, top + height + 2).sub(left, top, left + width, top + height);
+	for (int j = 0; j < height; j++) copy(&input[(size_t)j * width], &input[(size_t)j * width] + width, in.row(j));
+
+	if (c.op == OP_PREWITT) filter_prewitt(c.engine, in, out);
+	else filter_edge_detection(c.engine, in, out);
+
+	for (int j = 0; j < height; j++) {
+		copy(in.row(j), in.row(j) + width, &input[(size_t)j * width]);
+		copy(out.row(j), out.row(j) + width, &output[(size_t)j * width]);
+		fill(in.row(j), in.row(j) + width, DIFF_FRAME);
+		fill(out.row(j), out.row(j) + width, DIFF_POISON);
+	}
+	return count(inFrame.begin(), inFrame.end(), DIFF_FRAME) == (long long)inFrame.size() &&
+		count(outFrame.begin(), outFrame.end(), DIFF_POISON) == (long long)outFrame.size();
+}
+
+/**
+* @brief Filters random, partly overlapping rectangles (some reaching out of the
+* image) with every input pixel the windows must not read changed, then the
+* rest of the image with a second call, so the whole output can be compared.
+* Half of the cases write each rectangle into its own crop.
+*
+* @return false if a pixel outside the rectangles or a crop was written
+*/
+static bool diff_regions(const DiffCase &c, vector<int> &input, vector<int> &output)
+{
+	int width = c.width, height = c.height;
+	mt19937_64 rng(c.imageSeed ^ 0x5bd1e995ULL);
+	EdgeEngine &engine = diff_engine();
+	engine.configure();
+	engine.setSerialPixels(c.serialEngine ? (long long)width * height + 1 : 0);
+
+	vector<RoiRect> rects, reads;
+	int rectCount = 1 + (int)(rng() % 4);
+	for (int k = 0; k < rectCount; k++) {
+		int x = (int)(rng() % (width + 2)) - 1, y = (int)(rng() % (height + 2)) - 1;
+		RoiRect rect = {x, y, x + 1 + (int)(rng() % width), y + 1 + (int)(rng() % height)};
+		if (roi_clip(rect, width, height)) rects.push_back(rect);
+	}
+	if (rects.empty()) rects.push_back({0, 0, width, height});
+	for (size_t k = 0; k < rects.size(); k++) roi_reads(rects[k], width, height, engine.radius(c.op), reads);
+
+	vector<char> read((size_t)width * height, 0);
+	for (const RoiRect &r : reads) {
+		for (int j = r.y0; j < r.y1; j++) fill(&read[(size_t)j * width + r.x0], &read[(size_t)j * width + r.x1], 1);
+	}
+	vector<int> poisoned(input);
+	for (size_t k = 0; k < poisoned.size(); k++) {
+		if (!read[k]) poisoned[k] = poisoned[k] >= c.threshold ? -DIFF_FRAME : DIFF_FRAME;
+	}
+	ImageView<const int> in(&poisoned[0], width, height);
+	ImageView<int> out(&output[0], width, height);
+
+	if (rng() % 2) {
+		engine.runRegions(c.op, in, out, 0, 0, &rects[0], (int)rects.size(), c.threshold);
+	}
+	else {
+		// crops with padded rows, the padding must stay untouched
+		vector<vector<int> > crops(rects.size());
+		vector<ImageView<int> > views;
+		for (size_t k = 0; k < rects.size(); k++) {
+			int cropWidth = rects[k].x1 - rects[k].x0, cropHeight = rects[k].y1 - rects[k].y0;
+			int cropStride = cropWidth + (int)(rng() % 5);
+			crops[k].assign((size_t)cropStride * cropHeight, DIFF_POISON);
+			views.push_back(ImageView<int>(&crops[k][0], cropWidth, cropHeight, cropStride));
+		}
+		engine.runCrops(c.op, in, &rects[0], &views[0], (int)rects.size(), c.threshold);
+		for (size_t k = 0; k < rects.size(); k++) {
+			for (int j = 0; j < views[k].height; j++) {
+				copy(views[k].row(j), views[k].row(j) + views[k].width, out.row(rects[k].y0 + j) + rects[k].x0);
+				if (count_if(views[k].row(j) + views[k].width, views[k].row(j) + views[k].stride, [](int v) { return v != DIFF_POISON; }) != 0) return false;
+			}
+		}
+	}
+
+	// the rest of the image, row by row, must be untouched and is filtered afterwards
+	vector<char> inside((size_t)width * height, 0);
+	for (const RoiRect &r : rects) {
+		for (int j = r.y0; j < r.y1; j++) fill(&inside[(size_t)j * width + r.x0], &inside[(size_t)j * width + r.x1], 1);
+	}
+	vector<RoiRect> rest;
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; ) {
+			if (inside[(size_t)j * width + i]) { i++; continue; }
+			int x0 = i;
+			while (i < width && !inside[(size_t)j * width + i]) i++;
+			if (count(out.row(j) + x0, out.row(j) + i, DIFF_POISON) != i - x0) return false;
+			rest.push_back({x0, j, i, j + 1});
+		}
+	}
+	if (!rest.empty()) {
+		engine.runRegions(c.op, ImageView<const int>(&input[0], width, height), out, 0, 0, &rest[0], (int)rest.size(), c.threshold);
+	}
+	return true;
+}
+
+/**
+* @brief Filters a previous frame, the image with some random patches changed
+* (or none), then the image itself through the same IncrementalFilter, which
+* recomputes only around the patches. The image is filtered a second time
+* unchanged, both results must match.
+*
+* @return false if the unchanged frame gave another result
+*/
+static bool diff_incremental(const DiffCase &c, vector<int> &input, vector<int> &output)
+{
+	int width = c.width, height = c.height;
+	mt19937_64 rng(c.imageSeed ^ 0x27d4eb2fULL);
+	EdgeEngine &engine = diff_engine();
+	engine.configure();
+	engine.setSerialPixels(c.serialEngine ? (long long)width * height + 1 : 0);
+
+	// half of the cases get a last tile column narrower than a window, the
+	// windows wrapping around the left border then reach the column before it
+	int tileSize = INCREMENTAL_MIN_TILE + (int)(rng() % 24);
+	if (rng() % 2) {
+		for (int t = INCREMENTAL_MIN_TILE; t < INCREMENTAL_MIN_TILE + 24; t++) {
+			if (width % t >= 1 && width % t <= engine.radius(c.op)) tileSize = t;
+		}
+	}
+	IncrementalFilter filter(engine, tileSize);
+
+	vector<int> previous(input);
+	int patches = (int)(rng() % 4);
+	for (int k = 0; k < patches; k++) {
+		int x0 = k == 0 && rng() % 2 ? 0 : (int)(rng() % width), y0 = (int)(rng() % height);
+		int x1 = min(width, x0 + 1 + (int)(rng() % 8)), y1 = min(height, y0 + 1 + (int)(rng() % 8));
+		for (int j = y0; j < y1; j++) {
+			for (int i = x0; i < x1; i++) previous[(size_t)j * width + i] = (int)(rng() % 256);
+		}
+	}
+
+	ImageView<const int> in(&input[0], width, height);
+	filter.run(c.op, ImageView<const int>(&previous[0], width, height), c.threshold);
+	ImageView<const int> result = filter.run(c.op, in, c.threshold);
+	for (int j = 0; j < height; j++) copy(result.row(j), result.row(j) + width, &output[(size_t)j * width]);
+
+	result = filter.run(c.op, in, c.threshold);
+	for (int j = 0; j < height; j++) {
+		if (!equal(result.row(j), result.row(j) + width, &output[(size_t)j * width])) return false;
+	}
+	return filter.dirtyTiles() == 0;
+}
+
+/**
+* @brief Runs the case on its path. Input is the generated image, on return
+* it holds what the path leaves in its input buffer.
+*
+* @return false if the path wrote outside its image
+*/
+static bool diff_candidate(const DiffCase &c, vector<int> &input, vector<int> &output)
+{
+	int width = c.width, height = c.height;
+
+	if (c.path == DIFF_PATH_DENSE) {
+		if (c.op == OP_PREWITT) filter_prewitt(c.engine, &input[0], &output[0], width, height);
+		else filter_edge_detection(c.engine, &input[0], &output[0], width, height);
+		return true;
+	}
+	if (c.path == DIFF_PATH_VIEW) return diff_view(c, input, output);
+	if (c.path == DIFF_PATH_REGIONS) return diff_regions(c, input, output);
+	if (c.path == DIFF_PATH_INCREMENTAL) return diff_incremental(c, input, output);
+
+	ImageBuffer in = {}, out = {};
+	if (!image_buffer_alloc(in, width, height) || !image_buffer_alloc(out, width, height)) {
+		image_buffer_free(in);
+		image_buffer_free(out);
+		return true;
+	}
+	image_buffer_load(in, &input[0]);
+	fill(out.data, out.data + (size_t)out.stride * height, DIFF_POISON);
+
+	if (c.path == DIFF_PATH_STRIDED) {
+		image_filter(c.op, c.engine, in, out);
+	}
+	else {
+		EdgeEngine &engine = diff_engine();
+		engine.configure();
+		engine.setSerialPixels(c.serialEngine ? (long long)width * height + 1 : 0);
+		engine.run(c.op, in, out);
+	}
+
+	image_buffer_store(in, &input[0]);
+	image_buffer_store(out, &output[0]);
+	image_buffer_free(in);
+	image_buffer_free(out);
+	return true;
+}
+
+bool diff_check(const DiffCase &c, bool report)
+{
+	DiffGlobals saved;
+	diff_apply(c);
+
+	size_t pixels = (size_t)c.width * c.height;
+	vector<int> image(pixels);
+	generate_image(&image[0], c.width, c.height, c.width, c.pattern, c.imageSeed);
+
+	vector<int> referenceInput(image), reference(pixels);
+	if (c.op == OP_PREWITT) filter_serial_prewitt(&referenceInput[0], &reference[0], c.width, c.height);
+	else filter_serial_edge_detection(&referenceInput[0], &reference[0], c.width, c.height);
+
+	vector<int> input(image), output(pixels, DIFF_POISON);
+	if (!diff_candidate(c, input, output)) {
+		if (report) cout << "  wrote outside the view or the rectangles, or an unchanged frame changed" << endl;
+		return false;
+	}
+
+	for (size_t k = 0; k < pixels; k++) {
+		if (output[k] == reference[k]) continue;
+		if (report) {
+			cout << "  first difference at x=" << k % c.width << " y=" << k / c.width;
+			cout << ": expected " << reference[k] << ", got " << output[k] << endl;
+		}
+		return false;
+	}
+
+	// the engine object keeps its input, everything else thresholds it in place
+	if (c.op == OP_EDGE && c.path != DIFF_PATH_ENGINE && c.path != DIFF_PATH_REGIONS && c.path != DIFF_PATH_INCREMENTAL) {
+		for (size_t k = 0; k < pixels; k++) {
+			if (input[k] == referenceInput[k]) continue;
+			if (report) {
+				cout << "  thresholded input differs at x=" << k % c.width << " y=" << k / c.width;
+				cout << ": expected " << referenceInput[k] << ", got " << input[k] << endl;
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+DiffCase diff_minimize(const DiffCase &c)
+{
+	DiffCase best = c;
+	bool improved = true;
+
+	while (improved) {
+		improved = false;
+
+		vector<DiffCase> candidates;
+		DiffCase t;
+		t = best; t.width = best.width / 2; if (t.width >= 1) candidates.push_back(t);
+		t = best; t.height = best.height / 2; if (t.height >= 1) candidates.push_back(t);
+		t = best; t.width = best.width - 1; if (t.width >= 1) candidates.push_back(t);
+		t = best; t.height = best.height - 1; if (t.height >= 1) candidates.push_back(t);
+		t = best; t.kernel = 3; if (best.kernel != 3 && best.op == OP_PREWITT) candidates.push_back(t);
+		t = best; t.distance = 1; if (best.distance != 1 && best.op == OP_EDGE) candidates.push_back(t);
+		t = best; t.stride = IMAGE_STRIDE_DENSE; if (best.stride != IMAGE_STRIDE_DENSE) candidates.push_back(t);
+		t = best; t.tileAspect = 1; if (best.tileAspect != 1) candidates.push_back(t);
+		t = best; t.tileOrder = TILE_ORDER_RECURSIVE; if (best.tileOrder != TILE_ORDER_RECURSIVE) candidates.push_back(t);
+		t = best; t.path = DIFF_PATH_DENSE; if (best.path == DIFF_PATH_STRIDED || best.path == DIFF_PATH_VIEW) candidates.push_back(t);
+		t = best; t.pattern = GEN_FLAT; if (best.pattern != GEN_FLAT) candidates.push_back(t);
+
+		for (const DiffCase &candidate : candidates) {
+			if (!diff_check(candidate, false)) {
+				best = candidate;
+				improved = true;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+void diff_print_case(const DiffCase &c)
+{
+	cout << "  " << (c.op == OP_PREWITT ? "prewitt" : "edge") << " ";
+	if (c.path == DIFF_PATH_ENGINE) cout << (c.serialEngine ? "edge-engine (serial)" : "edge-engine (tiled)");
+	else if (c.path == DIFF_PATH_REGIONS) cout << (c.serialEngine ? "edge-engine regions (serial)" : "edge-engine regions (tiled)");
+	else if (c.path == DIFF_PATH_INCREMENTAL) cout << (c.serialEngine ? "incremental (serial)" : "incremental (tiled)");
+	else cout << engine_name(c.engine) << " via " << pathNames[c.path];
+	cout << ", image gen:" << generator_pattern_name(c.pattern) << ":" << c.width << "x" << c.height << ":" << c.imageSeed;
+	cout << ", stride " << (c.stride == IMAGE_STRIDE_DENSE ? "dense" : c.stride == IMAGE_STRIDE_AUTO ? "auto" : to_string(c.stride)) << endl;
+	cout << "  kernel=" << c.kernel << " distance=" << c.distance << " threshold=" << c.threshold;
+	cout << " cutoff=" << c.cutoff << " tile aspect=" << c.tileAspect << " order=" << (c.tileOrder == TILE_ORDER_ROWS ? "rows" : "recursive") << endl;
+}
+
+/**
+* @brief splitmix64 step, seeds of consecutive cases are unrelated
+*/
+static unsigned long long case_seed(unsigned long long seed, int iteration)
+{
+	unsigned long long z = seed + (unsigned long long)(iteration + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+int diff_run(const DiffConfig &config)
+{
+	int failures = 0, checked = 0;
+	tick_count startCount = tick_count::now();
+
+	for (int k = 0; k < config.iterations && failures < config.maxFailures; k++) {
+		DiffCase c = diff_random_case(config, case_seed(config.seed, k));
+		checked++;
+		if (diff_check(c, false)) continue;
+
+		failures++;
+		cout << "FAIL case " << c.seed << " (-fuzz -case " << c.seed << "):" << endl;
+		diff_print_case(c);
+		diff_check(c, true);
+
+		if (config.minimize) {
+			DiffCase small = diff_minimize(c);
+			cout << "  minimized to:" << endl;
+			diff_print_case(small);
+			diff_check(small, true);
+		}
+	}
+
+	cout << checked << " cases, " << failures << " failures";
+	if (failures >= config.maxFailures) cout << " (stopped after " << config.maxFailures << ")";
+	cout << ", " << (tick_count::now() - startCount).seconds() << " s." << endl;
+	return failures;
+}
@@ -0,0 +1,92 @@
+/*
+ * Differential.h
+ *
+ *  Randomized differential testing of the optimized engines against the
+ *  serial reference. Every case draws image size, row stride, pattern,
+ *  kernel size, DISTANCE, THRESHOLD, CUTOFF, tile shape and order from its
+ *  own seed, runs one engine through one entry point (dense filter
+ *  functions, padded ImageBuffer, EdgeEngine, views into larger buffers,
+ *  rectangles of interest or incremental frames) and compares every output
+ *  pixel, plus the thresholded input where the entry point promises it.
+ *
+ *  A failing case is shrunk (smaller image, simpler parameters) for as
+ *  long as it keeps failing, so reports show the smallest known repro.
+ *  The case seed alone reproduces the original case: -fuzz -case SEED.
+ */
+
+#ifndef DIFFERENTIAL_H_
+#define DIFFERENTIAL_H_
+
+#include <vector>
+
+#define DIFF_PATH_DENSE			0		// filter_prewitt / filter_edge_detection
+#define DIFF_PATH_STRIDED		1		// image_filter on padded rows
+#define DIFF_PATH_ENGINE		2		// EdgeEngine::run, engine field is ignored
+#define DIFF_PATH_VIEW			3		// filter_prewitt / filter_edge_detection on ImageView rectangles
+#define DIFF_PATH_REGIONS		4		// EdgeEngine::runRegions / runCrops on random rectangles, engine field is ignored
+#define DIFF_PATH_INCREMENTAL	5		// IncrementalFilter on a frame that differs from the previous one in patches
+#define DIFF_PATH_COUNT			6
+
+struct DiffCase {
+	unsigned long long seed;			// case seed the fields were drawn from
+	int op;
+	int engine;
+	int path;							// DIFF_PATH_*
+	int width;
+	int height;
+	int stride;							// IMAGE_STRIDE value
+	int pattern;						// GEN_* image pattern
+	unsigned long long imageSeed;
+	int kernel;
+	int distance;
+	int threshold;
+	int cutoff;
+	int tileAspect;
+	int tileOrder;
+	bool serialEngine;					// EdgeEngine runs small images on the calling thread
+};
+
+struct DiffConfig {
+	int iterations;
+	unsigned long long seed;			// seed of the case seeds
+	int maxSide;						// largest image width / height
+	int maxFailures;					// stop after this many failing cases
+	bool minimize;
+	std::vector<int> engines;
+	std::vector<int> ops;
+	std::vector<int> paths;
+};
+
+/**
+* @brief 2000 cases of all engines, operators and paths, images up to 300 pixels a side.
+*/
+void diff_default_config(DiffConfig &config);
+
+/**
+* @brief Draws one case from caseSeed, engine, operator and path from the config lists.
+*/
+DiffCase diff_random_case(const DiffConfig &config, unsigned long long caseSeed);
+
+/**
+* @brief Runs one case and compares it with the serial reference.
+*
+* @param report print the first differing pixel
+* @return true if outputs are equal
+*/
+bool diff_check(const DiffCase &c, bool report);
+
+/**
+* @brief Greedily shrinks a failing case while it keeps failing.
+*/
+DiffCase diff_minimize(const DiffCase &c);
+
+void diff_print_case(const DiffCase &c);
+
+/**
+* @brief Runs the random cases, minimizing and printing failures.
+*
+* @return number of failing cases
+*/
+int diff_run(const DiffConfig &config);
+
+#endif /* DIFFERENTIAL_H_ */
@@ -19,6 +19,7 @@
 *************************************************/
 
 #include "EasyBMP.h"
+#include "ImagePool.h"
 
 /* These functions are defined in EasyBMP.h */
 
@@ -220,13 +221,28 @@ RGBApixel BMP::GetColor( int ColorNumber )
  return Output;
 }
 
+// all columns share one pool block, the column table is a second one;
+// images of the same size reuse both blocks instead of Width+1 new[] calls
+void BMP::AllocatePixels( void )
+{
+ RGBApixel* Block = (RGBApixel*) pool_alloc( (size_t) Width * Height * sizeof(RGBApixel) );
+ Pixels = (RGBApixel**) pool_alloc( Width * sizeof(RGBApixel*) );
+ for( int i=0 ; i < Width ; i++ )
+ { Pixels[i] = Block + (size_t) i * Height; }
+}
+
+void BMP::FreePixels( void )
+{
+ pool_free( Pixels[0] , (size_t) Width * Height * sizeof(RGBApixel) );
+ pool_free( Pixels , Width * sizeof(RGBApixel*) );
+}
+
 BMP::BMP()
 {
  Width = 1;
  Height = 1;
  BitDepth = 24;
- Pixels = new RGBApixel* [Width];
- Pixels[0] = new RGBApixel [Height];
+ AllocatePixels();
  Colors = NULL;
  
  XPelsPerMeter = 0;
@@ -246,8 +262,7 @@ BMP::BMP( BMP& Input )
  Width = 1;
  Height = 1;
  BitDepth = 24;
- Pixels = new RGBApixel* [Width];
- Pixels[0] = new RGBApixel [Height];
+ AllocatePixels();
  Colors = NULL; 
  XPelsPerMeter = 0;
  YPelsPerMeter = 0;
@@ -294,10 +309,7 @@ BMP::BMP( BMP& Input )
 
 BMP::~BMP()
 {
- int i;
- for(i=0;i<Width;i++)
- { delete [] Pixels[i]; }
- delete [] Pixels;
+ FreePixels();
  if( Colors )
  { delete [] Colors; }
  
@@ -396,16 +408,11 @@ bool BMP::SetSize(int NewWidth , int NewHeight )
 
  int i,j; 
 
- for(i=0;i<Width;i++)
- { delete [] Pixels[i]; }
- delete [] Pixels;
+ FreePixels();
 
  Width = NewWidth;
  Height = NewHeight;
- Pixels = new RGBApixel* [ Width ]; 
- 
- for(i=0; i<Width; i++)
- { Pixels[i] = new RGBApixel [ Height ]; }
+ AllocatePixels();
  
  for( i=0 ; i < Width ; i++)
  {
@@ -445,7 +452,6 @@ bool BMP::WriteToFile( const char* FileName )
    cout << "EasyBMP Error: Cannot open file " 
         << FileName << " for output." << endl;
   }
-  fclose( fp );
   return false;
  }
   
@@ -560,7 +566,7 @@ bool BMP::WriteToFile( const char* FileName )
   while( BufferSize % 4 )
   { BufferSize++; }
   
-  Buffer = new ebmpBYTE [BufferSize];
+  Buffer = (ebmpBYTE*) pool_alloc( BufferSize );
   for( j=0 ; j < BufferSize; j++ )
   { Buffer[j] = 0; }
     
@@ -596,7 +602,7 @@ bool BMP::WriteToFile( const char* FileName )
    j--; 
   }
   
-  delete [] Buffer;
+  pool_free( Buffer , BufferSize );
  }
  
  if( BitDepth == 16 )
@@ -932,7 +938,7 @@ bool BMP::ReadFromFile( const char* FileName )
   while( BufferSize % 4 )
   { BufferSize++; }
   ebmpBYTE* Buffer;
-  Buffer = new ebmpBYTE [BufferSize];
+  Buffer = (ebmpBYTE*) pool_alloc( BufferSize );
   j= Height-1;
   while( j > -1 )
   {
@@ -940,6 +946,7 @@ bool BMP::ReadFromFile( const char* FileName )
    if( BytesRead < BufferSize )
    {
     j = -1; 
+    NotCorrupted = false;
     if( EasyBMPwarnings )
     {
      cout << "EasyBMP Error: Could not read proper amount of data." << endl;
@@ -965,11 +972,12 @@ bool BMP::ReadFromFile( const char* FileName )
       cout << "EasyBMP Error: Could not read enough pixel data!" << endl;
 	 }
 	 j = -1;
+	 NotCorrupted = false;
     }
    }   
    j--;
   }
-  delete [] Buffer; 
+  pool_free( Buffer , BufferSize ); 
  }
 
  if( BitDepth == 16 )
@@ -1080,7 +1088,7 @@ bool BMP::ReadFromFile( const char* FileName )
  }
  
  fclose(fp);
- return true;
+ return NotCorrupted;
 }
 
 bool BMP::CreateStandardColorTable( void )
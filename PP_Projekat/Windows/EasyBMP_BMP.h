@@ -54,6 +54,9 @@ class BMP
  
  ebmpBYTE FindClosestColor( RGBApixel& input );
 
+ void AllocatePixels( void );
+ void FreePixels( void );
+
  public: 
 
  int TellBitDepth( void );
@@ -0,0 +1,170 @@
+/*
+ * EdgeDetectApi.cpp
+ *
+ *  C interface of libedgedetect on top of EdgeEngine.
+ */
+
+#include "EdgeDetectApi.h"
+#include "EdgeEngine.h"
+#include "EdgeFilters.h"
+#include "SharedImage.h"
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <limits.h>
+
+using namespace std;
+using namespace tbb;
+
+static_assert(EDGE_OP_PREWITT == OP_PREWITT && EDGE_OP_EDGE == OP_EDGE, "operator numbers differ");
+static_assert(EDGE_FORMAT_GRAY8 == SHARED_GRAY8 && EDGE_FORMAT_BGR24 == SHARED_BGR24 &&
+	EDGE_FORMAT_BGRA32 == SHARED_BGRA32 && EDGE_FORMAT_GRAY32 == SHARED_GRAY32, "format numbers differ");
+
+struct edge_engine {
+	EdgeEngine engine;
+
+	edge_engine(int threads) : engine(threads) {}
+};
+
+/**
+* @brief Runs body and turns exceptions into error codes, none may cross the C interface.
+*/
+template <typename Body>
+static int guarded(const Body &body)
+{
+	try {
+		return body();
+	}
+	catch (const bad_alloc &) {
+		return EDGE_ERROR_MEMORY;
+	}
+	catch (...) {
+		return EDGE_ERROR_INTERNAL;
+	}
+}
+
+
+int edge_api_version(void)
+{
+	return EDGE_API_VERSION;
+}
+
+void edge_config_default(edge_config *config)
+{
+	config->threads = 0;
+	config->kernel_size = 7;
+	config->weights_x = NULL;
+	config->weights_y = NULL;
+	config->distance = 1;
+	config->tile_rows = 200;
+	config->tile_aspect = 1;
+}
+
+edge_engine *edge_engine_create(const edge_config *config)
+{
+	edge_config defaults;
+	edge_config_default(&defaults);
+	if (config == NULL) config = &defaults;
+
+	int size = config->kernel_size;
+	if (size < 1 || size > MAX_FILTER_SIZE || size % 2 == 0) return NULL;
+	if (config->distance < 0 || 2 * config->distance + 1 > MAX_FILTER_SIZE) return NULL;
+	if (config->tile_rows < 1 || config->tile_aspect < 0 || config->threads < 0) return NULL;
+	if ((config->weights_x == NULL) != (config->weights_y == NULL)) return NULL;
+
+	// starting the arena or allocating the handle may throw
+	edge_engine *handle = NULL;
+	try {
+		handle = new edge_engine(config->threads > 0 ? config->threads : task_arena::automatic);
+
+		// built-in tables are laid out like the program uses them for any kernel size
+		const int *hor = config->weights_x != NULL ? config->weights_x : filterHor;
+		const int *ver = config->weights_y != NULL ? config->weights_y : filterVer;
+		handle->engine.configure(size, hor, ver, config->distance);
+		handle->engine.setTiling(config->tile_rows, config->tile_aspect);
+		return handle;
+	}
+	catch (...) {
+		delete handle;
+		return NULL;
+	}
+}
+
+void edge_engine_destroy(edge_engine *engine)
+{
+	try {
+		delete engine;
+	}
+	catch (...) {
+	}
+}
+
+int edge_detect(edge_engine *engine, int op, const uint8_t *src, int src_format, size_t src_stride,
+		uint8_t *dst, int dst_format, size_t dst_stride, int width, int height, int threshold)
+{
+	if (engine == NULL || src == NULL || dst == NULL || width <= 0 || height <= 0) return EDGE_ERROR_ARGUMENT;
+	if (op != EDGE_OP_PREWITT && op != EDGE_OP_EDGE) return EDGE_ERROR_ARGUMENT;
+
+	int srcBytes = shared_bytes_per_pixel(src_format);
+	if (srcBytes == 0 || src_stride < (size_t)width * srcBytes) return EDGE_ERROR_ARGUMENT;
+	if (dst_format != EDGE_FORMAT_GRAY8 && dst_format != EDGE_FORMAT_GRAY32) return EDGE_ERROR_ARGUMENT;
+	if (dst_stride < (size_t)width * shared_bytes_per_pixel(dst_format)) return EDGE_ERROR_ARGUMENT;
+
+	// formats and sizes are checked above, shared_filter only fails to allocate its buffers
+	return guarded([&] {
+		SharedImage in = {(unsigned char *)src, src_format, width, height, src_stride};
+		SharedImage out = {dst, dst_format, width, height, dst_stride};
+		return shared_filter(engine->engine, op, in, out, threshold) ? EDGE_OK : EDGE_ERROR_MEMORY;
+	});
+}
+
+int edge_detect_roi(edge_engine *engine, int op, const uint8_t *src, int src_format, size_t src_stride,
+		int width, int height, const edge_rect *rects, int count,
+		uint8_t *dst, int dst_format, size_t dst_stride, int dst_x, int dst_y, int dst_width, int dst_height, int threshold)
+{
+	if (engine == NULL || src == NULL || dst == NULL || width <= 0 || height <= 0) return EDGE_ERROR_ARGUMENT;
+	if (op != EDGE_OP_PREWITT && op != EDGE_OP_EDGE) return EDGE_ERROR_ARGUMENT;
+	if (count < 0 || (count > 0 && rects == NULL) || dst_width <= 0 || dst_height <= 0) return EDGE_ERROR_ARGUMENT;
+
+	int srcBytes = shared_bytes_per_pixel(src_format);
+	if (srcBytes == 0 || src_stride < (size_t)width * srcBytes) return EDGE_ERROR_ARGUMENT;
+	if (dst_format != EDGE_FORMAT_GRAY8 && dst_format != EDGE_FORMAT_GRAY32) return EDGE_ERROR_ARGUMENT;
+	if (dst_stride < (size_t)dst_width * shared_bytes_per_pixel(dst_format)) return EDGE_ERROR_ARGUMENT;
+
+	// the far edges are summed in long long, caller values may not fit an int
+	long long dstX1 = (long long)dst_x + dst_width, dstY1 = (long long)dst_y + dst_height;
+	if (dstX1 > INT_MAX || dstY1 > INT_MAX) return EDGE_ERROR_ARGUMENT;
+	for (int k = 0; k < count; k++) {
+		if (rects[k].width < 0 || rects[k].height < 0) return EDGE_ERROR_ARGUMENT;
+	}
+
+	return guarded([&] {
+		vector<RoiRect> regions;
+		for (int k = 0; k < count; k++) {
+			// the clip below cuts to the image anyway, clamping first keeps the sums in range
+			int x1 = (int)min((long long)rects[k].x + rects[k].width, (long long)width);
+			int y1 = (int)min((long long)rects[k].y + rects[k].height, (long long)height);
+			RoiRect rect = {rects[k].x, rects[k].y, x1, y1};
+			if (!roi_clip(rect, width, height)) continue;
+			if (rect.x0 < dst_x || rect.y0 < dst_y || rect.x1 > dstX1 || rect.y1 > dstY1) return EDGE_ERROR_ARGUMENT;
+			regions.push_back(rect);
+		}
+
+		// rectangles, formats and sizes are checked, shared_filter_regions only fails to allocate
+		SharedImage in = {(unsigned char *)src, src_format, width, height, src_stride};
+		SharedImage out = {dst, dst_format, dst_width, dst_height, dst_stride};
+		bool ok = shared_filter_regions(engine->engine, op, in, out, dst_x, dst_y, regions.data(), (int)regions.size(), threshold);
+		return ok ? EDGE_OK : EDGE_ERROR_MEMORY;
+	});
+}
+
+const char *edge_error_string(int code)
+{
+	switch (code) {
+		case EDGE_OK: return "ok";
+		case EDGE_ERROR_ARGUMENT: return "invalid argument";
+		case EDGE_ERROR_MEMORY: return "out of memory";
+		case EDGE_ERROR_INTERNAL: return "internal error";
+		default: return "unknown error";
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * EdgeDetectApi.h
+ *
+ *  C interface of libedgedetect, for embedding the detectors in C, C++ and
+ *  FFI callers. An engine handle owns the configuration (kernel, window
+ *  distance, tiling) and its own worker arena; images are caller owned
+ *  8 bit gray, BGR or BGRA buffers with any row stride, the result is
+ *  written into a caller owned 8 bit (or 32 bit) gray buffer. A region of
+ *  interest is passed as a pointer to its first pixel together with the
+ *  stride of the full image; its edges are treated as image borders.
+ *  edge_detect_roi instead keeps the whole image as context and computes
+ *  only some rectangles of it, reading just their surroundings.
+ *
+ *  Nothing here reads or changes the globals of the command line program,
+ *  so several engines with different settings can be used at the same
+ *  time, and one engine from several threads.
+ */
+
+#ifndef EDGEDETECTAPI_H_
+#define EDGEDETECTAPI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EDGE_API_VERSION		3		// 2: edge_detect_roi, 3: EDGE_ERROR_INTERNAL
+
+// the library is built with -fvisibility=hidden, only these functions are exported
+#if defined(__GNUC__)
+#define EDGE_EXPORT				__attribute__((visibility("default")))
+#else
+#define EDGE_EXPORT
+#endif
+
+#define EDGE_OK					0
+#define EDGE_ERROR_ARGUMENT		-1		// NULL handle or buffer, bad size, stride, format or operator
+#define EDGE_ERROR_MEMORY		-2
+#define EDGE_ERROR_INTERNAL		-3		// unexpected failure inside the library (e.g. the thread pool), no C++ exception leaves it
+
+#define EDGE_OP_PREWITT			1
+#define EDGE_OP_EDGE			2
+
+#define EDGE_FORMAT_GRAY8		0
+#define EDGE_FORMAT_BGR24		1
+#define EDGE_FORMAT_BGRA32		2
+#define EDGE_FORMAT_GRAY32		3		// int32_t gray values
+
+typedef struct edge_config {
+	int threads;						// worker threads, 0 for all cores
+	int kernel_size;					// Prewitt kernel, odd, 1..15
+	const int *weights_x;				// kernel_size * kernel_size weights, NULL for the built-in tables
+	const int *weights_y;
+	int distance;						// edge detection window radius, 2 * distance + 1 <= 15
+	int tile_rows;						// rows of one parallel tile
+	int tile_aspect;					// tile width in tile_rows, 0 for full rows
+} edge_config;
+
+typedef struct edge_engine edge_engine;
+
+typedef struct edge_rect {
+	int x;
+	int y;
+	int width;
+	int height;
+} edge_rect;
+
+/**
+* @brief EDGE_API_VERSION the library was built with.
+*/
+EDGE_EXPORT int edge_api_version(void);
+
+/**
+* @brief Fills the defaults of the command line program (kernel 7, distance 1,
+* 200 row tiles, square tiles, all cores).
+*/
+EDGE_EXPORT void edge_config_default(edge_config *config);
+
+/**
+* @brief Creates an engine, its worker threads are started right away.
+*
+* @param config settings, NULL for edge_config_default
+* @return NULL for an invalid configuration or if the engine cannot be created
+*/
+EDGE_EXPORT edge_engine *edge_engine_create(const edge_config *config);
+
+EDGE_EXPORT void edge_engine_destroy(edge_engine *engine);
+
+/**
+* @brief Runs one operator. The source is only read. Edge detection thresholds
+* the source with threshold before looking at the windows.
+*
+* @param op EDGE_OP_PREWITT or EDGE_OP_EDGE
+* @param src_stride bytes between starts of two source rows
+* @param dst_format EDGE_FORMAT_GRAY8 or EDGE_FORMAT_GRAY32, 0 or 255 per pixel
+* @param dst_stride bytes between starts of two destination rows
+* @return EDGE_OK or EDGE_ERROR_*
+*/
+EDGE_EXPORT int edge_detect(edge_engine *engine, int op, const uint8_t *src, int src_format, size_t src_stride,
+		uint8_t *dst, int dst_format, size_t dst_stride, int width, int height, int threshold);
+
+/**
+* @brief Runs one operator on rectangles of the image only, with the same result
+* there as edge_detect on the whole image. Only the rectangles and a border of
+* the window radius around them are read, the time taken follows their area.
+* Rectangles are cut to the image and may overlap; destination pixels outside
+* them are left unchanged.
+*
+* @param rects count rectangles in image coordinates
+* @param dst full size destination or a crop holding every rectangle, its first
+* pixel is image pixel (dst_x, dst_y)
+* @param dst_width destination size in pixels
+* @return EDGE_OK or EDGE_ERROR_*, EDGE_ERROR_ARGUMENT for a rectangle outside dst
+*/
+EDGE_EXPORT int edge_detect_roi(edge_engine *engine, int op, const uint8_t *src, int src_format, size_t src_stride,
+		int width, int height, const edge_rect *rects, int count,
+		uint8_t *dst, int dst_format, size_t dst_stride, int dst_x, int dst_y, int dst_width, int dst_height, int threshold);
+
+EDGE_EXPORT const char *edge_error_string(int code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EDGEDETECTAPI_H_ */
@@ -0,0 +1,339 @@
+/*
+ * EdgeEngine.cpp
+ *
+ *  Persistent engine: warm arena, pooled buffers, precomputed kernels.
+ */
+
+#include "EdgeEngine.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include "ShadowVerify.h"
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+
+#define ENGINE_SERIAL_PIXELS	(1 << 16)
+
+using namespace std;
+using namespace tbb;
+
+
+EdgeEngine::EdgeEngine(int threads) : arena(threads), pooledBytes(0), serialPixels(ENGINE_SERIAL_PIXELS), tileRows(0), tileAspect(0), callerArena(false)
+{
+	// start the workers now, so the first image does not pay for it
+	arena.initialize();
+	configure();
+}
+
+EdgeEngine::~EdgeEngine()
+{
+	trim();
+}
+
+void EdgeEngine::configure()
+{
+	configure(FILTER_SIZE, filterHor, filterVer, DISTANCE);
+}
+
+void EdgeEngine::configure(int filterSize, const int *hor, const int *ver, int distance)
+{
+	// the border pixels read the full tables, keep our own copy
+	copy(hor, hor + filterSize * filterSize, weightsHor);
+	copy(ver, ver + filterSize * filterSize, weightsVer);
+	simd_kernel_prewitt_weights(prewittKernel, filterSize, weightsHor, weightsVer, THRESHOLD);
+	simd_kernel_edge_distance(edgeKernel, distance, THRESHOLD);
+}
+
+void EdgeEngine::setTiling(int rows, int aspect)
+{
+	tileRows = rows;
+	tileAspect = aspect;
+}
+
+void EdgeEngine::setSerialPixels(long long pixels)
+{
+	serialPixels = pixels;
+}
+
+void EdgeEngine::setCallerArena(bool enabled)
+{
+	callerArena = enabled;
+}
+
+int *EdgeEngine::acquire(int width, int height)
+{
+	long long size = (long long)width * height;
+	{
+		spin_mutex::scoped_lock lock(poolMutex);
+		map<long long, vector<int *> >::iterator it = pool.find(size);
+		if (it != pool.end() && !it->second.empty()) {
+			int *buffer = it->second.back();
+			it->second.pop_back();
+			pooledBytes -= size * sizeof(int);
+			return buffer;
+		}
+	}
+	return pool_alloc_image(width, height);
+}
+
+void EdgeEngine::release(int *buffer, int width, int height)
+{
+	if (buffer == NULL) return;
+
+	long long size = (long long)width * height;
+	size_t bytes = size * sizeof(int);
+	{
+		spin_mutex::scoped_lock lock(poolMutex);
+		vector<int *> &buffers = pool[size];
+		if ((buffers.size() + 1) * bytes <= POOL_CLASS_LIMIT && pooledBytes + bytes <= POOL_TOTAL_LIMIT) {
+			// the vector keeps its capacity, so pushing back a taken buffer does not allocate
+			buffers.push_back(buffer);
+			pooledBytes += bytes;
+			return;
+		}
+	}
+	pool_free_image(buffer, width, height);
+}
+
+void EdgeEngine::trim()
+{
+	spin_mutex::scoped_lock lock(poolMutex);
+	for (map<long long, vector<int *> >::iterator it = pool.begin(); it != pool.end(); ++it) {
+		for (size_t k = 0; k < it->second.size(); k++) {
+			pool_free(it->second[k], it->first * sizeof(int));
+		}
+	}
+	pool.clear();
+	pooledBytes = 0;
+}
+
+/**
+* @brief Tile size for an image (or rectangle) of given width.
+*/
+void EdgeEngine::tileShape(int width, int &tileWidth, int &tileHeight) const
+{
+	int rows = tileRows > 0 ? tileRows : CUTOFF;
+	int aspect = tileRows > 0 ? tileAspect : TILE_ASPECT;
+	tileHeight = max(1, rows);
+	tileWidth = aspect > 0 ? max(1, rows * aspect) : max(1, width);
+}
+
+/**
+* @brief Runs body in the engine arena, or right here with setCallerArena.
+*/
+template <typename Body>
+void EdgeEngine::execute(const Body &body)
+{
+	if (callerArena) body();
+	else arena.execute(body);
+}
+
+/**
+* @brief Calls body(x0, y0, x1, y1) for every tile. Small images are a single tile
+* on the calling thread, big ones are split with CUTOFF inside the engine arena.
+* Body is a template argument, not std::function, so nothing is allocated.
+*/
+template <typename Body>
+void EdgeEngine::forEachTile(int width, int height, const Body &body)
+{
+	if ((long long)width * height < serialPixels) {
+		body(0, 0, width, height);
+		return;
+	}
+
+	int tileWidth, tileHeight;
+	tileShape(width, tileWidth, tileHeight);
+
+	execute([&] {
+		parallel_for(blocked_range2d<int>(0, height, tileHeight, 0, width, tileWidth), [&](const blocked_range2d<int> &r) {
+			TRACE_SCOPE("tile", TRACE_TASK);
+			body(r.cols().begin(), r.rows().begin(), r.cols().end(), r.rows().end());
+		});
+	});
+}
+
+/**
+* @brief Calls body(tile) for tiles of all jobs, each tile keeps the output of its job.
+* Rectangles are cut into engine tiles, so one big rectangle still spreads over
+* all workers; a small total area runs on the calling thread.
+*/
+template <typename Body>
+void EdgeEngine::forEachJobTile(const vector<RoiJob> &jobs, const Body &body)
+{
+	long long area = 0;
+	for (size_t k = 0; k < jobs.size(); k++) area += roi_area(jobs[k].rect);
+	if (area < serialPixels) {
+		for (size_t k = 0; k < jobs.size(); k++) body(jobs[k]);
+		return;
+	}
+
+	vector<RoiJob> tiles;
+	for (size_t k = 0; k < jobs.size(); k++) {
+		const RoiRect &rect = jobs[k].rect;
+		int tileWidth, tileHeight;
+		tileShape(rect.x1 - rect.x0, tileWidth, tileHeight);
+		for (int y = rect.y0; y < rect.y1; y += tileHeight) {
+			for (int x = rect.x0; x < rect.x1; x += tileWidth) {
+				RoiJob tile = {{x, y, min(rect.x1, x + tileWidth), min(rect.y1, y + tileHeight)}, jobs[k].out, jobs[k].outX, jobs[k].outY};
+				tiles.push_back(tile);
+			}
+		}
+	}
+
+	execute([&] {
+		parallel_for(blocked_range<size_t>(0, tiles.size(), 1), [&](const blocked_range<size_t> &r) {
+			for (size_t t = r.begin(); t != r.end(); t++) {
+				TRACE_SCOPE("tile", TRACE_TASK);
+				body(tiles[t]);
+			}
+		});
+	});
+}
+
+void EdgeEngine::prewitt(const int *inBuffer, int *outBuffer, int width, int height)
+{
+	prewittView(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height), THRESHOLD);
+}
+
+void EdgeEngine::prewittView(ImageView<const int> in, ImageView<int> out, int threshold)
+{
+	// tables are shared between calls, offsets depend on the stride of this image
+	SimdKernel kernel = prewittKernel;
+	kernel.threshold = threshold;
+	simd_kernel_bind(kernel, in.stride);
+
+	forEachTile(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_prewitt(kernel, in, out, x0, y0, x1, y1);
+	});
+}
+
+void EdgeEngine::edgeDetection(const int *inBuffer, int *outBuffer, int width, int height)
+{
+	edgeDetectionView(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height), THRESHOLD);
+}
+
+void EdgeEngine::edgeDetectionView(ImageView<const int> in, ImageView<int> out, int threshold)
+{
+	int width = in.width, height = in.height;
+	SimdKernel kernel = edgeKernel;
+	ImageView<int> scratch(acquire(width, height), width, height);
+	simd_kernel_bind(kernel, scratch.stride);
+
+	// every tile reads a halo of DISTANCE rows, so the whole image is thresholded first,
+	// the tiles starting at column 0 cover every row exactly once
+	forEachTile(width, height, [&](int x0, int y0, int, int y1) {
+		if (x0 == 0) simd_threshold_edge_copy(in, scratch, y0, y1, threshold);
+	});
+	forEachTile(width, height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_edge_detection(kernel, scratch, out, x0, y0, x1, y1);
+	});
+
+	release(scratch.data, width, height);
+}
+
+void EdgeEngine::run(int op, const int *inBuffer, int *outBuffer, int width, int height)
+{
+	run(op, ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void EdgeEngine::run(int op, ImageView<const int> in, ImageView<int> out)
+{
+	ShadowSample *shadow = shadow_capture(op, -1, in.data, in.width, in.height, in.stride);
+	run(op, in, out, THRESHOLD);
+	shadow_submit(shadow, out.data, out.stride);
+}
+
+void EdgeEngine::run(int op, ImageView<const int> in, ImageView<int> out, int threshold)
+{
+	if (op == OP_PREWITT) prewittView(in, out, threshold);
+	else edgeDetectionView(in, out, threshold);
+}
+
+void EdgeEngine::run(int op, const ImageBuffer &in, ImageBuffer &out)
+{
+	run(op, in.view(), out.view());
+}
+
+void EdgeEngine::run(int op, const ImageBuffer &in, ImageBuffer &out, int threshold)
+{
+	run(op, in.view(), out.view(), threshold);
+}
+
+int EdgeEngine::radius(int op) const
+{
+	return op == OP_PREWITT ? prewittKernel.radius : edgeKernel.radius;
+}
+
+void EdgeEngine::runJobs(int op, ImageView<const int> in, const vector<RoiJob> &jobs, int threshold)
+{
+	int width = in.width, height = in.height;
+
+	if (op == OP_PREWITT) {
+		SimdKernel kernel = prewittKernel;
+		kernel.threshold = threshold;
+		simd_kernel_bind(kernel, in.stride);
+		forEachJobTile(jobs, [&](const RoiJob &tile) {
+			simd_kernel_region_prewitt(kernel, in, tile.out, tile.rect.x0, tile.rect.y0, tile.rect.x1, tile.rect.y1, tile.outX, tile.outY);
+		});
+		return;
+	}
+
+	// only what the windows read is thresholded, every pixel of it once
+	vector<RoiRect> reads, pieces;
+	for (size_t k = 0; k < jobs.size(); k++) roi_reads(jobs[k].rect, width, height, edgeKernel.radius, reads);
+	roi_disjoint(reads.data(), (int)reads.size(), pieces);
+
+	SimdKernel kernel = edgeKernel;
+	ImageView<int> scratch(acquire(width, height), width, height);
+	simd_kernel_bind(kernel, scratch.stride);
+
+	vector<RoiJob> thresholdJobs;
+	for (size_t k = 0; k < pieces.size(); k++) {
+		RoiJob job = {pieces[k], scratch, 0, 0};
+		thresholdJobs.push_back(job);
+	}
+	forEachJobTile(thresholdJobs, [&](const RoiJob &tile) {
+		const RoiRect &r = tile.rect;
+		simd_threshold_edge_copy(in.sub(r.x0, r.y0, r.x1, r.y1), scratch.sub(r.x0, r.y0, r.x1, r.y1), 0, r.y1 - r.y0, threshold);
+	});
+	forEachJobTile(jobs, [&](const RoiJob &tile) {
+		simd_kernel_region_edge_detection(kernel, scratch, tile.out, tile.rect.x0, tile.rect.y0, tile.rect.x1, tile.rect.y1, tile.outX, tile.outY);
+	});
+
+	release(scratch.data, width, height);
+}
+
+void EdgeEngine::runRegions(int op, ImageView<const int> in, ImageView<int> out, int outX, int outY,
+		const RoiRect *rects, int count, int threshold)
+{
+	vector<RoiRect> clipped, pieces;
+	for (int k = 0; k < count; k++) {
+		RoiRect rect = rects[k];
+		if (roi_clip(rect, in.width, in.height)) clipped.push_back(rect);
+	}
+	roi_disjoint(clipped.data(), (int)clipped.size(), pieces);
+
+	vector<RoiJob> jobs;
+	for (size_t k = 0; k < pieces.size(); k++) {
+		RoiJob job = {pieces[k], out, outX, outY};
+		jobs.push_back(job);
+	}
+	if (!jobs.empty()) runJobs(op, in, jobs, threshold);
+}
+
+void EdgeEngine::runRegions(int op, ImageView<const int> in, ImageView<int> out, const RoiRect *rects, int count)
+{
+	runRegions(op, in, out, 0, 0, rects, count, THRESHOLD);
+}
+
+void EdgeEngine::runCrops(int op, ImageView<const int> in, const RoiRect *rects, const ImageView<int> *crops, int count, int threshold)
+{
+	vector<RoiJob> jobs;
+	for (int k = 0; k < count; k++) {
+		if (roi_empty(rects[k])) continue;
+		RoiJob job = {rects[k], crops[k], rects[k].x0, rects[k].y0};
+		jobs.push_back(job);
+	}
+	if (!jobs.empty()) runJobs(op, in, jobs, threshold);
+}
@@ -0,0 +1,173 @@
+/*
+ * EdgeEngine.h
+ *
+ *  Reusable detector for services that filter many images. The engine owns
+ *  its task_arena (created once, workers stay warm between calls), a pool
+ *  of aligned buffers keyed by image size and the kernel tables of
+ *  both operators. After the first image of a given size, calls do no heap
+ *  allocation of their own. Calls from several threads may overlap.
+ *
+ *  runRegions and runCrops filter only rectangles of interest: they read
+ *  the rectangles and their halos and take time in proportion to the
+ *  rectangle area (their short rectangle lists are the only allocations).
+ */
+
+#ifndef EDGEENGINE_H_
+#define EDGEENGINE_H_
+
+#include <map>
+#include <vector>
+#include <tbb/task_arena.h>
+#include <tbb/spin_mutex.h>
+#include "SimdFilters.h"
+#include "ImageBuffer.h"
+#include "RegionOfInterest.h"
+
+class EdgeEngine {
+private:
+	tbb::task_arena arena;
+	tbb::spin_mutex poolMutex;
+	std::map<long long, std::vector<int *> > pool;
+	size_t pooledBytes;
+	SimdKernel prewittKernel;
+	SimdKernel edgeKernel;
+	int weightsHor[MAX_TAPS];
+	int weightsVer[MAX_TAPS];
+	long long serialPixels;
+	int tileRows;
+	int tileAspect;
+	bool callerArena;
+
+	/**
+	* @brief One rectangle and the output it is written to, pixel (x, y) goes to out.at(x - outX, y - outY).
+	*/
+	struct RoiJob {
+		RoiRect rect;
+		ImageView<int> out;
+		int outX, outY;
+	};
+
+	EdgeEngine(const EdgeEngine &);
+
+	void tileShape(int width, int &tileWidth, int &tileHeight) const;
+	template <typename Body>
+	void execute(const Body &body);
+	template <typename Body>
+	void forEachTile(int width, int height, const Body &body);
+	template <typename Body>
+	void forEachJobTile(const std::vector<RoiJob> &jobs, const Body &body);
+	void runJobs(int op, ImageView<const int> in, const std::vector<RoiJob> &jobs, int threshold);
+	void prewittView(ImageView<const int> in, ImageView<int> out, int threshold);
+	void edgeDetectionView(ImageView<const int> in, ImageView<int> out, int threshold);
+public:
+	/**
+	* @brief Creates engine and its arena.
+	*
+	* @param threads arena concurrency, tbb::task_arena::automatic for all cores
+	*/
+	EdgeEngine(int threads = tbb::task_arena::automatic);
+	~EdgeEngine();
+
+	/**
+	* @brief Rebuilds kernel tables from FILTER_SIZE, filterHor/filterVer and DISTANCE.
+	* Must not overlap with running filters.
+	*/
+	void configure();
+
+	/**
+	* @brief Rebuilds kernel tables from explicit parameters, the weights are copied.
+	* Must not overlap with running filters.
+	*
+	* @param hor horizontal Prewitt weights, filterSize * filterSize
+	* @param ver vertical Prewitt weights, filterSize * filterSize
+	*/
+	void configure(int filterSize, const int *hor, const int *ver, int distance);
+
+	/**
+	* @brief Tile size of the engine, tileRows 0 follows CUTOFF and TILE_ASPECT (default).
+	*/
+	void setTiling(int tileRows, int tileAspect);
+
+	/**
+	* @brief Images with fewer pixels run on the calling thread, without entering the arena.
+	*/
+	void setSerialPixels(long long pixels);
+
+	/**
+	* @brief Run tiles as tasks of the calling thread's arena instead of the engine
+	* arena. For callers that are TBB tasks themselves (batch pipeline tokens): a
+	* thread waiting for its tiles can then steal tiles and tokens of other images.
+	*/
+	void setCallerArena(bool enabled);
+
+	/**
+	* @brief Takes a buffer of width * height ints from the pool, allocated on first use.
+	*/
+	int *acquire(int width, int height);
+
+	/**
+	* @brief Returns a buffer taken with acquire to the pool. Past POOL_CLASS_LIMIT bytes of
+	* one size or POOL_TOTAL_LIMIT in all, the buffer goes back to the image pool instead.
+	*/
+	void release(int *buffer, int width, int height);
+
+	/**
+	* @brief Returns all pooled buffers to the image pool.
+	*/
+	void trim();
+
+	void prewitt(const int *inBuffer, int *outBuffer, int width, int height);
+
+	/**
+	* @brief Edge detection, unlike filter_edge_detection inBuffer is left unchanged
+	* (thresholded copy is kept in a pooled scratch buffer).
+	*/
+	void edgeDetection(const int *inBuffer, int *outBuffer, int width, int height);
+
+	void run(int op, const int *inBuffer, int *outBuffer, int width, int height);
+
+	/**
+	* @brief Runs op on views of equal size, strides may differ. in is left unchanged.
+	*/
+	void run(int op, ImageView<const int> in, ImageView<int> out);
+
+	/**
+	* @brief Same as run on views, with an explicit threshold instead of
+	* THRESHOLD. Reads no globals when the engine was configured with explicit
+	* parameters and tiling; shadow verification does not cover it.
+	*/
+	void run(int op, ImageView<const int> in, ImageView<int> out, int threshold);
+
+	void run(int op, const ImageBuffer &in, ImageBuffer &out);
+	void run(int op, const ImageBuffer &in, ImageBuffer &out, int threshold);
+
+	/**
+	* @brief Window radius of op, the halo a rectangle of interest reads.
+	*/
+	int radius(int op) const;
+
+	/**
+	* @brief Runs op on rectangles of in only, with the result of the whole image
+	* filter there. in is read inside the rectangles and their halos (roi_reads),
+	* pixels of out outside the rectangles are left unchanged. Rectangles are cut
+	* to the image, overlapping ones are computed once, all of them in parallel.
+	*
+	* @param out the full image or a crop holding every rectangle, its pixel (0, 0)
+	* is image pixel (outX, outY)
+	*/
+	void runRegions(int op, ImageView<const int> in, ImageView<int> out, int outX, int outY,
+			const RoiRect *rects, int count, int threshold);
+
+	/**
+	* @brief runRegions into a full size out, with THRESHOLD.
+	*/
+	void runRegions(int op, ImageView<const int> in, ImageView<int> out, const RoiRect *rects, int count);
+
+	/**
+	* @brief Same as runRegions, rectangle k is written to crops[k], a view of its
+	* size. Rectangles must lie inside the image.
+	*/
+	void runCrops(int op, ImageView<const int> in, const RoiRect *rects, const ImageView<int> *crops, int count, int threshold);
+};
+
+#endif /* EDGEENGINE_H_ */
@@ -0,0 +1,742 @@
+/*
+ * EdgeFilters.cpp
+ *
+ *  Prewitt and edge detection filters: serial reference versions,
+ *  recursive task_group versions and tiled versions.
+ */
+
+#include <stdlib.h>
+#include <tbb/task_group.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+#include <string.h>
+#include <algorithm>
+#include "EdgeFilters.h"
+#include "SimdFilters.h"
+#include "NumaPlacement.h"
+#include "FlatRegions.h"
+#include "Trace.h"
+
+int FILTER_SIZE = 7;
+int THRESHOLD = 128;
+int CUTOFF = 200;
+int DISTANCE = 1;
+int TILE_ASPECT = 1;
+int TILE_ORDER = TILE_ORDER_RECURSIVE;
+
+using namespace std;
+using namespace tbb;
+
+
+// Prewitt operators
+int filterHor[MAX_FILTER_SIZE * MAX_FILTER_SIZE] = {-1, 0, 1, -1, 0, 1, -1, 0, 1};
+int filterVer[MAX_FILTER_SIZE * MAX_FILTER_SIZE] = {-1, -1, -1, 0, 0, 0, 1, 1, 1};
+
+
+/*
+* @brief checking if index is in range of matrix indices
+* 
+* @param index index that we need to chech
+* @param height image height
+* @param width image width
+*/
+bool check_if_border_case(int index, int height, int width) {
+	if ((index <= 0) || (index >= width * height)) return true;
+	return false;
+}
+
+
+/**
+* @brief Serial version of edge detection algorithm implementation using Prewitt operator
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+
+void filter_serial_prewitt(int *inBuffer, int *outBuffer, int width, int height) 
+{
+	int offset = (FILTER_SIZE - 1) / 2;
+
+	for (int i = 0; i < width; i++) { 
+		for (int j = 0; j < height; j++) {
+			int Gx = 0, Gy = 0, G = 0;
+			
+			for (int m = 0; m < FILTER_SIZE; m++) {
+				for (int n = 0; n < FILTER_SIZE; n++) {
+					int index = (j - offset + m) * width + (i - offset + n);
+					if (check_if_border_case(index, height, width)) continue;
+					Gx += inBuffer[index] * filterHor[m * FILTER_SIZE + n]; 
+					Gy += inBuffer[index] * filterVer[m * FILTER_SIZE + n];
+				}
+			}
+			G = abs(Gx) + abs(Gy);
+
+			// transferring to black or white color
+			if (G >= THRESHOLD) outBuffer[j * width + i] = 255;
+			else outBuffer[j * width + i] = 0;
+			
+		}
+	}
+}
+
+
+/**
+* @brief Parallel version of edge detection algorithm implementation using Prewitt operator
+* 
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+
+
+void filter_parallel_prewitt(int row, int col, int width, int height, int *inBuffer, int *outBuffer, int _width, int _height)
+{
+	int offset = (FILTER_SIZE - 1) / 2;
+
+	if (width <= CUTOFF || height <= CUTOFF) {
+		TRACE_SCOPE("leaf", TRACE_TASK);
+		for (int i = 0; i < width; i++) {
+			for (int j = 0; j < height; j++) {
+				int Gx = 0, Gy = 0, G = 0;
+
+				for (int m = 0; m < FILTER_SIZE; m++) {
+					for (int n = 0; n < FILTER_SIZE; n++) {
+						int index = (j + m + col - offset) * _width + (i + n + row - offset);
+						if(check_if_border_case(index, _height, _width)) continue;
+						Gx += inBuffer[index] * filterHor[m * FILTER_SIZE + n];
+						Gy += inBuffer[index] * filterVer[m * FILTER_SIZE + n];
+					}
+				}
+				G = abs(Gx) + abs(Gy);
+
+				// transferring to black or white color
+				if (G >= THRESHOLD) outBuffer[(j + col) * _width + i + row] = 255;
+				else outBuffer[(j + col) * _width + i + row] = 0;
+			}
+		}
+	}
+	else {
+		// right and bottom quarters take the odd column / row
+		int left = width / 2, top = height / 2;
+		task_group t;
+		t.run([&] {filter_parallel_prewitt(row, col, left, top, inBuffer, outBuffer, _width, _height); });
+		t.run([&] {filter_parallel_prewitt(row + left, col, width - left, top, inBuffer, outBuffer, _width, _height); });
+		t.run([&] {filter_parallel_prewitt(row, col + top, left, height - top, inBuffer, outBuffer, _width, _height); });
+		t.run([&] {filter_parallel_prewitt(row + left, col + top, width - left, height - top, inBuffer, outBuffer, _width, _height); });
+		t.wait();
+	}
+}
+
+/**
+* @brief Serial version of edge detection algorithm
+* 
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+void filter_serial_edge_detection(int *inBuffer, int *outBuffer, int width, int height)	//TODO obrisati
+{
+	int iter = DISTANCE * 2 + 1;
+
+	// setting every element to 0 or 1, depending on threshold
+	for (int i = 0; i < width; i++) {
+		for (int j = 0; j < height; j++) {
+			int index = j * width + i;
+			if (inBuffer[index] >= THRESHOLD) inBuffer[index] = 0;
+			else inBuffer[index] = 1;
+		}
+	}
+
+	for (int i = 0; i < width ; i++) {
+		for (int j = 0; j < height; j++) {
+			int P = 0, O = 1, G = 0;
+
+			for (int m = 0; m < iter; m++) {
+				for (int n = 0; n < iter; n++) {
+					int index = (j - DISTANCE + m) * width + (i - DISTANCE + n);
+					if (check_if_border_case(index, height, width)) continue;
+					if (m == 0 && n == 0) continue;
+					if (inBuffer[index] == 1) P = 1;
+					else if (inBuffer[index] == 0) O = 0;
+				}
+			}
+
+			G = abs(P) - abs(O);
+			if (G == 0) outBuffer[j * width + i] = 0;
+			else outBuffer[j * width + i] = 255;
+		}
+	}
+}
+
+/*
+* @brief parallel version of edge detecion algorithm
+* 
+* @param row row in submatrix 
+* @param col col in submatrix
+* @param width image width
+* @param height image height
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param _height height of submatrix
+* @param _width width of submatrix
+*/
+
+void next_iter_parallel_edge_detection(int row, int col, int width, int height, int* inBuffer, int* outBuffer, int _width, int _height) {
+	int iter = DISTANCE * 2 + 1;
+	
+	if (width <= CUTOFF || height <= CUTOFF) {
+		TRACE_SCOPE("leaf", TRACE_TASK);
+		for (int i = 0; i < width; i++) {
+			for (int j = 0; j < height; j++) {
+				int P = 0, O = 1, G = 0;
+
+				for (int m = 0; m < iter; m++) {
+					for (int n = 0; n < iter; n++) {
+						int index = (j + n + col - DISTANCE) * _width + (i + m + row - DISTANCE);
+						if (check_if_border_case(index, _height, _width)) continue;
+						if (m == 0 && n == 0) continue;
+						if (inBuffer[index] == 1) P = 1;
+						else if (inBuffer[index] == 0) O = 0;
+					}
+				}
+
+				G = abs(P) - abs(O);
+				if (G == 0) outBuffer[(j + col) * _width + i + row] = 0;
+				else outBuffer[(j + col) * _width + i + row] = 255;
+			}
+		}
+	}
+	else {
+		int left = width / 2, top = height / 2;
+		task_group t;
+		t.run([&] {next_iter_parallel_edge_detection(row, col, left, top, inBuffer, outBuffer, _width,_height); });
+		t.run([&] {next_iter_parallel_edge_detection(row + left, col, width - left, top, inBuffer, outBuffer, _width, _height); });
+		t.run([&] {next_iter_parallel_edge_detection(row, col + top, left, height - top, inBuffer, outBuffer, _width, _height); });
+		t.run([&] {next_iter_parallel_edge_detection(row + left, col + top, width - left, height - top, inBuffer, outBuffer, _width, _height); });
+		t.wait();
+	}
+}
+
+/**
+* @brief Parallel version of edge detection algorithm
+* 
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+void filter_parallel_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	{
+		TRACE_SCOPE("threshold", TRACE_STAGE);
+		for (int i = 0; i < width; i++) {
+			for (int j = 0; j < height; j++) {
+				int index = j * width + i;
+				if (inBuffer[index] >= THRESHOLD) inBuffer[index] = 0;
+				else inBuffer[index] = 1;
+			}
+		}
+	}
+	next_iter_parallel_edge_detection(0, 0, width, height, inBuffer, outBuffer, width, height);
+}
+
+/**
+* @brief Memory position of a linear pixel index in an image with padded rows.
+* Border handling works on linear indices (so windows wrap into the neighbour
+* row), the padding must not change which pixel such an index names.
+*/
+static inline long long strided_index(int index, int width, int stride)
+{
+	if (stride == width) return index;
+	return (long long)(index / width) * stride + index % width;
+}
+
+/**
+* @brief Prewitt filter over one rectangle of the image, same arithmetic as
+* filter_serial_prewitt but walking rows in memory order.
+*
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+* @param x0 first column of the rectangle
+* @param y0 first row of the rectangle
+* @param x1 column after the rectangle
+* @param y1 row after the rectangle
+*/
+void filter_region_prewitt(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1)
+{
+	filter_region_prewitt_strided(inBuffer, outBuffer, width, height, width, x0, y0, x1, y1);
+}
+
+/**
+* @brief Prewitt value of pixel (i, j). Input memory position of a linear index
+* is strided_index minus shift, so the input may start at a later row.
+*/
+static inline int prewitt_pixel(const int *inBuffer, int width, int height, int stride, long long shift, int i, int j,
+		int filterSize, const int *hor, const int *ver, int threshold)
+{
+	int offset = (filterSize - 1) / 2;
+	int Gx = 0, Gy = 0, G = 0;
+	// windows that do not wrap into the neighbour row need no division per tap
+	bool inRow = i >= offset && i + offset < width;
+
+	for (int m = 0; m < filterSize; m++) {
+		for (int n = 0; n < filterSize; n++) {
+			int index = (j - offset + m) * width + (i - offset + n);
+			if (check_if_border_case(index, height, width)) continue;
+			long long position = (inRow ? (long long)(j - offset + m) * stride + i - offset + n : strided_index(index, width, stride)) - shift;
+			Gx += inBuffer[position] * hor[m * filterSize + n];
+			Gy += inBuffer[position] * ver[m * filterSize + n];
+		}
+	}
+	G = abs(Gx) + abs(Gy);
+
+	// transferring to black or white color
+	return G >= threshold ? 255 : 0;
+}
+
+/**
+* @brief Edge detection value of pixel (i, j) of a thresholded image, see prewitt_pixel
+*/
+static inline int edge_pixel(const int *inBuffer, int width, int height, int stride, long long shift, int i, int j, int distance)
+{
+	int iter = distance * 2 + 1;
+	int P = 0, O = 1, G = 0;
+	bool inRow = i >= distance && i + distance < width;
+
+	for (int m = 0; m < iter; m++) {
+		for (int n = 0; n < iter; n++) {
+			int index = (j - distance + m) * width + (i - distance + n);
+			if (check_if_border_case(index, height, width)) continue;
+			if (m == 0 && n == 0) continue;
+			long long position = (inRow ? (long long)(j - distance + m) * stride + i - distance + n : strided_index(index, width, stride)) - shift;
+			if (inBuffer[position] == 1) P = 1;
+			else if (inBuffer[position] == 0) O = 0;
+		}
+	}
+
+	G = abs(P) - abs(O);
+	return G == 0 ? 0 : 255;
+}
+
+/**
+* @brief Same as filter_region_prewitt, rows of both buffers are stride ints apart
+*/
+void filter_region_prewitt_strided(int *inBuffer, int *outBuffer, int width, int height, int stride, int x0, int y0, int x1, int y1)
+{
+	filter_region_prewitt_view(ImageView<const int>(inBuffer, width, height, stride), ImageView<int>(outBuffer, width, height, stride),
+		x0, y0, x1, y1, FILTER_SIZE, filterHor, filterVer, THRESHOLD);
+}
+
+/**
+* @brief Prewitt over one rectangle of a view, with explicit parameters instead of the globals
+*
+* @param hor horizontal weights, filterSize * filterSize
+* @param ver vertical weights, filterSize * filterSize
+* @param outX image column of the first out column
+* @param outY image row of the first out row
+*/
+void filter_region_prewitt_view(ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1,
+		int filterSize, const int *hor, const int *ver, int threshold, int outX, int outY)
+{
+	for (int j = y0; j < y1; j++) {
+		int *outRow = out.row(j - outY);
+		for (int i = x0; i < x1; i++) {
+			outRow[i - outX] = prewitt_pixel(in.data, in.width, in.height, in.stride, 0, i, j, filterSize, hor, ver, threshold);
+		}
+	}
+}
+
+/**
+* @brief Edge detection over one rectangle of an already thresholded image.
+*
+* @param inBuffer thresholded buffer of input image (0 or 1 values)
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+* @param x0 first column of the rectangle
+* @param y0 first row of the rectangle
+* @param x1 column after the rectangle
+* @param y1 row after the rectangle
+*/
+void filter_region_edge_detection(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1)
+{
+	filter_region_edge_detection_strided(inBuffer, outBuffer, width, height, width, x0, y0, x1, y1);
+}
+
+/**
+* @brief Same as filter_region_edge_detection, rows of both buffers are stride ints apart
+*/
+void filter_region_edge_detection_strided(int *inBuffer, int *outBuffer, int width, int height, int stride, int x0, int y0, int x1, int y1)
+{
+	filter_region_edge_detection_view(ImageView<const int>(inBuffer, width, height, stride), ImageView<int>(outBuffer, width, height, stride),
+		x0, y0, x1, y1, DISTANCE);
+}
+
+/**
+* @brief Edge detection over one rectangle of a thresholded view, with explicit window distance,
+* out is placed as in filter_region_prewitt_view
+*/
+void filter_region_edge_detection_view(ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int distance,
+		int outX, int outY)
+{
+	for (int j = y0; j < y1; j++) {
+		int *outRow = out.row(j - outY);
+		for (int i = x0; i < x1; i++) {
+			outRow[i - outX] = edge_pixel(in.data, in.width, in.height, in.stride, 0, i, j, distance);
+		}
+	}
+}
+
+/**
+* @brief Prewitt over one rectangle from a copy of some image rows, with
+* explicit parameters instead of the globals (safe on any thread).
+*
+* @param band dense rows bandY0.. of the input image, holding every row the windows of the rectangle read
+* @param bandY0 image row of the first band row
+* @param tileOut dense (x1 - x0) * (y1 - y0) output
+*/
+void filter_band_prewitt(const int *band, int bandY0, int *tileOut, int width, int height, int x0, int y0, int x1, int y1, int filterSize, int threshold)
+{
+	long long shift = (long long)bandY0 * width;
+	for (int j = y0; j < y1; j++) {
+		for (int i = x0; i < x1; i++) {
+			tileOut[(j - y0) * (x1 - x0) + i - x0] = prewitt_pixel(band, width, height, width, shift, i, j, filterSize, filterHor, filterVer, threshold);
+		}
+	}
+}
+
+/**
+* @brief Edge detection over one rectangle from a copy of thresholded image rows, see filter_band_prewitt
+*/
+void filter_band_edge_detection(const int *band, int bandY0, int *tileOut, int width, int height, int x0, int y0, int x1, int y1, int distance)
+{
+	long long shift = (long long)bandY0 * width;
+	for (int j = y0; j < y1; j++) {
+		for (int i = x0; i < x1; i++) {
+			tileOut[(j - y0) * (x1 - x0) + i - x0] = edge_pixel(band, width, height, width, shift, i, j, distance);
+		}
+	}
+}
+
+/**
+* @brief Sets every element of rows y0..y1 to 0 or 1, depending on threshold
+*
+* @param buffer buffer of input image, changed in place
+* @param width image width
+* @param y0 first row
+* @param y1 row after the last one
+*/
+void threshold_edge_input(int *buffer, int width, int y0, int y1)
+{
+	for (int j = y0; j < y1; j++) {
+		for (int i = 0; i < width; i++) {
+			int index = j * width + i;
+			if (buffer[index] >= THRESHOLD) buffer[index] = 0;
+			else buffer[index] = 1;
+		}
+	}
+}
+
+/**
+* @brief Same as threshold_edge_input on rows y0..y1 of a view, in place
+*/
+void threshold_edge_view(ImageView<int> image, int y0, int y1)
+{
+	for (int j = y0; j < y1; j++) {
+		int *row = image.row(j);
+		for (int i = 0; i < image.width; i++) row[i] = row[i] >= THRESHOLD ? 0 : 1;
+	}
+}
+
+/**
+* @brief Runs body over tiles of the image in parallel. Tiles are CUTOFF rows
+* high and CUTOFF * TILE_ASPECT columns wide (full rows when TILE_ASPECT is 0).
+* TILE_ORDER_RECURSIVE lets blocked_range2d split the image recursively,
+* TILE_ORDER_ROWS hands out tiles in row-major order so neighbouring tasks
+* share the rows of their windows.
+*
+* @param width image width
+* @param height image height
+* @param body called with x0, y0, x1, y1 of every tile
+*/
+void parallel_for_tiles(int width, int height, const function<void(int, int, int, int)> &body)
+{
+	int tileHeight = max(1, CUTOFF);
+	int tileWidth = TILE_ASPECT > 0 ? max(1, CUTOFF * TILE_ASPECT) : max(1, width);
+
+	if (TILE_ORDER == TILE_ORDER_ROWS) {
+		int tilesPerRow = (width + tileWidth - 1) / tileWidth;
+		int tileRows = (height + tileHeight - 1) / tileHeight;
+		parallel_for(blocked_range<int>(0, tilesPerRow * tileRows), [&](const blocked_range<int> &r) {
+			for (int t = r.begin(); t != r.end(); t++) {
+				int x0 = (t % tilesPerRow) * tileWidth;
+				int y0 = (t / tilesPerRow) * tileHeight;
+				TRACE_SCOPE("tile", TRACE_TASK);
+				body(x0, y0, min(width, x0 + tileWidth), min(height, y0 + tileHeight));
+			}
+		});
+		return;
+	}
+
+	parallel_for(blocked_range2d<int>(0, height, tileHeight, 0, width, tileWidth), [&](const blocked_range2d<int> &r) {
+		TRACE_SCOPE("tile", TRACE_TASK);
+		body(r.cols().begin(), r.rows().begin(), r.cols().end(), r.rows().end());
+	});
+}
+
+/**
+* @brief Tiled parallel version of Prewitt filter. Image is split into
+* tiles (see parallel_for_tiles) that TBB schedules with work stealing,
+* so it composes with outer parallelism (e.g. batch mode).
+*
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+void filter_tiled_prewitt(int *inBuffer, int *outBuffer, int width, int height)
+{
+	parallel_for_tiles(width, height, [&](int x0, int y0, int x1, int y1) {
+		filter_region_prewitt(inBuffer, outBuffer, width, height, x0, y0, x1, y1);
+	});
+}
+
+/**
+* @brief Tiled parallel version of edge detection algorithm
+*
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
+void filter_tiled_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	parallel_for(blocked_range<int>(0, height, CUTOFF), [&](const blocked_range<int> &r) {
+		TRACE_SCOPE("threshold", TRACE_TASK);
+		threshold_edge_input(inBuffer, width, r.begin(), r.end());
+	});
+	parallel_for_tiles(width, height, [&](int x0, int y0, int x1, int y1) {
+		filter_region_edge_detection(inBuffer, outBuffer, width, height, x0, y0, x1, y1);
+	});
+}
+
+static const char *engineNames[ENGINE_COUNT] = {"serial", "parallel", "tiled", "simd", "simd-tiled", "numa", "simd-flat"};
+
+/**
+* @brief Name of engine, as accepted on command line
+*/
+const char *engine_name(int engine)
+{
+	if (engine < 0 || engine >= ENGINE_COUNT) return "unknown";
+	return engineNames[engine];
+}
+
+/**
+* @brief Engine id from its name, -1 if name is unknown
+*/
+int engine_from_name(const char *name)
+{
+	for (int engine = 0; engine < ENGINE_COUNT; engine++) {
+		if (strcmp(name, engineNames[engine]) == 0) return engine;
+	}
+	return -1;
+}
+
+/**
+* @brief Runs Prewitt filter with selected engine
+*
+* @param engine one of ENGINE_* values
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+* @return pixels the simd-flat engine filled without the kernel, 0 for the other engines
+*/
+long long filter_prewitt(int engine, int *inBuffer, int *outBuffer, int width, int height)
+{
+	switch (engine)
+	{
+		case ENGINE_PARALLEL:
+			filter_parallel_prewitt(0, 0, width, height, inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_TILED:
+			filter_tiled_prewitt(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD:
+			filter_simd_prewitt(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD_TILED:
+			filter_simd_tiled_prewitt(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_NUMA:
+			filter_numa_prewitt(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD_FLAT:
+			return filter_flat_prewitt(inBuffer, outBuffer, width, height);
+		default:
+			filter_serial_prewitt(inBuffer, outBuffer, width, height);
+			break;
+	}
+	return 0;
+}
+
+/**
+* @brief Runs edge detection with selected engine, inBuffer is thresholded in place
+*
+* @param engine one of ENGINE_* values
+* @param inBuffer buffer of input image
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+* @return pixels the simd-flat engine filled without the kernel, 0 for the other engines
+*/
+long long filter_edge_detection(int engine, int *inBuffer, int *outBuffer, int width, int height)
+{
+	switch (engine)
+	{
+		case ENGINE_PARALLEL:
+			filter_parallel_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_TILED:
+			filter_tiled_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD:
+			filter_simd_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD_TILED:
+			filter_simd_tiled_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_NUMA:
+			filter_numa_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+		case ENGINE_SIMD_FLAT:
+			return filter_flat_edge_detection(inBuffer, outBuffer, width, height);
+		default:
+			filter_serial_edge_detection(inBuffer, outBuffer, width, height);
+			break;
+	}
+	return 0;
+}
+
+/**
+* @brief Recursive quarters like filter_parallel_prewitt, body gets x0, y0, x1, y1 of every leaf
+*/
+static void parallel_quarters(int x, int y, int width, int height, const function<void(int, int, int, int)> &body)
+{
+	if (width <= CUTOFF || height <= CUTOFF) {
+		TRACE_SCOPE("leaf", TRACE_TASK);
+		body(x, y, x + width, y + height);
+		return;
+	}
+
+	int left = width / 2, top = height / 2;
+	task_group t;
+	t.run([&] {parallel_quarters(x, y, left, top, body); });
+	t.run([&] {parallel_quarters(x + left, y, width - left, top, body); });
+	t.run([&] {parallel_quarters(x, y + top, left, height - top, body); });
+	t.run([&] {parallel_quarters(x + left, y + top, width - left, height - top, body); });
+	t.wait();
+}
+
+/**
+* @brief Runs Prewitt filter with selected engine on views. Dense views of equal
+* stride take the buffer versions above, other views are filtered in place
+* with the same arithmetic.
+*
+* @param engine one of ENGINE_* values
+* @param in input image
+* @param out output image, same size as in
+* @return pixels the simd-flat engine filled without the kernel, 0 for the other engines
+*/
+long long filter_prewitt(int engine, ImageView<const int> in, ImageView<int> out)
+{
+	int width = in.width, height = in.height;
+
+	if (in.dense() && out.dense()) {
+		return filter_prewitt(engine, (int *)in.data, out.data, width, height);
+	}
+
+	auto region = [&](int x0, int y0, int x1, int y1) {
+		filter_region_prewitt_view(in, out, x0, y0, x1, y1, FILTER_SIZE, filterHor, filterVer, THRESHOLD);
+	};
+
+	switch (engine)
+	{
+		case ENGINE_PARALLEL:
+			parallel_quarters(0, 0, width, height, region);
+			break;
+		case ENGINE_TILED:
+			parallel_for_tiles(width, height, region);
+			break;
+		case ENGINE_SIMD:
+			filter_simd_prewitt(in, out);
+			break;
+		case ENGINE_SIMD_TILED:
+			filter_simd_tiled_prewitt(in, out);
+			break;
+		case ENGINE_NUMA:
+			filter_numa_prewitt(in, out);
+			break;
+		case ENGINE_SIMD_FLAT:
+			return filter_flat_prewitt(in, out);
+		default:
+			region(0, 0, width, height);
+			break;
+	}
+	return 0;
+}
+
+/**
+* @brief Runs edge detection with selected engine on views, in is thresholded in place
+*
+* @return pixels the simd-flat engine filled without the kernel, 0 for the other engines
+*/
+long long filter_edge_detection(int engine, ImageView<int> in, ImageView<int> out)
+{
+	int width = in.width, height = in.height;
+
+	if (in.dense() && out.dense()) {
+		return filter_edge_detection(engine, in.data, out.data, width, height);
+	}
+
+	auto region = [&](int x0, int y0, int x1, int y1) {
+		filter_region_edge_detection_view(in, out, x0, y0, x1, y1, DISTANCE);
+	};
+
+	switch (engine)
+	{
+		case ENGINE_PARALLEL:
+			threshold_edge_view(in, 0, height);
+			parallel_quarters(0, 0, width, height, region);
+			break;
+		case ENGINE_TILED:
+			parallel_for(blocked_range<int>(0, height, max(1, CUTOFF)), [&](const blocked_range<int> &r) {
+				TRACE_SCOPE("threshold", TRACE_TASK);
+				threshold_edge_view(in, r.begin(), r.end());
+			});
+			parallel_for_tiles(width, height, region);
+			break;
+		case ENGINE_SIMD:
+			filter_simd_edge_detection(in, out);
+			break;
+		case ENGINE_SIMD_TILED:
+			filter_simd_tiled_edge_detection(in, out);
+			break;
+		case ENGINE_NUMA:
+			filter_numa_edge_detection(in, out);
+			break;
+		case ENGINE_SIMD_FLAT:
+			return filter_flat_edge_detection(in, out);
+		default:
+			threshold_edge_view(in, 0, height);
+			region(0, 0, width, height);
+			break;
+	}
+	return 0;
+}
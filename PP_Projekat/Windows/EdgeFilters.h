@@ -0,0 +1,72 @@
+/*
+ * EdgeFilters.h
+ *
+ *  Prewitt and edge detection filters working on int grayscale buffers.
+ */
+
+#ifndef EDGEFILTERS_H_
+#define EDGEFILTERS_H_
+
+#include <functional>
+#include "ImageView.h"
+
+#define MAX_FILTER_SIZE			15
+
+#define TILE_ORDER_RECURSIVE	0
+#define TILE_ORDER_ROWS			1
+
+#define OP_PREWITT				1
+#define OP_EDGE					2
+
+#define ENGINE_SERIAL			0
+#define ENGINE_PARALLEL			1
+#define ENGINE_TILED			2
+#define ENGINE_SIMD				3
+#define ENGINE_SIMD_TILED		4
+#define ENGINE_NUMA				5
+#define ENGINE_SIMD_FLAT		6
+#define ENGINE_COUNT			7
+
+extern int FILTER_SIZE;
+extern int THRESHOLD;
+extern int CUTOFF;
+extern int DISTANCE;
+extern int TILE_ASPECT;
+extern int TILE_ORDER;
+
+extern int filterHor[MAX_FILTER_SIZE * MAX_FILTER_SIZE];
+extern int filterVer[MAX_FILTER_SIZE * MAX_FILTER_SIZE];
+
+bool check_if_border_case(int index, int height, int width);
+
+void filter_serial_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+void filter_parallel_prewitt(int row, int col, int width, int height, int *inBuffer, int *outBuffer, int _width, int _height);
+void filter_serial_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+void next_iter_parallel_edge_detection(int row, int col, int width, int height, int* inBuffer, int* outBuffer, int _width, int _height);
+void filter_parallel_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+
+void filter_region_prewitt(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1);
+void filter_region_edge_detection(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1);
+void filter_region_prewitt_strided(int *inBuffer, int *outBuffer, int width, int height, int stride, int x0, int y0, int x1, int y1);
+void filter_region_edge_detection_strided(int *inBuffer, int *outBuffer, int width, int height, int stride, int x0, int y0, int x1, int y1);
+void filter_region_prewitt_view(ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1,
+		int filterSize, const int *hor, const int *ver, int threshold, int outX = 0, int outY = 0);
+void filter_region_edge_detection_view(ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int distance,
+		int outX = 0, int outY = 0);
+void filter_band_prewitt(const int *band, int bandY0, int *tileOut, int width, int height, int x0, int y0, int x1, int y1, int filterSize, int threshold);
+void filter_band_edge_detection(const int *band, int bandY0, int *tileOut, int width, int height, int x0, int y0, int x1, int y1, int distance);
+void threshold_edge_input(int *buffer, int width, int y0, int y1);
+void threshold_edge_view(ImageView<int> image, int y0, int y1);
+
+void parallel_for_tiles(int width, int height, const std::function<void(int, int, int, int)> &body);
+void filter_tiled_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+void filter_tiled_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+
+const char *engine_name(int engine);
+int engine_from_name(const char *name);
+long long filter_prewitt(int engine, int *inBuffer, int *outBuffer, int width, int height);
+long long filter_edge_detection(int engine, int *inBuffer, int *outBuffer, int width, int height);
+long long filter_prewitt(int engine, ImageView<const int> in, ImageView<int> out);
+long long filter_edge_detection(int engine, ImageView<int> in, ImageView<int> out);
+
+#endif /* EDGEFILTERS_H_ */
@@ -0,0 +1,236 @@
+/*
+ * FlatRegions.cpp
+ *
+ *  Flat block detection and the simd-flat engine.
+ */
+
+#include "FlatRegions.h"
+#include "Trace.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <tbb/parallel_for.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/blocked_range.h>
+
+using namespace std;
+using namespace tbb;
+
+/**
+* @brief Smallest |G| for G anywhere in low..high.
+*/
+static long long span_low(long long low, long long high)
+{
+	if (low <= 0 && high >= 0) return 0;
+	return min(llabs(low), llabs(high));
+}
+
+static long long span_high(long long low, long long high)
+{
+	return max(llabs(low), llabs(high));
+}
+
+/**
+* @brief Output every pixel of a block has when its windows read only values in
+* low..high, FLAT_COMPUTE if that is not decided by the range. A wider range is
+* never decided when a narrower one is not.
+*/
+static int flat_fill(const FlatKernel &flat, int low, int high)
+{
+	// the thresholded input is 0 or 1, a window holding only one of them gives 0
+	if (flat.op != OP_PREWITT) return low == high ? 0 : FLAT_COMPUTE;
+
+	// the kernels sum in int, a range that could wrap around is not decided
+	long long magnitude = max(llabs(low), llabs(high));
+	if (magnitude * (flat.plusX - flat.minusX + flat.plusY - flat.minusY) > INT_MAX) return FLAT_COMPUTE;
+
+	long long lowX = flat.plusX * low + flat.minusX * high, highX = flat.plusX * high + flat.minusX * low;
+	long long lowY = flat.plusY * low + flat.minusY * high, highY = flat.plusY * high + flat.minusY * low;
+	if (span_high(lowX, highX) + span_high(lowY, highY) < flat.threshold) return 0;
+	if (span_low(lowX, highX) + span_low(lowY, highY) >= flat.threshold) return 255;
+	return FLAT_COMPUTE;
+}
+
+void flat_kernel(const SimdKernel &kernel, int op, FlatKernel &flat)
+{
+	flat.op = op;
+	flat.radius = kernel.radius;
+	flat.threshold = kernel.threshold;
+
+	// Gx is linear in every pixel, its extremes take high where the weight is
+	// positive and low where it is negative (and the other way round)
+	flat.plusX = flat.minusX = flat.plusY = flat.minusY = 0;
+	for (int t = 0; t < kernel.tapCount; t++) {
+		(kernel.taps[t].wx > 0 ? flat.plusX : flat.minusX) += kernel.taps[t].wx;
+		(kernel.taps[t].wy > 0 ? flat.plusY : flat.minusY) += kernel.taps[t].wy;
+	}
+
+	// with weights summing to 0 (Prewitt) only high - low counts, 255 is never
+	// decided and 0 only below threshold / (plusX + plusY)
+	flat.spread = LLONG_MAX;
+	if (op != OP_PREWITT) flat.spread = 1;
+	else if (flat.plusX + flat.minusX == 0 && flat.plusY + flat.minusY == 0 && flat.plusX + flat.plusY > 0)
+		flat.spread = (flat.threshold + flat.plusX + flat.plusY - 1) / (flat.plusX + flat.plusY);
+}
+
+/**
+* @brief Whether blocks in rows y0..y1 can be decided at all.
+*/
+static bool flat_rows(const FlatKernel &flat, ImageView<const int> in, int y0, int y1)
+{
+	int radius = flat.radius;
+	// rows whose windows reach before the first or past the last pixel lose taps
+	if (y0 < radius + 1 || y1 > in.height - radius - 1 || in.width <= radius) return false;
+	// windows of edge detection without the first tap are empty for distance 0
+	return flat.op == OP_PREWITT || radius >= 1;
+}
+
+int flat_block(const FlatKernel &flat, ImageView<const int> in, const RoiRect &block, vector<RoiRect> &reads)
+{
+	if (!flat_rows(flat, in, block.y0, block.y1)) return FLAT_COMPUTE;
+
+	reads.clear();
+	roi_reads(block, in.width, in.height, flat.radius, reads);
+
+	int low = INT_MAX, high = INT_MIN;
+	for (size_t k = 0; k < reads.size(); k++) {
+		for (int y = reads[k].y0; y < reads[k].y1; y++) {
+			simd_row_range(in.row(y) + reads[k].x0, reads[k].x1 - reads[k].x0, low, high);
+			if ((long long)high - low >= flat.spread) return FLAT_COMPUTE;
+		}
+	}
+	return flat_fill(flat, low, high);
+}
+
+/**
+* @brief Decides the blocks of block row y0..y1 of a region, one value per block
+* in fills.
+*
+* @return true if a block was decided
+*/
+static bool flat_row(const FlatKernel &flat, ImageView<const int> in, int x0, int y0, int x1, int y1,
+		vector<int> &low, vector<int> &high, vector<RoiRect> &reads, vector<int> &fills)
+{
+	int block = FLAT_BLOCK, radius = flat.radius, width = in.width;
+	fills.clear();
+
+	if (!flat_rows(flat, in, y0, y1)) {
+		for (int xa = x0; xa < x1; xa = min(x1, (xa / block + 1) * block)) fills.push_back(FLAT_COMPUTE);
+		return false;
+	}
+
+	// column ranges of all rows the windows read, in one pass over long rows
+	int c0 = max(0, x0 - radius), c1 = min(width, x1 + radius);
+	low.assign(c1 - c0, INT_MAX);
+	high.assign(c1 - c0, INT_MIN);
+	for (int y = y0 - radius; y < y1 + radius; y++) simd_column_range(in.row(y) + c0, &low[0], &high[0], c1 - c0);
+
+	bool decided = false;
+	for (int xa = x0; xa < x1; ) {
+		int xb = min(x1, (xa / block + 1) * block), value;
+		if (xa - radius < 0 || xb + radius > width) {
+			// windows wrapping into the previous or next row
+			RoiRect rect = {xa, y0, xb, y1};
+			value = flat_block(flat, in, rect, reads);
+		} else {
+			int lowest = INT_MAX, highest = INT_MIN, unused;
+			simd_row_range(&low[xa - radius - c0], xb - xa + 2 * radius, lowest, unused);
+			simd_row_range(&high[xa - radius - c0], xb - xa + 2 * radius, unused, highest);
+			value = flat_fill(flat, lowest, highest);
+		}
+		fills.push_back(value);
+		decided = decided || value != FLAT_COMPUTE;
+		xa = xb;
+	}
+	return decided;
+}
+
+long long flat_region(const FlatKernel &flat, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1,
+		const function<void(int, int, int, int)> &compute, FlatScratch &scratch)
+{
+	int block = FLAT_BLOCK;
+	long long flatPixels = 0;
+	vector<int> &fills = scratch.fills;
+
+	// block rows without a flat block are run together, from pending on
+	int pending = y0;
+	for (int ya = y0; ya < y1; ) {
+		int yb = min(y1, (ya / block + 1) * block);
+		if (!flat_row(flat, in, x0, ya, x1, yb, scratch.low, scratch.high, scratch.reads, fills)) {
+			ya = yb;
+			continue;
+		}
+		if (pending < ya) compute(x0, pending, x1, ya);
+
+		size_t k = 0;
+		for (int xa = x0; xa < x1; ) {
+			int value = fills[k], xb = min(x1, (xa / block + 1) * block);
+			for (k++; k < fills.size() && fills[k] == value; k++) xb = min(x1, (xb / block + 1) * block);
+
+			if (value == FLAT_COMPUTE) compute(xa, ya, xb, yb);
+			else {
+				for (int y = ya; y < yb; y++) fill(out.row(y) + xa, out.row(y) + xb, value);
+				flatPixels += (long long)(xb - xa) * (yb - ya);
+			}
+			xa = xb;
+		}
+		ya = pending = yb;
+	}
+	if (pending < y1) compute(x0, pending, x1, y1);
+	return flatPixels;
+}
+
+long long filter_flat_prewitt(int *inBuffer, int *outBuffer, int width, int height)
+{
+	return filter_flat_prewitt(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+long long filter_flat_prewitt(ImageView<const int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_prewitt(kernel);
+	simd_kernel_bind(kernel, in.stride);
+	FlatKernel flat;
+	flat_kernel(kernel, OP_PREWITT, flat);
+
+	// one compute function and one set of buffers per thread, not per tile
+	const function<void(int, int, int, int)> compute = [&](int xa, int ya, int xb, int yb) {
+		simd_kernel_region_prewitt(kernel, in, out, xa, ya, xb, yb);
+	};
+	enumerable_thread_specific<FlatScratch> scratch;
+	atomic<long long> flatPixels(0);
+	parallel_for_tiles(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		flatPixels += flat_region(flat, in, out, x0, y0, x1, y1, compute, scratch.local());
+	});
+	return flatPixels;
+}
+
+long long filter_flat_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	return filter_flat_edge_detection(ImageView<int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+long long filter_flat_edge_detection(ImageView<int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_edge_detection(kernel);
+	simd_kernel_bind(kernel, in.stride);
+	FlatKernel flat;
+	flat_kernel(kernel, OP_EDGE, flat);
+
+	parallel_for(blocked_range<int>(0, in.height, CUTOFF), [&](const blocked_range<int> &r) {
+		TRACE_SCOPE("threshold", TRACE_TASK);
+		simd_threshold_edge_copy(in, in, r.begin(), r.end(), THRESHOLD);
+	});
+
+	const function<void(int, int, int, int)> compute = [&](int xa, int ya, int xb, int yb) {
+		simd_kernel_region_edge_detection(kernel, in, out, xa, ya, xb, yb);
+	};
+	enumerable_thread_specific<FlatScratch> scratch;
+	atomic<long long> flatPixels(0);
+	parallel_for_tiles(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		flatPixels += flat_region(flat, in, out, x0, y0, x1, y1, compute, scratch.local());
+	});
+	return flatPixels;
+}
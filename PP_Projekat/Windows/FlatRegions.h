@@ -0,0 +1,84 @@
+/*
+ * FlatRegions.h
+ *
+ *  Skipping of flat image areas, e.g. the uniform background of scans.
+ *  Every tile is split into FLAT_BLOCK squares. The range (minimum and
+ *  maximum) of all pixels the windows of a block read sometimes fixes the
+ *  output of the whole block: Prewitt gives 0 when the largest |Gx| + |Gy|
+ *  the range allows is below the threshold (255 when even the smallest
+ *  reaches it), edge detection gives 0 when the thresholded input is all
+ *  0 or all 1. Such blocks are filled with the constant, the others run
+ *  through the SIMD kernels; results are those of the serial versions.
+ *
+ *  The ranges are taken block row by block row right before the tile is
+ *  filtered, from column ranges over the whole tile width, so the rows are
+ *  read into the cache once for both; block rows without a flat block run
+ *  the kernel in one call. Only blocks whose windows keep every tap are
+ *  decided, the linear border handling drops taps in the first and last rows.
+ */
+
+#ifndef FLATREGIONS_H_
+#define FLATREGIONS_H_
+
+#include <vector>
+#include <functional>
+#include "SimdFilters.h"
+#include "RegionOfInterest.h"
+
+#define FLAT_BLOCK				16
+#define FLAT_COMPUTE			-1		// block output is not known, the kernel runs
+
+/**
+* @brief Range bounds of a bound kernel, taken once per run.
+*/
+struct FlatKernel {
+	int op;
+	int radius;
+	int threshold;
+	long long plusX;					// sums of the positive and negative tap weights
+	long long minusX;
+	long long plusY;
+	long long minusY;
+	long long spread;					// no range at least this wide is decided
+};
+
+void flat_kernel(const SimdKernel &kernel, int op, FlatKernel &flat);
+
+/**
+* @brief Buffers of flat_region, kept by the caller (one per thread) so the tiles do not allocate.
+*/
+struct FlatScratch {
+	std::vector<int> low;				// column ranges of one block row
+	std::vector<int> high;
+	std::vector<int> fills;				// output of each block of the row
+	std::vector<RoiRect> reads;
+};
+
+/**
+* @brief Output of every pixel of block, or FLAT_COMPUTE.
+*
+* @param in input of the kernel, thresholded for edge detection
+* @param reads scratch for the rectangles the block reads
+*/
+int flat_block(const FlatKernel &flat, ImageView<const int> in, const RoiRect &block, std::vector<RoiRect> &reads);
+
+/**
+* @brief Fills the flat blocks of region x0..x1, y0..y1 of out and calls compute
+* for the rest, with runs of neighbouring blocks (and whole block rows) in one call.
+*
+* @return pixels filled without compute
+*/
+long long flat_region(const FlatKernel &flat, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1,
+		const std::function<void(int, int, int, int)> &compute, FlatScratch &scratch);
+
+/**
+* @brief simd-flat engine.
+*
+* @return pixels filled without the kernel
+*/
+long long filter_flat_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+long long filter_flat_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+long long filter_flat_prewitt(ImageView<const int> in, ImageView<int> out);
+long long filter_flat_edge_detection(ImageView<int> in, ImageView<int> out);
+
+#endif /* FLATREGIONS_H_ */
@@ -0,0 +1,412 @@
+/*
+ * GrayCodec.cpp
+ *
+ *  Lossless QOI-style codec ("QOG") for grayscale and binary edge maps.
+ */
+
+#include "GrayCodec.h"
+#include "ImagePool.h"
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+#define QOG_HASH(v)			((((v) * 37) + ((v) >> 6)) & 63)
+#define QOG_BAND_PIXELS		(1 << 16)
+
+using namespace std;
+using namespace tbb;
+
+static const unsigned char qog_magic[4] = {'q', 'o', 'g', 'f'};
+static const unsigned char qog_end[QOG_END_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+static size_t maxPixels = QOG_MAX_PIXELS;
+
+
+static void write_u32(unsigned char *dst, unsigned int value)
+{
+	dst[0] = (unsigned char)(value >> 24);
+	dst[1] = (unsigned char)(value >> 16);
+	dst[2] = (unsigned char)(value >> 8);
+	dst[3] = (unsigned char)value;
+}
+
+static unsigned int read_u32(const unsigned char *src)
+{
+	return ((unsigned int)src[0] << 24) | ((unsigned int)src[1] << 16) | ((unsigned int)src[2] << 8) | src[3];
+}
+
+/**
+* @brief Counts how many pixels starting at px are equal to value.
+*
+* @param px first pixel to check
+* @param count number of pixels available
+* @param value value of the run
+*/
+static size_t scan_run(const int *px, size_t count, int value)
+{
+	size_t run = 0;
+
+	// eight pixels at a time, the inner loop is branch free and gets vectorized
+	while (run + 8 <= count) {
+		int diff = 0;
+		for (int k = 0; k < 8; k++) diff |= (px[run + k] ^ value) & 0xff;
+		if (diff) break;
+		run += 8;
+	}
+	while (run < count && (px[run] & 0xff) == value) run++;
+
+	return run;
+}
+
+static void emit_run(vector<unsigned char> &out, size_t run)
+{
+	if (run <= QOG_RUN_SHORT_MAX) {
+		out.push_back((unsigned char)(QOG_OP_RUN | (run - 1)));
+		return;
+	}
+
+	// long runs are stored as LEB128 varint of (run - 65)
+	size_t rest = run - QOG_RUN_SHORT_MAX - 1;
+	out.push_back(QOG_OP_RUN_LONG);
+	while (rest >= 0x80) {
+		out.push_back((unsigned char)(rest | 0x80));
+		rest >>= 7;
+	}
+	out.push_back((unsigned char)rest);
+}
+
+/**
+* @brief Encodes one band of consecutive pixels.
+*
+* @param px first pixel of the band
+* @param count number of pixels in the band
+* @param out encoded band, appended
+*/
+static void encode_band(const int *px, size_t count, vector<unsigned char> &out)
+{
+	int index[64];
+	int prev = 0;
+	size_t p = 0;
+
+	memset(index, 0, sizeof(index));
+
+	while (p < count) {
+		int value = px[p] & 0xff;
+
+		if (value == prev) {
+			size_t run = scan_run(px + p, count - p, prev);
+			emit_run(out, run);
+			p += run;
+			continue;
+		}
+
+		int hash = QOG_HASH(value);
+		if (index[hash] == value) {
+			out.push_back((unsigned char)(QOG_OP_INDEX | hash));
+		}
+		else {
+			int diff = value - prev;
+			index[hash] = value;
+			if (diff >= -32 && diff < 32) {
+				out.push_back((unsigned char)(QOG_OP_DIFF | (diff + 32)));
+			}
+			else {
+				out.push_back(QOG_OP_GRAY);
+				out.push_back((unsigned char)value);
+			}
+		}
+		prev = value;
+		p++;
+	}
+}
+
+/**
+* @brief Decodes one band of consecutive pixels.
+*
+* @param data encoded band
+* @param size encoded band size
+* @param px first pixel of the band
+* @param count number of pixels in the band
+* @return true if band is well formed
+*/
+static bool decode_band(const unsigned char *data, size_t size, int *px, size_t count)
+{
+	int index[64];
+	int prev = 0;
+	size_t pos = 0, p = 0;
+
+	memset(index, 0, sizeof(index));
+
+	while (p < count) {
+		if (pos >= size) return false;
+		unsigned char b = data[pos++];
+		size_t run = 0;
+		int value;
+
+		if (b == QOG_OP_GRAY) {
+			if (pos >= size) return false;
+			value = data[pos++];
+		}
+		else if (b == QOG_OP_RUN_LONG) {
+			int shift = 0;
+			size_t rest = 0;
+			for (;;) {
+				if (pos >= size || shift > 56) return false;
+				unsigned char c = data[pos++];
+				rest |= (size_t)(c & 0x7f) << shift;
+				shift += 7;
+				if (!(c & 0x80)) break;
+			}
+			run = rest + QOG_RUN_SHORT_MAX + 1;
+		}
+		else {
+			switch (b & QOG_MASK_2) {
+				case QOG_OP_INDEX:
+					value = index[b & 63];
+					break;
+				case QOG_OP_DIFF:
+					value = prev + (b & 63) - 32;
+					if (value < 0 || value > 255) return false;
+					break;
+				case QOG_OP_RUN:
+					run = (b & 63) + 1;
+					break;
+				default:
+					return false;
+			}
+		}
+
+		if (run) {
+			if (run > count - p) return false;
+			for (size_t k = 0; k < run; k++) px[p + k] = prev;
+			p += run;
+			continue;
+		}
+
+		index[QOG_HASH(value)] = value;
+		px[p++] = value;
+		prev = value;
+	}
+
+	return pos == size;
+}
+
+/**
+* @brief Joins header, band table, encoded bands and end marker into one stream.
+*/
+static void assemble_stream(vector<vector<unsigned char> > &bands, int width, int height, int rowsPerBand, vector<unsigned char> &out)
+{
+	size_t total = QOG_HEADER_SIZE + 4 * bands.size() + QOG_END_SIZE;
+	for (size_t b = 0; b < bands.size(); b++) total += bands[b].size();
+
+	out.resize(total);
+	unsigned char *dst = &out[0];
+
+	memcpy(dst, qog_magic, 4);
+	write_u32(dst + 4, width);
+	write_u32(dst + 8, height);
+	write_u32(dst + 12, rowsPerBand);
+	write_u32(dst + 16, (unsigned int)bands.size());
+	dst += QOG_HEADER_SIZE;
+
+	for (size_t b = 0; b < bands.size(); b++, dst += 4) write_u32(dst, (unsigned int)bands[b].size());
+	for (size_t b = 0; b < bands.size(); b++) {
+		if (!bands[b].empty()) memcpy(dst, &bands[b][0], bands[b].size());
+		dst += bands[b].size();
+	}
+	memcpy(dst, qog_end, QOG_END_SIZE);
+}
+
+static bool encode_bands(const int *pixels, int width, int height, vector<unsigned char> &out, int rowsPerBand, bool parallel)
+{
+	if (pixels == NULL || width <= 0 || height <= 0) return false;
+	if (rowsPerBand <= 0 || rowsPerBand > height) rowsPerBand = height;
+
+	int bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+	vector<vector<unsigned char> > bands(bandCount);
+
+	auto encode = [&](int b) {
+		int firstRow = b * rowsPerBand;
+		int rows = min(rowsPerBand, height - firstRow);
+		bands[b].reserve((size_t)width * rows / 16 + 16);
+		encode_band(pixels + (size_t)firstRow * width, (size_t)rows * width, bands[b]);
+	};
+
+	if (parallel) {
+		parallel_for(blocked_range<int>(0, bandCount), [&](const blocked_range<int> &r) {
+			for (int b = r.begin(); b != r.end(); b++) encode(b);
+		});
+	}
+	else {
+		for (int b = 0; b < bandCount; b++) encode(b);
+	}
+
+	assemble_stream(bands, width, height, rowsPerBand, out);
+	return true;
+}
+
+bool qog_encode(const int *pixels, int width, int height, vector<unsigned char> &out, int rowsPerBand)
+{
+	return encode_bands(pixels, width, height, out, rowsPerBand, false);
+}
+
+bool qog_encode_parallel(const int *pixels, int width, int height, vector<unsigned char> &out, int rowsPerBand)
+{
+	if (rowsPerBand <= 0 && width > 0) rowsPerBand = max(1, QOG_BAND_PIXELS / width);
+	return encode_bands(pixels, width, height, out, rowsPerBand, true);
+}
+
+/**
+* @brief Checks header and band table of a stream and collects band offsets.
+*/
+static bool parse_stream(const unsigned char *data, size_t size, unsigned int &w, unsigned int &h, unsigned int &rowsPerBand, vector<size_t> &offsets)
+{
+	if (data == NULL || size < QOG_HEADER_SIZE + QOG_END_SIZE) return false;
+	if (memcmp(data, qog_magic, 4) != 0) return false;
+
+	w = read_u32(data + 4);
+	h = read_u32(data + 8);
+	rowsPerBand = read_u32(data + 12);
+	unsigned int bandCount = read_u32(data + 16);
+
+	if (w == 0 || h == 0 || w > 0x7fffffff || h > 0x7fffffff || rowsPerBand == 0) return false;
+	// long runs let a few bytes stand for any size, the header size alone is not trusted
+	if ((size_t)w * h > maxPixels) return false;
+	if (bandCount != ((size_t)h + rowsPerBand - 1) / rowsPerBand) return false;
+	if ((size - QOG_HEADER_SIZE - QOG_END_SIZE) / 4 < bandCount) return false;
+
+	// prefix sum of band sizes gives every band its start offset
+	offsets.resize(bandCount + 1);
+	offsets[0] = QOG_HEADER_SIZE + 4 * (size_t)bandCount;
+	for (unsigned int b = 0; b < bandCount; b++) {
+		unsigned int bandSize = read_u32(data + QOG_HEADER_SIZE + 4 * b);
+		// every band holds pixels, an empty one cannot be decoded
+		if (bandSize == 0) return false;
+		offsets[b + 1] = offsets[b] + bandSize;
+		if (offsets[b + 1] > size - QOG_END_SIZE) return false;
+	}
+	return memcmp(data + offsets[bandCount], qog_end, QOG_END_SIZE) == 0;
+}
+
+/**
+* @brief Decodes the bands of a parsed stream in parallel into w * h pixels.
+*/
+static bool decode_bands(const unsigned char *data, const vector<size_t> &offsets, unsigned int w, unsigned int h, unsigned int rowsPerBand, int *pixels)
+{
+	atomic<bool> ok(true);
+	parallel_for(blocked_range<size_t>(0, offsets.size() - 1), [&](const blocked_range<size_t> &r) {
+		for (size_t b = r.begin(); b != r.end(); b++) {
+			size_t firstRow = b * rowsPerBand;
+			size_t rows = min((size_t)rowsPerBand, h - firstRow);
+			if (!decode_band(data + offsets[b], offsets[b + 1] - offsets[b], pixels + firstRow * w, rows * w)) ok = false;
+		}
+	});
+	return ok;
+}
+
+void qog_set_max_pixels(size_t pixels)
+{
+	maxPixels = pixels;
+}
+
+bool qog_decode(const unsigned char *data, size_t size, vector<int> &pixels, int *width, int *height)
+{
+	unsigned int w, h, rowsPerBand;
+	vector<size_t> offsets;
+	if (!parse_stream(data, size, w, h, rowsPerBand, offsets)) return false;
+
+	try {
+		pixels.resize((size_t)w * h);
+	}
+	catch (const exception &) {
+		return false;
+	}
+	if (!decode_bands(data, offsets, w, h, rowsPerBand, &pixels[0])) return false;
+
+	*width = (int)w;
+	*height = (int)h;
+	return true;
+}
+
+bool qog_decode(const unsigned char *data, size_t size, int **pixels, int *width, int *height)
+{
+	unsigned int w, h, rowsPerBand;
+	vector<size_t> offsets;
+	if (!parse_stream(data, size, w, h, rowsPerBand, offsets)) return false;
+
+	// the bands write every pixel, nothing is cleared first
+	int *out = pool_alloc_image((int)w, (int)h);
+	if (out == NULL) return false;
+	if (!decode_bands(data, offsets, w, h, rowsPerBand, out)) {
+		pool_free_image(out, (int)w, (int)h);
+		return false;
+	}
+
+	*pixels = out;
+	*width = (int)w;
+	*height = (int)h;
+	return true;
+}
+
+bool qog_write(const char *filename, const int *pixels, int width, int height)
+{
+	vector<unsigned char> stream;
+	if (!qog_encode_parallel(pixels, width, height, stream)) return false;
+
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		cout << "ERROR: cannot open file " << filename << " for output." << endl;
+		return false;
+	}
+	size_t written = fwrite(&stream[0], 1, stream.size(), fp);
+	fclose(fp);
+
+	return written == stream.size();
+}
+
+/**
+* @brief Reads a whole file into stream.
+*/
+static bool read_stream(const char *filename, vector<unsigned char> &stream)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		cout << "ERROR: cannot open file " << filename << " for input." << endl;
+		return false;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	stream.resize(size > 0 ? size : 0);
+	bool ok = size > 0 && fread(&stream[0], 1, size, fp) == (size_t)size;
+	fclose(fp);
+	return ok;
+}
+
+bool qog_read(const char *filename, vector<int> &pixels, int *width, int *height)
+{
+	vector<unsigned char> stream;
+	return read_stream(filename, stream) && qog_decode(&stream[0], stream.size(), pixels, width, height);
+}
+
+bool qog_read(const char *filename, int **pixels, int *width, int *height)
+{
+	vector<unsigned char> stream;
+	return read_stream(filename, stream) && qog_decode(&stream[0], stream.size(), pixels, width, height);
+}
+
+bool qog_is_filename(const char *filename)
+{
+	size_t len = strlen(filename);
+	if (len < 4) return false;
+
+	const char *ext = filename + len - 4;
+	return ext[0] == '.' && tolower(ext[1]) == 'q' && tolower(ext[2]) == 'o' && tolower(ext[3]) == 'g';
+}
@@ -0,0 +1,100 @@
+/*
+ * GrayCodec.h
+ *
+ *  Lossless QOI-style codec ("QOG") for grayscale and binary edge maps.
+ *
+ *  Stream layout (all integers big endian):
+ *    magic "qogf" | width u32 | height u32 | rowsPerBand u32 | bandCount u32
+ *    | bandCount x u32 encoded band sizes | band data ... | end marker
+ *
+ *  Every band is encoded independently (fresh index and previous value),
+ *  so bands can be encoded and decoded in parallel.
+ */
+
+#ifndef GRAYCODEC_H_
+#define GRAYCODEC_H_
+
+#include <vector>
+#include <stddef.h>
+
+#define QOG_OP_INDEX		0x00	/* 00xxxxxx */
+#define QOG_OP_DIFF			0x40	/* 01xxxxxx */
+#define QOG_OP_RUN			0x80	/* 10xxxxxx */
+#define QOG_OP_RUN_LONG		0xfe	/* 11111110 varint */
+#define QOG_OP_GRAY			0xff	/* 11111111 value */
+#define QOG_MASK_2			0xc0
+
+#define QOG_RUN_SHORT_MAX	64
+#define QOG_HEADER_SIZE		20
+#define QOG_END_SIZE		8
+#define QOG_MAX_PIXELS		((size_t)1 << 30)	/* largest image a stream may decode to, see qog_set_max_pixels */
+
+/**
+* @brief Encodes a grayscale buffer (values 0..255) into a QOG stream.
+*
+* @param pixels buffer of image, one int per pixel
+* @param width image width
+* @param height image height
+* @param out encoded stream, replaced
+* @param rowsPerBand rows encoded together, 0 for a single band
+* @return true on success
+*/
+bool qog_encode(const int *pixels, int width, int height, std::vector<unsigned char> &out, int rowsPerBand = 0);
+
+/**
+* @brief Row-parallel version of qog_encode, bands are encoded as TBB tasks.
+*
+* @param pixels buffer of image, one int per pixel
+* @param width image width
+* @param height image height
+* @param out encoded stream, replaced
+* @param rowsPerBand rows encoded together, 0 picks a size from image dimensions
+* @return true on success
+*/
+bool qog_encode_parallel(const int *pixels, int width, int height, std::vector<unsigned char> &out, int rowsPerBand = 0);
+
+/**
+* @brief Decodes a QOG stream, bands are decoded in parallel.
+*
+* @param data encoded stream
+* @param size stream size in bytes
+* @param pixels decoded buffer, resized to width * height
+* @param width decoded image width
+* @param height decoded image height
+* @return true if the stream is well formed and not larger than the pixel limit
+*/
+bool qog_decode(const unsigned char *data, size_t size, std::vector<int> &pixels, int *width, int *height);
+
+/**
+* @brief Same as qog_decode, decodes into a new buffer from pool_alloc_image
+* (allocated only once the header and band table are valid, left unset on failure).
+*/
+bool qog_decode(const unsigned char *data, size_t size, int **pixels, int *width, int *height);
+
+/**
+* @brief Largest width * height a stream is decoded to, QOG_MAX_PIXELS by default.
+* Runs let a few bytes claim any size, so the limit guards against forged files.
+*/
+void qog_set_max_pixels(size_t pixels);
+
+/**
+* @brief Encodes buffer in parallel and writes it to file.
+*/
+bool qog_write(const char *filename, const int *pixels, int width, int height);
+
+/**
+* @brief Reads and decodes a QOG file.
+*/
+bool qog_read(const char *filename, std::vector<int> &pixels, int *width, int *height);
+
+/**
+* @brief Reads and decodes a QOG file into a new buffer from pool_alloc_image.
+*/
+bool qog_read(const char *filename, int **pixels, int *width, int *height);
+
+/**
+* @brief Checks if file name has the .qog extension.
+*/
+bool qog_is_filename(const char *filename);
+
+#endif /* GRAYCODEC_H_ */
@@ -0,0 +1,80 @@
+/*
+ * ImageBuffer.cpp
+ *
+ *  Image buffer with 64 byte aligned, padded rows.
+ */
+
+#include "ImageBuffer.h"
+#include "ImagePool.h"
+#include "EdgeFilters.h"
+#include "NumaPlacement.h"
+#include "ShadowVerify.h"
+#include <string.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+int IMAGE_STRIDE = IMAGE_STRIDE_AUTO;
+
+using namespace std;
+using namespace tbb;
+
+
+int image_stride(int width)
+{
+	if (IMAGE_STRIDE == IMAGE_STRIDE_DENSE) return width;
+	if (IMAGE_STRIDE > width) return IMAGE_STRIDE;
+	if (IMAGE_STRIDE != IMAGE_STRIDE_AUTO) return width;
+
+	int stride = (width + IMAGE_ROW_ALIGNMENT - 1) / IMAGE_ROW_ALIGNMENT * IMAGE_ROW_ALIGNMENT;
+	if ((stride * sizeof(int)) % IMAGE_ALIAS_BYTES == 0) stride += IMAGE_ROW_ALIGNMENT;
+	return stride;
+}
+
+bool image_buffer_alloc(ImageBuffer &image, int width, int height)
+{
+	image.width = width;
+	image.height = height;
+	image.stride = image_stride(width);
+	image.data = pool_alloc_image(image.stride, height);
+	return image.data != NULL;
+}
+
+void image_buffer_free(ImageBuffer &image)
+{
+	pool_free_image(image.data, image.stride, image.height);
+	image.data = NULL;
+}
+
+void image_buffer_load(ImageBuffer &image, const int *pixels)
+{
+	// every node copies its own band, fresh pages are placed where the numa engine reads them
+	NumaArenas::instance().runBands(image.height, [&](int y0, int y1) {
+		parallel_for(blocked_range<int>(y0, y1), [&](const blocked_range<int> &r) {
+			for (int j = r.begin(); j != r.end(); j++) {
+				int *row = image.data + (size_t)j * image.stride;
+				memcpy(row, pixels + (size_t)j * image.width, image.width * sizeof(int));
+				// padding is never read by the filters, zeroed so dumps are deterministic
+				memset(row + image.width, 0, (image.stride - image.width) * sizeof(int));
+			}
+		});
+	});
+}
+
+void image_buffer_store(const ImageBuffer &image, int *pixels)
+{
+	parallel_for(blocked_range<int>(0, image.height), [&](const blocked_range<int> &r) {
+		for (int j = r.begin(); j != r.end(); j++) {
+			memcpy(pixels + (size_t)j * image.width, image.data + (size_t)j * image.stride, image.width * sizeof(int));
+		}
+	});
+}
+
+long long image_filter(int op, int engine, ImageBuffer &in, ImageBuffer &out)
+{
+	ShadowSample *shadow = shadow_capture(op, engine, in.data, in.width, in.height, in.stride);
+	long long flatPixels;
+	if (op == OP_PREWITT) flatPixels = filter_prewitt(engine, in.view(), out.view());
+	else flatPixels = filter_edge_detection(engine, in.view(), out.view());
+	shadow_submit(shadow, out.data, out.stride);
+	return flatPixels;
+}
@@ -0,0 +1,98 @@
+/*
+ * ImageBuffer.h
+ *
+ *  Image buffer with 64 byte aligned, padded rows. With a row size that is
+ *  a multiple of 2 KB (any power of two width from 512 up) all rows of a
+ *  Prewitt window fall into the same L1 cache sets and evict each other;
+ *  the automatic stride rounds rows to whole cache lines and adds one more
+ *  line in that case. Blocks come from the image pool, so large images get
+ *  transparent huge pages when pool_set_huge_pages is enabled.
+ */
+
+#ifndef IMAGEBUFFER_H_
+#define IMAGEBUFFER_H_
+
+#include <stddef.h>
+#include "ImageView.h"
+
+#define IMAGE_STRIDE_AUTO		-1
+#define IMAGE_STRIDE_DENSE		0
+
+#define IMAGE_ROW_ALIGNMENT		16			// ints, one 64 byte cache line
+#define IMAGE_ALIAS_BYTES		2048
+
+/*
+ * IMAGE_STRIDE_AUTO, IMAGE_STRIDE_DENSE (stride equals width) or the
+ * smallest stride in ints to use (values below the width are ignored)
+ */
+extern int IMAGE_STRIDE;
+
+struct ImageBuffer {
+	int *data;
+	int width;
+	int height;
+	int stride;				// ints between starts of two rows
+
+	ImageView<int> view() const
+	{
+		return ImageView<int>(data, width, height, stride);
+	}
+};
+
+/**
+* @brief Row stride for an image of given width, according to IMAGE_STRIDE.
+*/
+int image_stride(int width);
+
+/**
+* @brief Allocates image with stride from image_stride. Pages are not touched,
+* image_buffer_load places them.
+*
+* @return false if allocation failed
+*/
+bool image_buffer_alloc(ImageBuffer &image, int width, int height);
+
+void image_buffer_free(ImageBuffer &image);
+
+/**
+* @brief Frees an image when the scope is left, also on early returns.
+*/
+class ImageBufferGuard {
+public:
+	explicit ImageBufferGuard(ImageBuffer &image) : image(image)
+	{
+		image.data = NULL;
+	}
+	~ImageBufferGuard()
+	{
+		image_buffer_free(image);
+	}
+
+private:
+	ImageBuffer &image;
+
+	ImageBufferGuard(const ImageBufferGuard &);
+	ImageBufferGuard &operator=(const ImageBufferGuard &);
+};
+
+/**
+* @brief Copies dense width * height pixels into the image and zeroes the padding.
+* Row bands are copied on their NUMA node.
+*/
+void image_buffer_load(ImageBuffer &image, const int *pixels);
+
+/**
+* @brief Copies the image into dense width * height pixels, rows in parallel.
+*/
+void image_buffer_store(const ImageBuffer &image, int *pixels);
+
+/**
+* @brief Runs op (OP_PREWITT / OP_EDGE) with engine on padded buffers, every
+* engine works on the padded rows directly (see filter_prewitt on views).
+* Edge detection thresholds in in place, like filter_edge_detection.
+*
+* @return pixels the simd-flat engine filled without the kernel, 0 for the other engines
+*/
+long long image_filter(int op, int engine, ImageBuffer &in, ImageBuffer &out);
+
+#endif /* IMAGEBUFFER_H_ */
@@ -0,0 +1,126 @@
+/*
+ * ImageGenerator.cpp
+ *
+ *  Seeded synthetic grayscale images.
+ */
+
+#include "ImageGenerator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+#define GEN_CELL				64
+
+using namespace std;
+using namespace tbb;
+
+static const char *patternNames[GEN_PATTERN_COUNT] = {"mixed", "edges", "flat", "noise", "stripes", "checker"};
+
+
+/**
+* @brief splitmix64 finalizer of seed, x and y: independent random bits per position
+*/
+static inline unsigned long long position_hash(unsigned long long seed, unsigned long long x, unsigned long long y)
+{
+	unsigned long long z = seed + x * 0x9e3779b97f4a7c15ULL + y * 0xc2b2ae3d27d4eb4fULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+const char *generator_pattern_name(int pattern)
+{
+	if (pattern < 0 || pattern >= GEN_PATTERN_COUNT) return "unknown";
+	return patternNames[pattern];
+}
+
+int generator_pattern_from_name(const char *name)
+{
+	for (int pattern = 0; pattern < GEN_PATTERN_COUNT; pattern++) {
+		if (strcmp(name, patternNames[pattern]) == 0) return pattern;
+	}
+	return -1;
+}
+
+static void generate_row(int *row, int width, long long j, int pattern, unsigned long long seed)
+{
+	unsigned long long global = position_hash(seed, 0, 0);
+
+	switch (pattern)
+	{
+		case GEN_EDGES:
+			for (int i = 0; i < width; i++) {
+				// one shape per cell: rectangle or disc, own fore- and background
+				unsigned long long cell = position_hash(seed, i / GEN_CELL, j / GEN_CELL);
+				int cx = (int)(cell & 63), cy = (int)((cell >> 6) & 63);
+				int radius = 8 + (int)((cell >> 12) % 24);
+				int dx = i % GEN_CELL - cx, dy = (int)(j % GEN_CELL) - cy;
+				bool inside = (cell >> 20) & 1 ? dx * dx + dy * dy <= radius * radius : abs(dx) <= radius && abs(dy) <= radius;
+				row[i] = inside ? (int)((cell >> 24) & 0xff) : (int)((cell >> 32) & 0xff);
+			}
+			break;
+		case GEN_FLAT:
+			for (int i = 0; i < width; i++) row[i] = (int)(global & 0xff);
+			break;
+		case GEN_NOISE:
+			for (int i = 0; i < width; i++) row[i] = (int)(position_hash(seed, i, j) & 0xff);
+			break;
+		case GEN_STRIPES: {
+			int period = 4 + (int)(global % 36);
+			long long slope = (global >> 8) & 1;
+			for (int i = 0; i < width; i++) row[i] = ((i + slope * j) / period) & 1 ? 255 : 0;
+			break;
+		}
+		case GEN_CHECKER: {
+			int cell = 4 + (int)(global % 64);
+			for (int i = 0; i < width; i++) row[i] = ((i / cell) + (j / cell)) & 1 ? 255 : 0;
+			break;
+		}
+		default:
+			for (int i = 0; i < width; i++) {
+				unsigned long long noise = position_hash(seed, i, j);
+				int value = (int)((i + j) % 256);
+				if (((i / 97) + (j / 61)) % 3 == 0) value = 40;
+				if (noise % 16 == 0) value = (int)((noise >> 8) & 0xff);
+				row[i] = value;
+			}
+			break;
+	}
+}
+
+void generate_image(int *pixels, int width, int height, size_t stride, int pattern, unsigned long long seed)
+{
+	parallel_for(blocked_range<int>(0, height), [&](const blocked_range<int> &r) {
+		for (int j = r.begin(); j != r.end(); j++) generate_row(pixels + (size_t)j * stride, width, j, pattern, seed);
+	});
+}
+
+bool generator_parse_spec(const char *text, int *pattern, int *width, int *height, unsigned long long *seed)
+{
+	if (strncmp(text, "gen:", 4) != 0) return false;
+
+	const char *name = text + 4;
+	const char *size = strchr(name, ':');
+	if (size == NULL) return false;
+
+	char patternName[32];
+	size_t nameLength = size - name;
+	if (nameLength == 0 || nameLength >= sizeof(patternName)) return false;
+	memcpy(patternName, name, nameLength);
+	patternName[nameLength] = 0;
+	*pattern = generator_pattern_from_name(patternName);
+
+	char *end;
+	long w = strtol(size + 1, &end, 10);
+	if (*end != 'x') return false;
+	long h = strtol(end + 1, &end, 10);
+
+	*seed = GEN_DEFAULT_SEED;
+	if (*end == ':') *seed = strtoull(end + 1, &end, 10);
+	if (*end != 0 || *pattern < 0 || w <= 0 || h <= 0 || w > 0x7fffffff || h > 0x7fffffff) return false;
+
+	*width = (int)w;
+	*height = (int)h;
+	return true;
+}
@@ -0,0 +1,55 @@
+/*
+ * ImageGenerator.h
+ *
+ *  Seeded synthetic grayscale images for benchmarks, tuning and stress
+ *  tests. Every pixel is a pure function of (pattern, seed, x, y), so
+ *  images are identical regardless of thread count or generation order,
+ *  and any size works (odd, non-power-of-two, more than 4 GB of pixels).
+ *
+ *  Wherever an input file name is accepted, a generator spec can be given
+ *  instead and the image is created in memory without touching disk:
+ *    gen:PATTERN:WIDTHxHEIGHT[:SEED]      e.g. gen:edges:4001x3001:7
+ */
+
+#ifndef IMAGEGENERATOR_H_
+#define IMAGEGENERATOR_H_
+
+#include <stddef.h>
+
+#define GEN_MIXED				0		// gradient, flat rectangles and sparse noise
+#define GEN_EDGES				1		// random shapes on random background, one per 64x64 cell
+#define GEN_FLAT				2		// one constant value
+#define GEN_NOISE				3		// uniform noise
+#define GEN_STRIPES				4		// straight or diagonal black and white stripes
+#define GEN_CHECKER				5		// black and white checkerboard
+#define GEN_PATTERN_COUNT		6
+
+#define GEN_DEFAULT_SEED		12345
+
+const char *generator_pattern_name(int pattern);
+
+/**
+* @brief Pattern id from its name, -1 if name is unknown
+*/
+int generator_pattern_from_name(const char *name);
+
+/**
+* @brief Fills rows of an image in parallel.
+*
+* @param pixels first pixel of the image
+* @param width image width
+* @param height image height
+* @param stride ints between starts of two rows (width for dense buffers)
+* @param pattern one of GEN_* values
+* @param seed seed of the image
+*/
+void generate_image(int *pixels, int width, int height, size_t stride, int pattern, unsigned long long seed);
+
+/**
+* @brief Parses "gen:PATTERN:WIDTHxHEIGHT[:SEED]".
+*
+* @return false if text is not a valid generator spec
+*/
+bool generator_parse_spec(const char *text, int *pattern, int *width, int *height, unsigned long long *seed);
+
+#endif /* IMAGEGENERATOR_H_ */
@@ -0,0 +1,169 @@
+/*
+ * ImagePool.cpp
+ *
+ *  Size class pool for image, pixel and row buffers.
+ */
+
+#include "ImagePool.h"
+#include <stdlib.h>
+#include <atomic>
+#include <tbb/concurrent_queue.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#define POOL_MIN_LOG			8
+#define POOL_MIN_BLOCK			((size_t)1 << POOL_MIN_LOG)
+#define POOL_CLASSES			(4 * (64 - POOL_MIN_LOG) + 1)
+
+using namespace std;
+using namespace tbb;
+
+static concurrent_queue<void *> freeLists[POOL_CLASSES];
+static atomic<size_t> classRetained[POOL_CLASSES];
+static atomic<size_t> retainedBytes(0);
+static atomic<size_t> classLimit(POOL_CLASS_LIMIT);
+static atomic<size_t> totalLimit(POOL_TOTAL_LIMIT);
+static atomic<int> hugePages(-1);
+
+
+/**
+* @brief Maps request size to its class.
+*
+* @param bytes requested size
+* @param blockBytes size of blocks in the class
+* @return class index
+*/
+static int size_class(size_t bytes, size_t *blockBytes)
+{
+	if (bytes <= POOL_MIN_BLOCK) {
+		*blockBytes = POOL_MIN_BLOCK;
+		return 0;
+	}
+
+	// 2^k < bytes <= 2^(k+1), split into four steps of 2^(k-2)
+	int k = 63;
+	while (!(((bytes - 1) >> k) & 1)) k--;
+	size_t step = (size_t)1 << (k - 2);
+	size_t sub = ((bytes - 1) >> (k - 2)) - 4;
+
+	*blockBytes = (sub + 5) * step;
+	return (k - POOL_MIN_LOG) * 4 + (int)sub + 1;
+}
+
+static size_t class_bytes(int cls)
+{
+	if (cls == 0) return POOL_MIN_BLOCK;
+
+	int k = (cls - 1) / 4 + POOL_MIN_LOG;
+	return (size_t)((cls - 1) % 4 + 5) << (k - 2);
+}
+
+static void *block_alloc(size_t size)
+{
+#if defined(_WIN32)
+	return _aligned_malloc(size, POOL_ALIGNMENT);
+#else
+	void *block = NULL;
+	bool huge = size >= POOL_HUGE_PAGE && pool_huge_pages();
+
+	if (posix_memalign(&block, huge ? POOL_HUGE_PAGE : POOL_ALIGNMENT, size) != 0) return NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// only a hint, the kernel falls back to small pages when THP is off
+	if (huge) madvise(block, size, MADV_HUGEPAGE);
+#endif
+	return block;
+#endif
+}
+
+static void block_free(void *block)
+{
+#if defined(_WIN32)
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+void *pool_alloc(size_t bytes)
+{
+	size_t blockBytes;
+	int cls = size_class(bytes, &blockBytes);
+	void *block;
+
+	if (freeLists[cls].try_pop(block)) {
+		classRetained[cls] -= blockBytes;
+		retainedBytes -= blockBytes;
+		return block;
+	}
+	return block_alloc(blockBytes);
+}
+
+void pool_free(void *block, size_t bytes)
+{
+	if (block == NULL) return;
+
+	size_t blockBytes;
+	int cls = size_class(bytes, &blockBytes);
+
+	// counted first, so concurrent frees cannot all pass the limits
+	size_t inClass = classRetained[cls] += blockBytes;
+	size_t total = retainedBytes += blockBytes;
+	if (inClass > classLimit || total > totalLimit) {
+		classRetained[cls] -= blockBytes;
+		retainedBytes -= blockBytes;
+		block_free(block);
+		return;
+	}
+	freeLists[cls].push(block);
+}
+
+void pool_trim(size_t keepBytes)
+{
+	for (int cls = POOL_CLASSES - 1; cls >= 0 && retainedBytes > keepBytes; cls--) {
+		void *block;
+		while (retainedBytes > keepBytes && freeLists[cls].try_pop(block)) {
+			classRetained[cls] -= class_bytes(cls);
+			retainedBytes -= class_bytes(cls);
+			block_free(block);
+		}
+	}
+}
+
+void pool_set_limits(size_t classBytes, size_t totalBytes)
+{
+	classLimit = classBytes;
+	totalLimit = totalBytes;
+
+	for (int cls = 0; cls < POOL_CLASSES; cls++) {
+		void *block;
+		while (classRetained[cls] > classBytes && freeLists[cls].try_pop(block)) {
+			classRetained[cls] -= class_bytes(cls);
+			retainedBytes -= class_bytes(cls);
+			block_free(block);
+		}
+	}
+	pool_trim(totalBytes);
+}
+
+size_t pool_retained_bytes()
+{
+	return retainedBytes;
+}
+
+void pool_set_huge_pages(bool enabled)
+{
+	hugePages = enabled ? 1 : 0;
+}
+
+bool pool_huge_pages()
+{
+	if (hugePages < 0) {
+		const char *value = getenv("EDGE_HUGE_PAGES");
+		hugePages = value != NULL && atoi(value) != 0 ? 1 : 0;
+	}
+	return hugePages > 0;
+}
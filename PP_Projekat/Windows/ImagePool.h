@@ -0,0 +1,72 @@
+/*
+ * ImagePool.h
+ *
+ *  Size class pool for image, pixel and row buffers. Freed blocks are kept
+ *  on a lock-free list of their size class and handed out again, so a
+ *  batch of equally sized images allocates (and page faults) only for the
+ *  first one. Classes are four per power of two, a block wastes at most a
+ *  quarter of its size. Kept blocks are bounded per class and in total
+ *  (pool_set_limits), a block freed beyond that goes back to the system,
+ *  so a process that saw many image sizes does not hold the peak memory of
+ *  every one of them. Blocks of 2 MB and more can be backed by
+ *  transparent huge pages (Linux), enabled with pool_set_huge_pages or the
+ *  EDGE_HUGE_PAGES=1 environment variable.
+ */
+
+#ifndef IMAGEPOOL_H_
+#define IMAGEPOOL_H_
+
+#include <stddef.h>
+
+#define POOL_ALIGNMENT			64
+#define POOL_HUGE_PAGE			(2 << 20)
+#define POOL_CLASS_LIMIT		((size_t)256 << 20)		// bytes kept per size class
+#define POOL_TOTAL_LIMIT		((size_t)1 << 30)		// bytes kept over all classes
+
+/**
+* @brief Takes a block of at least bytes from the pool, 64 byte aligned.
+* Contents are undefined.
+*/
+void *pool_alloc(size_t bytes);
+
+/**
+* @brief Returns block to the pool.
+*
+* @param block block from pool_alloc, NULL is ignored
+* @param bytes size passed to pool_alloc
+*/
+void pool_free(void *block, size_t bytes);
+
+/**
+* @brief Releases pooled blocks to the system, largest classes first, until at
+* most keepBytes are kept.
+*/
+void pool_trim(size_t keepBytes = 0);
+
+/**
+* @brief Bytes kept at most per size class and over all classes.
+*/
+void pool_set_limits(size_t classBytes, size_t totalBytes);
+
+/**
+* @brief Bytes currently kept in the pool (free blocks only).
+*/
+size_t pool_retained_bytes();
+
+void pool_set_huge_pages(bool enabled);
+bool pool_huge_pages();
+
+/**
+* @brief Pool block of width * height ints.
+*/
+inline int *pool_alloc_image(int width, int height)
+{
+	return (int *) pool_alloc((size_t)width * height * sizeof(int));
+}
+
+inline void pool_free_image(int *buffer, int width, int height)
+{
+	pool_free(buffer, (size_t)width * height * sizeof(int));
+}
+
+#endif /* IMAGEPOOL_H_ */
@@ -0,0 +1,44 @@
+/*
+ * ImageProbe.h
+ *
+ *  Fast metadata prober: reads only the BMFH/BMIH (or QOG) header of every
+ *  file of an input set, in parallel, with one small read per file.
+ */
+
+#ifndef IMAGEPROBE_H_
+#define IMAGEPROBE_H_
+
+#include <string>
+#include <vector>
+
+struct ImageInfo {
+	bool valid;
+	int width;
+	int height;
+	int bitDepth;			// 8 for QOG files
+	long long pixels;
+};
+
+/**
+* @brief Reads image header of one file.
+*
+* @param filename BMP or QOG file
+* @param info filled with header data, info.valid is false if header is unreadable
+*/
+void probe_image(const char *filename, ImageInfo &info);
+
+/**
+* @brief Probes all files in parallel.
+*
+* @param filenames input set
+* @param infos result, one entry per file in the same order
+*/
+void probe_images(const std::vector<std::string> &filenames, std::vector<ImageInfo> &infos);
+
+/**
+* @brief Size class of an image: floor(log2(pixels)), -1 for empty or invalid images.
+* Every image of class k fits a buffer of 2^(k+1) pixels.
+*/
+int probe_size_class(long long pixels);
+
+#endif /* IMAGEPROBE_H_ */
@@ -0,0 +1,63 @@
+/*
+ * ImageView.h
+ *
+ *  Non-owning view of a grayscale image: first pixel, size and row stride.
+ *  A view can name a whole dense buffer, a padded ImageBuffer, an image
+ *  owned by someone else or a rectangle inside any of them, so the filters
+ *  work on all of these in place. Input and output of a filter are
+ *  separate views and may have different strides.
+ *
+ *  The filters keep their border handling on linear indices inside the
+ *  view (a window that leaves the view on the left reads the end of the
+ *  previous row of the view), so a view gives the same result as a dense
+ *  copy of its pixels.
+ */
+
+#ifndef IMAGEVIEW_H_
+#define IMAGEVIEW_H_
+
+template <typename T>
+struct ImageView {
+	T *data;
+	int width;
+	int height;
+	int stride;				// elements between starts of two rows, >= width
+
+	ImageView() : data(0), width(0), height(0), stride(0) {}
+
+	/**
+	* @param stride elements between rows, 0 for dense rows
+	*/
+	ImageView(T *data, int width, int height, int stride = 0)
+		: data(data), width(width), height(height), stride(stride > 0 ? stride : width) {}
+
+	operator ImageView<const T>() const
+	{
+		return ImageView<const T>(data, width, height, stride);
+	}
+
+	T *row(int j) const
+	{
+		return data + (long long)j * stride;
+	}
+
+	T &at(int i, int j) const
+	{
+		return data[(long long)j * stride + i];
+	}
+
+	bool dense() const
+	{
+		return stride == width;
+	}
+
+	/**
+	* @brief View of the rectangle x0..x1, y0..y1 (exclusive ends), same stride.
+	*/
+	ImageView sub(int x0, int y0, int x1, int y1) const
+	{
+		return ImageView(row(y0) + x0, x1 - x0, y1 - y0, stride);
+	}
+};
+
+#endif /* IMAGEVIEW_H_ */
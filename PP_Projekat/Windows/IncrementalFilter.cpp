@@ -0,0 +1,164 @@
+/*
+ * IncrementalFilter.cpp
+ *
+ *  Recomputes only the tiles of a frame that changed since the last one.
+ */
+
+#include "IncrementalFilter.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include <string.h>
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+using namespace std;
+using namespace tbb;
+
+
+IncrementalFilter::IncrementalFilter(EdgeEngine &engine, int tileSize)
+	: engine(engine), tileSize(max(tileSize, INCREMENTAL_MIN_TILE)), op(0), threshold(0), width(0), height(0),
+	lastDirtyTiles(0), lastPixels(0)
+{
+}
+
+IncrementalFilter::~IncrementalFilter()
+{
+	release();
+}
+
+void IncrementalFilter::release()
+{
+	if (previous.data != NULL) pool_free_image(previous.data, previous.stride, previous.height);
+	if (result.data != NULL) pool_free_image(result.data, result.stride, result.height);
+	previous = ImageView<int>();
+	result = ImageView<int>();
+}
+
+void IncrementalFilter::reset()
+{
+	release();
+}
+
+int IncrementalFilter::tileCount() const
+{
+	return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+int IncrementalFilter::dirtyTiles() const
+{
+	return lastDirtyTiles;
+}
+
+long long IncrementalFilter::recomputedPixels() const
+{
+	return lastPixels;
+}
+
+/**
+* @brief Marks every tile whose outputs read a dirty tile: its eight neighbours
+* (the halo is smaller than a tile) and, for tiles at the left or right image
+* border, the tiles at the other border one row up or down, where the linear
+* border handling wraps the windows. The last tileSize columns count as the
+* right border, the last tile column alone can be narrower than a window.
+*/
+void IncrementalFilter::markRecompute(int tilesX, int tilesY)
+{
+	int rightBorder = max(0, width - tileSize) / tileSize;
+
+	recompute.assign(dirty.size(), 0);
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			if (!dirty[ty * tilesX + tx]) continue;
+			for (int y = max(0, ty - 1); y <= min(tilesY - 1, ty + 1); y++) {
+				for (int x = max(0, tx - 1); x <= min(tilesX - 1, tx + 1); x++) recompute[y * tilesX + x] = 1;
+				if (tx == 0) {
+					for (int x = rightBorder; x < tilesX; x++) recompute[y * tilesX + x] = 1;
+				}
+				if (tx >= rightBorder) recompute[y * tilesX] = 1;
+			}
+		}
+	}
+}
+
+ImageView<const int> IncrementalFilter::run(int frameOp, ImageView<const int> in, int frameThreshold)
+{
+	int tilesX = (in.width + tileSize - 1) / tileSize;
+	int tilesY = (in.height + tileSize - 1) / tileSize;
+
+	if (previous.data == NULL || in.width != width || in.height != height || frameOp != op || frameThreshold != threshold) {
+		release();
+		width = in.width;
+		height = in.height;
+		op = frameOp;
+		threshold = frameThreshold;
+
+		int stride = image_stride(width);
+		previous = ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+		result = ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+		if (previous.data == NULL || result.data == NULL) {
+			release();
+			return ImageView<const int>();
+		}
+
+		{
+			TRACE_SCOPE("keep frame", TRACE_STAGE);
+			parallel_for(blocked_range<int>(0, height), [&](const blocked_range<int> &r) {
+				for (int j = r.begin(); j != r.end(); j++) memcpy(previous.row(j), in.row(j), width * sizeof(int));
+			});
+		}
+		engine.run(op, previous, result, threshold);
+		lastDirtyTiles = tilesX * tilesY;
+		lastPixels = (long long)width * height;
+		return result;
+	}
+
+	// rows are compared in memory order, whole rows first (most are unchanged);
+	// changed pixels are taken over right away, the next frame compares with them
+	dirty.assign(tilesX * tilesY, 0);
+	{
+		TRACE_SCOPE("compare tiles", TRACE_STAGE);
+		parallel_for(blocked_range<int>(0, tilesY), [&](const blocked_range<int> &r) {
+			for (int ty = r.begin(); ty != r.end(); ty++) {
+				for (int j = ty * tileSize; j < min(height, (ty + 1) * tileSize); j++) {
+					const int *row = in.row(j);
+					int *kept = previous.row(j);
+					if (memcmp(row, kept, width * sizeof(int)) == 0) continue;
+
+					for (int tx = 0; tx < tilesX; tx++) {
+						int x0 = tx * tileSize;
+						size_t bytes = (min(width, x0 + tileSize) - x0) * sizeof(int);
+						if (memcmp(row + x0, kept + x0, bytes) == 0) continue;
+						memcpy(kept + x0, row + x0, bytes);
+						dirty[ty * tilesX + tx] = 1;
+					}
+				}
+			}
+		});
+	}
+	markRecompute(tilesX, tilesY);
+
+	// runs of tiles to recompute in every tile row
+	regions.clear();
+	lastPixels = 0;
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; ) {
+			if (!recompute[ty * tilesX + tx]) {
+				tx++;
+				continue;
+			}
+			int first = tx;
+			while (tx < tilesX && recompute[ty * tilesX + tx]) tx++;
+			RoiRect rect = {first * tileSize, ty * tileSize, min(width, tx * tileSize), min(height, (ty + 1) * tileSize)};
+			regions.push_back(rect);
+			lastPixels += roi_area(rect);
+		}
+	}
+	lastDirtyTiles = (int)count(dirty.begin(), dirty.end(), 1);
+
+	if (!regions.empty()) {
+		TRACE_SCOPE("filter dirty tiles", TRACE_STAGE);
+		engine.runRegions(op, previous, result, 0, 0, regions.data(), (int)regions.size(), threshold);
+	}
+	return result;
+}
@@ -0,0 +1,78 @@
+/*
+ * IncrementalFilter.h
+ *
+ *  Filtering of successive frames that change little, e.g. camera frames
+ *  of a static scene or repeated scans of a document. The filter keeps the
+ *  previous input and output. Every frame is compared with the previous
+ *  one tile by tile; only changed (dirty) tiles and the neighbour tiles
+ *  their windows reach are recomputed, through EdgeEngine::runRegions,
+ *  everything else is reused. Results are those of filtering the whole
+ *  frame.
+ *
+ *  A change of image size, operator or threshold recomputes the whole
+ *  frame; after reconfiguring the engine call reset.
+ */
+
+#ifndef INCREMENTALFILTER_H_
+#define INCREMENTALFILTER_H_
+
+#include <vector>
+#include "EdgeEngine.h"
+
+#define INCREMENTAL_TILE		64
+#define INCREMENTAL_MIN_TILE	16		// a window halo must not reach past the neighbour tile
+
+class IncrementalFilter {
+private:
+	EdgeEngine &engine;
+	int tileSize;
+	int op;
+	int threshold;
+	int width;
+	int height;
+	ImageView<int> previous;			// input of the last frame
+	ImageView<int> result;				// output of the last frame
+	std::vector<char> dirty;
+	std::vector<char> recompute;
+	std::vector<RoiRect> regions;
+	int lastDirtyTiles;
+	long long lastPixels;
+
+	IncrementalFilter(const IncrementalFilter &);
+
+	void release();
+	void markRecompute(int tilesX, int tilesY);
+public:
+	/**
+	* @param tileSize side of the compared tiles, at least INCREMENTAL_MIN_TILE
+	*/
+	IncrementalFilter(EdgeEngine &engine, int tileSize = INCREMENTAL_TILE);
+	~IncrementalFilter();
+
+	/**
+	* @brief Forgets the previous frame, the next one is filtered whole.
+	*/
+	void reset();
+
+	/**
+	* @brief Filters the next frame.
+	*
+	* @return the output, owned by the filter and valid until the next call;
+	* NULL data if the buffers cannot be allocated
+	*/
+	ImageView<const int> run(int op, ImageView<const int> in, int threshold);
+
+	int tileCount() const;
+
+	/**
+	* @brief Tiles that changed in the last frame, all of them for a full recompute.
+	*/
+	int dirtyTiles() const;
+
+	/**
+	* @brief Output pixels computed for the last frame.
+	*/
+	long long recomputedPixels() const;
+};
+
+#endif /* INCREMENTALFILTER_H_ */
@@ -0,0 +1,147 @@
+/*
+ * NumaPlacement.cpp
+ *
+ *  NUMA-aware image placement and node-affine tile scheduling.
+ */
+
+#include "NumaPlacement.h"
+#include "EdgeFilters.h"
+#include "SimdFilters.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <tbb/info.h>
+#include <tbb/task_group.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+using namespace std;
+using namespace tbb;
+
+
+NumaArenas::NumaArenas()
+{
+	nodes = info::numa_nodes();
+	if (nodes.empty()) nodes.push_back((numa_node_id)task_arena::automatic);
+
+	for (size_t k = 0; k < nodes.size(); k++) {
+		arenas.push_back(new task_arena(task_arena::constraints(nodes[k])));
+	}
+}
+
+NumaArenas::~NumaArenas()
+{
+	for (size_t k = 0; k < arenas.size(); k++) delete arenas[k];
+}
+
+NumaArenas &NumaArenas::instance()
+{
+	static NumaArenas numaArenas;
+	return numaArenas;
+}
+
+int NumaArenas::nodeCount() const
+{
+	return (int)nodes.size();
+}
+
+void NumaArenas::runBands(int height, const function<void(int, int)> &body)
+{
+	int count = (int)arenas.size();
+
+	if (count == 1) {
+		arenas[0]->execute([&] { body(0, height); });
+		return;
+	}
+
+	// start every band in its own arena, then wait for all of them
+	vector<task_group> groups(count);
+	for (int k = 0; k < count; k++) {
+		int y0 = (int)((long long)height * k / count);
+		int y1 = (int)((long long)height * (k + 1) / count);
+		arenas[k]->execute([&, k, y0, y1] {
+			groups[k].run([&, y0, y1] { body(y0, y1); });
+		});
+	}
+	for (int k = 0; k < count; k++) {
+		arenas[k]->execute([&, k] { groups[k].wait(); });
+	}
+}
+
+int *numa_alloc_image(int width, int height)
+{
+	int *buffer = pool_alloc_image(width, height);
+	if (buffer == NULL || NumaArenas::instance().nodeCount() == 1) return buffer;
+
+	// allocating a large block only reserves pages, the first write places them
+	NumaArenas::instance().runBands(height, [&](int y0, int y1) {
+		parallel_for(blocked_range<int>(y0, y1), [&](const blocked_range<int> &r) {
+			memset(buffer + (size_t)r.begin() * width, 0, (size_t)(r.end() - r.begin()) * width * sizeof(int));
+		});
+	});
+
+	return buffer;
+}
+
+void numa_free_image(int *buffer, int width, int height)
+{
+	pool_free_image(buffer, width, height);
+}
+
+/**
+* @brief Runs body over tiles of one row band, inside the band's arena.
+*/
+static void numa_for_each_tile(int width, int height, const function<void(int, int, int, int)> &body)
+{
+	NumaArenas::instance().runBands(height, [&](int y0, int y1) {
+		parallel_for_tiles(width, y1 - y0, [&](int x0, int ty0, int x1, int ty1) {
+			body(x0, y0 + ty0, x1, y0 + ty1);
+		});
+	});
+}
+
+/**
+* @brief Vectorized Prewitt filter, tiles run on the node that owns their rows
+*/
+void filter_numa_prewitt(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_numa_prewitt(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_numa_prewitt(ImageView<const int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_prewitt(kernel);
+	simd_kernel_bind(kernel, in.stride);
+
+	numa_for_each_tile(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_prewitt(kernel, in, out, x0, y0, x1, y1);
+	});
+}
+
+/**
+* @brief Vectorized edge detection, tiles run on the node that owns their rows
+*/
+void filter_numa_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_numa_edge_detection(ImageView<int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_numa_edge_detection(ImageView<int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_edge_detection(kernel);
+	simd_kernel_bind(kernel, in.stride);
+
+	NumaArenas::instance().runBands(in.height, [&](int y0, int y1) {
+		parallel_for(blocked_range<int>(y0, y1, max(1, CUTOFF)), [&](const blocked_range<int> &r) {
+			TRACE_SCOPE("threshold", TRACE_TASK);
+			simd_threshold_edge_copy(in, in, r.begin(), r.end(), THRESHOLD);
+		});
+	});
+	numa_for_each_tile(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_edge_detection(kernel, in, out, x0, y0, x1, y1);
+	});
+}
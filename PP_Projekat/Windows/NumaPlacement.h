@@ -0,0 +1,56 @@
+/*
+ * NumaPlacement.h
+ *
+ *  NUMA-aware image placement. The image is split into one row band per
+ *  NUMA node; each band is first touched (and later filtered) by threads of
+ *  a task_arena bound to that node, so its pages stay local to the socket
+ *  that works on them. On single node machines everything runs in one
+ *  arena and behaves like the tiled engines.
+ */
+
+#ifndef NUMAPLACEMENT_H_
+#define NUMAPLACEMENT_H_
+
+#include <vector>
+#include <functional>
+#include <tbb/task_arena.h>
+#include "ImageView.h"
+
+class NumaArenas {
+private:
+	std::vector<int> nodes;
+	std::vector<tbb::task_arena *> arenas;
+
+	NumaArenas();
+	NumaArenas(const NumaArenas &);
+public:
+	~NumaArenas();
+
+	static NumaArenas &instance();
+
+	int nodeCount() const;
+
+	/**
+	* @brief Runs body once per node band, concurrently, each inside its node arena.
+	*
+	* @param height number of rows to split
+	* @param body called with first row and row after the band
+	*/
+	void runBands(int height, const std::function<void(int, int)> &body);
+};
+
+/**
+* @brief Takes width * height ints from the image pool and first touches every row
+* band on its node (skipped on single node machines). Pages of a recycled block stay
+where they were first touched. Free with numa_free_image.
+*/
+int *numa_alloc_image(int width, int height);
+
+void numa_free_image(int *buffer, int width, int height);
+
+void filter_numa_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+void filter_numa_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+void filter_numa_prewitt(ImageView<const int> in, ImageView<int> out);
+void filter_numa_edge_detection(ImageView<int> in, ImageView<int> out);
+
+#endif /* NUMAPLACEMENT_H_ */
@@ -0,0 +1,194 @@
+/*
+ * PerfCounters.cpp
+ *
+ *  perf_event_open counters summed over all threads of the process.
+ */
+
+#include "PerfCounters.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+static const char *counterNames[PERF_COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"};
+
+
+const char *perf_counter_name(int counter)
+{
+	if (counter < 0 || counter >= PERF_COUNTER_COUNT) return "unknown";
+	return counterNames[counter];
+}
+
+#ifdef __linux__
+
+/**
+* @brief perf type and config of a counter
+*/
+static void counter_event(int counter, unsigned int *type, unsigned long long *config)
+{
+	unsigned long long readMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+	*type = PERF_TYPE_HARDWARE;
+	switch (counter)
+	{
+		case PERF_CYCLES: *config = PERF_COUNT_HW_CPU_CYCLES; break;
+		case PERF_INSTRUCTIONS: *config = PERF_COUNT_HW_INSTRUCTIONS; break;
+		case PERF_LLC_MISSES: *config = PERF_COUNT_HW_CACHE_MISSES; break;
+		case PERF_BRANCH_MISSES: *config = PERF_COUNT_HW_BRANCH_MISSES; break;
+		case PERF_L1D_MISSES:
+			*type = PERF_TYPE_HW_CACHE;
+			*config = PERF_COUNT_HW_CACHE_L1D | readMiss;
+			break;
+		default:
+			*type = PERF_TYPE_HW_CACHE;
+			*config = PERF_COUNT_HW_CACHE_DTLB | readMiss;
+			break;
+	}
+}
+
+static int open_counter(int counter, int tid)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	unsigned int type;
+	unsigned long long config;
+	counter_event(counter, &type, &config);
+
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters()
+{
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) values[c] = -1;
+
+	int tid = (int)syscall(SYS_gettid);
+	threads.insert(tid);
+	openThread(tid);
+
+	if (!available()) {
+		errorText = strerror(errno);
+		if (errno == EACCES || errno == EPERM) errorText += " (see /proc/sys/kernel/perf_event_paranoid)";
+		else if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP) errorText += " (no hardware counters, virtual machine?)";
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		for (int fd : fds[c]) close(fd);
+	}
+}
+
+void PerfCounters::openThread(int tid)
+{
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		int fd = open_counter(c, tid);
+		if (fd >= 0) fds[c].push_back(fd);
+	}
+}
+
+void PerfCounters::start()
+{
+	if (!available()) return;
+
+	// workers are started lazily, look for threads that did not exist last time
+	DIR *dir = opendir("/proc/self/task");
+	if (dir != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			int tid = atoi(entry->d_name);
+			if (tid > 0 && threads.insert(tid).second) openThread(tid);
+		}
+		closedir(dir);
+	}
+
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		for (int fd : fds[c]) ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	}
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		for (int fd : fds[c]) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void PerfCounters::stop()
+{
+	if (!available()) return;
+
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		for (int fd : fds[c]) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	}
+
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		if (fds[c].empty()) continue;
+
+		double sum = 0;
+		for (int fd : fds[c]) {
+			unsigned long long data[3];		// value, time enabled, time running
+			if (read(fd, data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+			sum += (double)data[0] * data[1] / data[2];
+		}
+		values[c] = (long long)sum;
+	}
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) values[c] = -1;
+	errorText = "perf_event_open is only available on Linux";
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::openThread(int tid)
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+void PerfCounters::stop()
+{
+}
+
+#endif
+
+bool PerfCounters::available() const
+{
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		if (!fds[c].empty()) return true;
+	}
+	return false;
+}
+
+const char *PerfCounters::error() const
+{
+	return errorText.c_str();
+}
+
+long long PerfCounters::value(int counter) const
+{
+	if (counter < 0 || counter >= PERF_COUNTER_COUNT) return -1;
+	return values[counter];
+}
@@ -0,0 +1,72 @@
+/*
+ * PerfCounters.h
+ *
+ *  Hardware performance counters through Linux perf_event_open. Counters
+ *  are opened for every thread of the process (TBB workers of all arenas
+ *  included) and summed, so parallel engines are counted completely;
+ *  threads started after start() are picked up by the next start(). Only
+ *  user space events are requested, which works with the default
+ *  perf_event_paranoid setting of 2.
+ *
+ *  Counters the CPU or kernel does not provide (virtual machines,
+ *  containers, other platforms) are reported as unavailable, values -1.
+ */
+
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <vector>
+#include <set>
+#include <string>
+
+#define PERF_CYCLES				0
+#define PERF_INSTRUCTIONS		1
+#define PERF_L1D_MISSES			2		// L1 data cache read misses
+#define PERF_LLC_MISSES			3		// last level cache misses
+#define PERF_DTLB_MISSES		4		// data TLB read misses
+#define PERF_BRANCH_MISSES		5
+#define PERF_COUNTER_COUNT		6
+
+const char *perf_counter_name(int counter);
+
+class PerfCounters {
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	/**
+	* @brief True if at least one counter could be opened.
+	*/
+	bool available() const;
+
+	/**
+	* @brief Why no counter could be opened, empty if some are available.
+	*/
+	const char *error() const;
+
+	/**
+	* @brief Opens counters for new threads, resets and enables all of them.
+	*/
+	void start();
+
+	/**
+	* @brief Disables counters and sums them over threads. Values are scaled
+	* up when the kernel had to multiplex counters.
+	*/
+	void stop();
+
+	/**
+	* @brief Value of counter between the last start and stop, -1 if unavailable.
+	*/
+	long long value(int counter) const;
+
+private:
+	void openThread(int tid);
+
+	std::set<int> threads;
+	std::vector<int> fds[PERF_COUNTER_COUNT];
+	long long values[PERF_COUNTER_COUNT];
+	std::string errorText;
+};
+
+#endif /* PERFCOUNTERS_H_ */
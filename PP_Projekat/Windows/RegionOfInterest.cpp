@@ -0,0 +1,134 @@
+/*
+ * RegionOfInterest.cpp
+ *
+ *  Rectangle arithmetic for region of interest filtering.
+ */
+
+#include "RegionOfInterest.h"
+#include <stdio.h>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+
+bool roi_parse(const char *text, RoiRect &rect)
+{
+	int x, y, w, h;
+	char rest;
+	if (sscanf(text, "%d,%d,%dx%d%c", &x, &y, &w, &h, &rest) != 4 &&
+		sscanf(text, "%d,%d,%d,%d%c", &x, &y, &w, &h, &rest) != 4) return false;
+	if (w < 0 || h < 0) return false;
+
+	rect.x0 = x;
+	rect.y0 = y;
+	rect.x1 = x + w;
+	rect.y1 = y + h;
+	return true;
+}
+
+bool roi_clip(RoiRect &rect, int width, int height)
+{
+	rect.x0 = max(rect.x0, 0);
+	rect.y0 = max(rect.y0, 0);
+	rect.x1 = min(rect.x1, width);
+	rect.y1 = min(rect.y1, height);
+	return !roi_empty(rect);
+}
+
+void roi_disjoint(const RoiRect *rects, int count, vector<RoiRect> &pieces)
+{
+	pieces.clear();
+
+	vector<RoiRect> sorted;
+	vector<int> edges;
+	for (int k = 0; k < count; k++) {
+		if (roi_empty(rects[k])) continue;
+		sorted.push_back(rects[k]);
+		edges.push_back(rects[k].y0);
+		edges.push_back(rects[k].y1);
+	}
+	sort(sorted.begin(), sorted.end(), [](const RoiRect &a, const RoiRect &b) { return a.y0 < b.y0; });
+	sort(edges.begin(), edges.end());
+	edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+	// sweep over the bands between horizontal edges, each band is the union of
+	// the column spans of the rectangles crossing it; a piece with the columns of
+	// one of the band above grows down instead of starting a new one
+	vector<RoiRect> active;
+	vector<pair<int, int> > spans;
+	vector<size_t> open, grown;				// pieces ending at the current band, by column
+	size_t next = 0;
+	for (size_t b = 0; b + 1 < edges.size(); b++) {
+		int y0 = edges[b], y1 = edges[b + 1];
+		active.erase(remove_if(active.begin(), active.end(), [&](const RoiRect &r) { return r.y1 <= y0; }), active.end());
+		while (next < sorted.size() && sorted[next].y0 <= y0) active.push_back(sorted[next++]);
+
+		spans.clear();
+		for (size_t k = 0; k < active.size(); k++) spans.push_back(make_pair(active[k].x0, active[k].x1));
+		sort(spans.begin(), spans.end());
+
+		grown.clear();
+		size_t above = 0;
+		for (size_t k = 0; k < spans.size(); ) {
+			int x0 = spans[k].first, x1 = spans[k].second;
+			for (k++; k < spans.size() && spans[k].first <= x1; k++) x1 = max(x1, spans[k].second);
+
+			while (above < open.size() && pieces[open[above]].x0 < x0) above++;
+			if (above < open.size() && pieces[open[above]].x0 == x0 && pieces[open[above]].x1 == x1 && pieces[open[above]].y1 == y0) {
+				pieces[open[above]].y1 = y1;
+				grown.push_back(open[above]);
+				continue;
+			}
+			pieces.push_back({x0, y0, x1, y1});
+			grown.push_back(pieces.size() - 1);
+		}
+		open.swap(grown);
+	}
+}
+
+void roi_reads(const RoiRect &rect, int width, int height, int radius, vector<RoiRect> &reads)
+{
+	if (roi_empty(rect)) return;
+
+	int top = rect.y0 - radius, bottom = rect.y1 + radius;
+	int left = rect.x0 - radius, right = rect.x1 + radius;
+
+	// columns before 0 are the end of the previous row, columns after width the start of the next
+	int rowsUp = left < 0 ? (-left + width - 1) / width : 0;
+	int rowsDown = right > width ? (right - width + width - 1) / width : 0;
+
+	RoiRect part;
+	if (rowsUp > 1 || rowsDown > 1) {
+		// windows wider than the image span whole rows
+		part = {0, top - rowsUp, width, bottom + rowsDown};
+		if (roi_clip(part, width, height)) reads.push_back(part);
+		return;
+	}
+
+	part = {left, top, right, bottom};
+	if (roi_clip(part, width, height)) reads.push_back(part);
+	part = {width + left, top - 1, width, bottom - 1};
+	if (rowsUp == 1 && roi_clip(part, width, height)) reads.push_back(part);
+	part = {0, top + 1, right - width, bottom + 1};
+	if (rowsDown == 1 && roi_clip(part, width, height)) reads.push_back(part);
+}
+
+RoiRect roi_bounds(const RoiRect *rects, int count)
+{
+	RoiRect bounds = {0, 0, 0, 0};
+	bool first = true;
+
+	for (int k = 0; k < count; k++) {
+		if (roi_empty(rects[k])) continue;
+		if (first) bounds = rects[k];
+		else {
+			bounds.x0 = min(bounds.x0, rects[k].x0);
+			bounds.y0 = min(bounds.y0, rects[k].y0);
+			bounds.x1 = max(bounds.x1, rects[k].x1);
+			bounds.y1 = max(bounds.y1, rects[k].y1);
+		}
+		first = false;
+	}
+	return bounds;
+}
@@ -0,0 +1,69 @@
+/*
+ * RegionOfInterest.h
+ *
+ *  Rectangles of interest: the parts of an image whose output is needed,
+ *  e.g. detected document regions. Filtering only these rectangles costs
+ *  time in proportion to their area instead of the image area. A window
+ *  reads up to its radius (FILTER_SIZE / 2 or DISTANCE) around every
+ *  pixel, so a rectangle reads a halo around itself; at the left and right
+ *  image borders the linear border handling wraps windows into the
+ *  neighbour row, which adds a strip at the other side of the image.
+ */
+
+#ifndef REGIONOFINTEREST_H_
+#define REGIONOFINTEREST_H_
+
+#include <vector>
+
+/**
+* @brief Rectangle x0..x1, y0..y1, ends exclusive.
+*/
+struct RoiRect {
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+};
+
+inline bool roi_empty(const RoiRect &rect)
+{
+	return rect.x0 >= rect.x1 || rect.y0 >= rect.y1;
+}
+
+inline long long roi_area(const RoiRect &rect)
+{
+	return roi_empty(rect) ? 0 : (long long)(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+}
+
+/**
+* @brief Parses "X,Y,WxH" or "X,Y,W,H".
+*
+* @return false for malformed text or a negative size
+*/
+bool roi_parse(const char *text, RoiRect &rect);
+
+/**
+* @brief Cuts rectangle to the image.
+*
+* @return false if nothing is left
+*/
+bool roi_clip(RoiRect &rect, int width, int height);
+
+/**
+* @brief Splits the union of rectangles into pieces that do not overlap, so
+* every pixel is computed (and written) once. Empty rectangles are dropped.
+*/
+void roi_disjoint(const RoiRect *rects, int count, std::vector<RoiRect> &pieces);
+
+/**
+* @brief Appends the rectangles of input pixels the windows of rect read,
+* radius around it plus the wrapped strips, all inside the image.
+*/
+void roi_reads(const RoiRect &rect, int width, int height, int radius, std::vector<RoiRect> &reads);
+
+/**
+* @brief Smallest rectangle holding all rectangles.
+*/
+RoiRect roi_bounds(const RoiRect *rects, int count);
+
+#endif /* REGIONOFINTEREST_H_ */
@@ -0,0 +1,193 @@
+/*
+ * Scaling.cpp
+ *
+ *  Strong and weak scaling report.
+ */
+
+#include "Scaling.h"
+#include "Benchmark.h"
+#include "EdgeFilters.h"
+#include "ImageBuffer.h"
+#include "ImageGenerator.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <tbb/global_control.h>
+#include <tbb/info.h>
+
+using namespace std;
+using namespace tbb;
+
+
+static const char *op_name(int op)
+{
+	return op == OP_PREWITT ? "prewitt" : "edge";
+}
+
+void scaling_default_config(ScalingConfig &config)
+{
+	int cores = info::default_concurrency();
+
+	config.engines = {ENGINE_PARALLEL, ENGINE_TILED, ENGINE_SIMD_TILED, ENGINE_NUMA};
+	config.ops = {OP_PREWITT, OP_EDGE};
+	config.threads.clear();
+	for (int threads = 1; threads < cores; threads *= 2) config.threads.push_back(threads);
+	config.threads.push_back(cores);
+	config.strongMegapixels = 4;
+	config.weakMegapixels = 1;
+	config.aspect = 1;
+	config.strong = true;
+	config.weak = true;
+	config.repetitions = 5;
+	config.warmup = 1;
+	config.pattern = GEN_MIXED;
+	config.seed = GEN_DEFAULT_SEED;
+}
+
+/**
+* @brief Times every engine and operator at one thread count on one image size.
+*/
+static void scaling_measure(const ScalingConfig &config, bool weak, int threads, int width, int height, vector<ScalingPoint> &points)
+{
+	vector<int> image((size_t)width * height);
+	ImageBuffer in = {}, out = {};
+	if (!image_buffer_alloc(in, width, height) || !image_buffer_alloc(out, width, height)) {
+		cout << "ERROR: cannot allocate " << width << "x" << height << " image." << endl;
+		image_buffer_free(in);
+		image_buffer_free(out);
+		return;
+	}
+	generate_image(&image[0], width, height, width, config.pattern, config.seed);
+
+	global_control threadLimit(global_control::max_allowed_parallelism, threads);
+	for (int op : config.ops) {
+		for (int engine : config.engines) {
+			BenchResult result = bench_measure(op, engine, image, in, out, config.warmup, config.repetitions, NULL);
+
+			ScalingPoint point;
+			point.op = op;
+			point.engine = engine;
+			point.weak = weak;
+			point.threads = threads;
+			point.width = width;
+			point.height = height;
+			point.medianMs = result.medianMs;
+			point.speedup = 1;
+			point.efficiency = 1;
+			point.serialFraction = 0;
+			points.push_back(point);
+		}
+	}
+
+	image_buffer_free(in);
+	image_buffer_free(out);
+}
+
+/**
+* @brief Fills speedup, efficiency and serial fraction from the 1 thread point
+* of the same engine, operator and kind.
+*/
+static void scaling_derive(ScalingPoint &point, const vector<ScalingPoint> &points)
+{
+	const ScalingPoint *base = NULL;
+	for (const ScalingPoint &p : points) {
+		if (p.threads == 1 && p.op == point.op && p.engine == point.engine && p.weak == point.weak) base = &p;
+	}
+	if (base == NULL || point.medianMs <= 0) return;
+
+	double p = point.threads;
+	double ratio = base->medianMs / point.medianMs;
+	point.speedup = point.weak ? p * ratio : ratio;
+	point.efficiency = point.speedup / p;
+	if (point.threads == 1) point.serialFraction = 0;
+	else if (point.weak) point.serialFraction = (p - point.speedup) / (p - 1);
+	else point.serialFraction = (1 / point.speedup - 1 / p) / (1 - 1 / p);
+}
+
+static void scaling_print_point(const ScalingPoint &point)
+{
+	cout << (point.weak ? "weak   " : "strong ") << op_name(point.op) << " " << engine_name(point.engine);
+	cout << " threads=" << point.threads << " " << point.width << "x" << point.height;
+	cout << ": " << point.medianMs << " ms, speedup " << point.speedup << ", efficiency " << point.efficiency * 100 << " %";
+	if (point.threads > 1) cout << ", serial fraction " << point.serialFraction;
+	if (point.threads > info::default_concurrency()) cout << " (more threads than cores)";
+	cout << endl;
+}
+
+void scaling_run(const ScalingConfig &config, vector<ScalingPoint> &points)
+{
+	vector<int> threadCounts(1, 1);
+	for (int threads : config.threads) {
+		if (threads > 1 && find(threadCounts.begin(), threadCounts.end(), threads) == threadCounts.end()) threadCounts.push_back(threads);
+	}
+	sort(threadCounts.begin(), threadCounts.end());
+
+	size_t first = points.size();
+	for (int kind = 0; kind < 2; kind++) {
+		bool weak = kind == 1;
+		if (weak ? !config.weak : !config.strong) continue;
+
+		// weak scaling keeps the width and stacks rows, so every thread gets the same band shape
+		double pixels = (weak ? config.weakMegapixels : config.strongMegapixels) * 1e6;
+		int height = max(1, (int)lround(sqrt(pixels / config.aspect)));
+		int width = max(1, (int)lround(pixels / height));
+
+		for (int threads : threadCounts) {
+			scaling_measure(config, weak, threads, width, weak ? height * threads : height, points);
+		}
+	}
+
+	for (size_t k = first; k < points.size(); k++) {
+		scaling_derive(points[k], points);
+		scaling_print_point(points[k]);
+	}
+}
+
+void scaling_print_summary(const vector<ScalingPoint> &points)
+{
+	cout << endl << "Serial fraction by thread count (flat: serial code, rising: parallel overhead):" << endl;
+
+	for (size_t k = 0; k < points.size(); k++) {
+		const ScalingPoint &head = points[k];
+		if (head.threads != 1) continue;
+
+		double sum = 0;
+		int count = 0;
+		cout << (head.weak ? "weak   " : "strong ") << op_name(head.op) << " " << engine_name(head.engine) << ":";
+		for (const ScalingPoint &p : points) {
+			if (p.threads == 1 || p.op != head.op || p.engine != head.engine || p.weak != head.weak) continue;
+			cout << " " << p.threads << ": " << p.serialFraction;
+			sum += p.serialFraction;
+			count++;
+		}
+
+		if (count == 0) {
+			cout << " (1 thread only)" << endl;
+			continue;
+		}
+		double fraction = sum / count;
+		cout << "  mean " << fraction;
+		if (fraction > 0 && fraction < 1) cout << ", Amdahl limit " << 1 / fraction << "x";
+		cout << endl;
+	}
+}
+
+#define SCALING_CSV_HEADER	"kind,op,engine,threads,width,height,median_ms,speedup,efficiency,serial_fraction"
+
+bool scaling_write_csv(const char *path, const vector<ScalingPoint> &points)
+{
+	ofstream out(path);
+	if (!out) {
+		cout << "ERROR: cannot write " << path << endl;
+		return false;
+	}
+
+	out << SCALING_CSV_HEADER << endl;
+	for (const ScalingPoint &p : points) {
+		out << (p.weak ? "weak" : "strong") << ',' << op_name(p.op) << ',' << engine_name(p.engine) << ',';
+		out << p.threads << ',' << p.width << ',' << p.height << ',' << p.medianMs << ',';
+		out << p.speedup << ',' << p.efficiency << ',' << p.serialFraction << endl;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * Scaling.h
+ *
+ *  Strong and weak scaling report for the parallel engines. Each engine
+ *  runs at every thread count of the sweep under tbb::global_control:
+ *
+ *    strong: the same image at every thread count, speedup S = T1 / Tp,
+ *            efficiency S / p, serial fraction (Karp-Flatt)
+ *            e = (1/S - 1/p) / (1 - 1/p)
+ *    weak:   p times the pixels of the 1 thread image (height grows, width
+ *            stays), scaled speedup S = p * T1 / Tp, efficiency T1 / Tp,
+ *            serial fraction (Gustafson) e = (p - S) / (p - 1)
+ *
+ *  A serial fraction that stays flat as p grows points at code that does
+ *  not run in parallel at all (e.g. a single threaded threshold pass); one
+ *  that grows with p points at overheads (scheduling, bandwidth, imbalance).
+ */
+
+#ifndef SCALING_H_
+#define SCALING_H_
+
+#include <vector>
+
+struct ScalingConfig {
+	std::vector<int> engines;
+	std::vector<int> ops;
+	std::vector<int> threads;			// thread counts, 1 is always measured first
+	double strongMegapixels;			// image size of strong scaling
+	double weakMegapixels;				// image size per thread of weak scaling
+	double aspect;						// width / height of strong and 1 thread images
+	bool strong;
+	bool weak;
+	int repetitions;
+	int warmup;
+	int pattern;						// GEN_* image pattern
+	unsigned long long seed;
+};
+
+struct ScalingPoint {
+	int op;
+	int engine;
+	bool weak;
+	int threads;
+	int width;
+	int height;
+	double medianMs;
+	double speedup;
+	double efficiency;
+	double serialFraction;				// 0 at 1 thread
+};
+
+/**
+* @brief Engines parallel, tiled, simd-tiled and numa, both operators, threads
+* 1, 2, 4, ... up to the number of cores, 4 MP strong and 1 MP per thread weak.
+*/
+void scaling_default_config(ScalingConfig &config);
+
+/**
+* @brief Runs the sweep, printing one line per point.
+*/
+void scaling_run(const ScalingConfig &config, std::vector<ScalingPoint> &points);
+
+/**
+* @brief Prints per engine and operator the serial fraction estimates and
+* the speedup Amdahl's law allows with their mean.
+*/
+void scaling_print_summary(const std::vector<ScalingPoint> &points);
+
+bool scaling_write_csv(const char *path, const std::vector<ScalingPoint> &points);
+
+#endif /* SCALING_H_ */
@@ -0,0 +1,629 @@
+/*
+ * SequenceProcessor.cpp
+ *
+ *  Sequence mode: frames of a video or image sequence filtered in a pipeline.
+ */
+
+#include "SequenceProcessor.h"
+#include "BitmapRawConverter.h"
+#include "BmpDecoder.h"
+#include "EdgeFilters.h"
+#include "EdgeEngine.h"
+#include "IncrementalFilter.h"
+#include "ImageGenerator.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/tick_count.h>
+
+using namespace std;
+using namespace tbb;
+namespace fs = std::filesystem;
+
+#define SEQUENCE_FRAMES				0		// image files of a directory
+#define SEQUENCE_Y4M				1
+#define SEQUENCE_RAW				2		// 8 bit luma planes, back to back
+#define SEQUENCE_GENERATED			3
+#define SEQUENCE_NONE				4		// output only, frames are discarded
+
+#define SEQUENCE_GENERATED_FRAMES	100
+#define SEQUENCE_MAX_LINE			4096	// Y4M header and frame lines
+#define SEQUENCE_DEFAULT_RATE		"F25:1"
+
+struct SequenceSource {
+	int format;
+	FILE *file;
+	vector<string> names;
+	size_t next;
+	int width;
+	int height;
+	size_t frameBytes;				// luma and chroma planes of one Y4M or raw frame
+	string rate;					// Y4M frame rate field
+	int pattern;
+	unsigned long long seed;
+	int remaining;					// frames left to read, -1 for all
+	bool truncated;
+};
+
+struct SequenceSink {
+	int format;
+	FILE *file;
+	string directory;
+	string suffix;
+	string rate;
+	int width;						// frame size of a Y4M or raw stream, 0 until the first frame
+	int height;
+};
+
+/**
+* @brief One pipeline token. Tokens are reused round robin, frame k takes slot
+* k % tokens, which is free since frames leave the pipeline in order.
+*/
+struct SequenceFrame {
+	int index;
+	bool ok;
+	string name;					// input file of a frame directory
+	vector<unsigned char> bytes;	// frame as read, later as encoded for writing
+	int width;
+	int height;
+	int *in;
+	int *out;
+	tick_count start;
+	SequenceFrameTimes times;
+};
+
+
+static bool has_frame_extension(const fs::path &path)
+{
+	string ext = path.extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".bmp" || ext == ".qog";
+}
+
+static bool has_extension(const string &name, const char *ext)
+{
+	string own = fs::path(name).extension().string();
+	transform(own.begin(), own.end(), own.begin(), ::tolower);
+	return own == ext;
+}
+
+/**
+* @brief Name order with digit runs compared as numbers, frame2 before frame10.
+*/
+static bool natural_less(const string &a, const string &b)
+{
+	size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size()) {
+		if (!isdigit((unsigned char)a[i]) || !isdigit((unsigned char)b[j])) {
+			if (a[i] != b[j]) return a[i] < b[j];
+			i++;
+			j++;
+			continue;
+		}
+
+		size_t endA = i, endB = j;
+		while (endA < a.size() && isdigit((unsigned char)a[endA])) endA++;
+		while (endB < b.size() && isdigit((unsigned char)b[endB])) endB++;
+		while (i + 1 < endA && a[i] == '0') i++;
+		while (j + 1 < endB && b[j] == '0') j++;
+		if (endA - i != endB - j) return endA - i < endB - j;
+		int order = a.compare(i, endA - i, b, j, endB - j);
+		if (order != 0) return order < 0;
+		i = endA;
+		j = endB;
+	}
+	return a.size() - i < b.size() - j;
+}
+
+static bool read_line(FILE *file, string &line)
+{
+	line.clear();
+	int c;
+	while ((c = getc(file)) != EOF && c != '\n') {
+		if (line.size() >= SEQUENCE_MAX_LINE) return false;
+		line += (char)c;
+	}
+	return c == '\n';
+}
+
+/**
+* @brief Reads "YUV4MPEG2 W.. H.. F.. C.." and the size of a frame from it.
+* Only 8 bit samples are accepted.
+*/
+static bool y4m_parse_header(const string &line, SequenceSource &source)
+{
+	istringstream fields(line);
+	string field, chroma = "420";
+	if (!(fields >> field) || field != "YUV4MPEG2") return false;
+
+	source.width = source.height = 0;
+	source.rate = SEQUENCE_DEFAULT_RATE;
+	while (fields >> field) {
+		if (field[0] == 'W') source.width = atoi(field.c_str() + 1);
+		else if (field[0] == 'H') source.height = atoi(field.c_str() + 1);
+		else if (field[0] == 'F') source.rate = field;
+		else if (field[0] == 'C') chroma = field.substr(1);
+	}
+	if (source.width <= 0 || source.height <= 0) return false;
+
+	// high bit depth tags end in p10, p12, p16
+	size_t depth = chroma.find('p');
+	if (depth != string::npos && depth + 1 < chroma.size() && isdigit((unsigned char)chroma[depth + 1])) return false;
+
+	size_t luma = (size_t)source.width * source.height;
+	size_t halfWidth = (source.width + 1) / 2, halfHeight = (source.height + 1) / 2;
+	size_t chromaBytes;
+	if (chroma.compare(0, 3, "420") == 0) chromaBytes = 2 * halfWidth * halfHeight;
+	else if (chroma == "422") chromaBytes = 2 * halfWidth * source.height;
+	else if (chroma == "411") chromaBytes = 2 * ((source.width + 3) / 4) * (size_t)source.height;
+	else if (chroma == "444") chromaBytes = 2 * luma;
+	else if (chroma == "444alpha") chromaBytes = 3 * luma;
+	else if (chroma == "mono") chromaBytes = 0;
+	else return false;
+
+	source.frameBytes = luma + chromaBytes;
+	return true;
+}
+
+static bool open_source(const SequenceOptions &options, SequenceSource &source)
+{
+	source.file = NULL;
+	source.next = 0;
+	source.remaining = options.frames > 0 ? options.frames : -1;
+	source.truncated = false;
+	source.rate = SEQUENCE_DEFAULT_RATE;
+
+	if (generator_parse_spec(options.input.c_str(), &source.pattern, &source.width, &source.height, &source.seed)) {
+		source.format = SEQUENCE_GENERATED;
+		if (source.remaining < 0) source.remaining = SEQUENCE_GENERATED_FRAMES;
+		return true;
+	}
+
+	error_code ec;
+	if (fs::is_directory(options.input, ec)) {
+		source.format = SEQUENCE_FRAMES;
+		for (fs::directory_iterator it(options.input, ec), end; !ec && it != end; it.increment(ec)) {
+			if (it->is_regular_file() && has_frame_extension(it->path())) source.names.push_back(it->path().string());
+		}
+		sort(source.names.begin(), source.names.end(), natural_less);
+		if (source.names.empty()) cerr << "ERROR: no .bmp or .qog frames in " << options.input << endl;
+		return !ec && !source.names.empty();
+	}
+
+	source.file = options.input == "-" ? stdin : fopen(options.input.c_str(), "rb");
+	if (source.file == NULL) {
+		cerr << "ERROR: cannot open sequence input " << options.input << endl;
+		return false;
+	}
+
+	// raw luma has no header, its size comes from -size
+	if (options.width > 0 && options.height > 0) {
+		source.format = SEQUENCE_RAW;
+		source.width = options.width;
+		source.height = options.height;
+		source.frameBytes = (size_t)options.width * options.height;
+		return true;
+	}
+
+	string line;
+	source.format = SEQUENCE_Y4M;
+	if (!read_line(source.file, line) || !y4m_parse_header(line, source)) {
+		cerr << "ERROR: " << options.input << " is not an 8 bit Y4M stream (raw luma needs -size WxH)" << endl;
+		if (source.file != stdin) fclose(source.file);
+		return false;
+	}
+	return true;
+}
+
+static bool open_sink(const SequenceOptions &options, const SequenceSource &source, SequenceSink &sink)
+{
+	sink.file = NULL;
+	sink.rate = source.rate;
+	sink.width = sink.height = 0;
+	sink.suffix = options.op == OP_PREWITT ? "_prewitt" : "_edge";
+
+	if (options.output.empty()) {
+		sink.format = SEQUENCE_NONE;
+		return true;
+	}
+
+	bool y4m = options.output == "-" || has_extension(options.output, ".y4m");
+	bool raw = has_extension(options.output, ".raw") || has_extension(options.output, ".gray") || has_extension(options.output, ".y");
+	if (y4m || raw) {
+		sink.format = y4m ? SEQUENCE_Y4M : SEQUENCE_RAW;
+		sink.file = options.output == "-" ? stdout : fopen(options.output.c_str(), "wb");
+		if (sink.file == NULL) cerr << "ERROR: cannot open sequence output " << options.output << endl;
+		return sink.file != NULL;
+	}
+
+	error_code ec;
+	sink.format = SEQUENCE_FRAMES;
+	sink.directory = options.output;
+	fs::create_directories(sink.directory, ec);
+	if (!fs::is_directory(sink.directory, ec)) {
+		cerr << "ERROR: cannot create output directory " << sink.directory << endl;
+		return false;
+	}
+	return true;
+}
+
+/**
+* @brief Takes the next frame off the input, serially and in order.
+*
+* @return false at the end of the input
+*/
+static bool read_frame(SequenceSource &source, SequenceFrame &frame)
+{
+	TRACE_SCOPE("read frame", TRACE_STAGE);
+	if (source.remaining == 0) return false;
+
+	if (source.format == SEQUENCE_FRAMES) {
+		if (source.next >= source.names.size()) return false;
+		frame.name = source.names[source.next++];
+	}
+	else if (source.format == SEQUENCE_GENERATED) {
+		frame.width = source.width;
+		frame.height = source.height;
+	}
+	else {
+		string line;
+		if (source.format == SEQUENCE_Y4M) {
+			if (!read_line(source.file, line)) {
+				source.truncated = !line.empty();
+				return false;
+			}
+			if (line.compare(0, 5, "FRAME") != 0) {
+				source.truncated = true;
+				return false;
+			}
+		}
+
+		frame.bytes.resize(source.frameBytes);
+		size_t got = fread(&frame.bytes[0], 1, source.frameBytes, source.file);
+		if (got != source.frameBytes) {
+			source.truncated = got > 0 || source.format == SEQUENCE_Y4M;
+			return false;
+		}
+		frame.width = source.width;
+		frame.height = source.height;
+	}
+
+	if (source.remaining > 0) source.remaining--;
+	return true;
+}
+
+/**
+* @brief Converts the frame to gray ints; runs in parallel with other frames.
+*/
+static void decode_frame(const SequenceSource &source, SequenceFrame &frame)
+{
+	TRACE_SCOPE("decode", TRACE_STAGE);
+
+	if (source.format == SEQUENCE_FRAMES) {
+		if (bmp_decode_gray(frame.name.c_str(), &frame.in, &frame.width, &frame.height)) return;
+
+		// QOG frames and bitmaps the direct decoder leaves to EasyBMP
+		BitmapRawConverter image((char *)frame.name.c_str());
+		frame.width = image.getWidth();
+		frame.height = image.getHeight();
+		if (!image.isLoaded() || frame.width <= 0 || frame.height <= 0) {
+			frame.ok = false;
+			return;
+		}
+		frame.in = pool_alloc_image(frame.width, frame.height);
+		memcpy(frame.in, image.getBuffer(), (size_t)frame.width * frame.height * sizeof(int));
+		return;
+	}
+
+	frame.in = pool_alloc_image(frame.width, frame.height);
+	if (source.format == SEQUENCE_GENERATED) {
+		generate_image(frame.in, frame.width, frame.height, frame.width, source.pattern, source.seed + frame.index);
+		return;
+	}
+
+	// luma is the first plane of a Y4M frame
+	int width = frame.width;
+	const unsigned char *luma = &frame.bytes[0];
+	int *in = frame.in;
+	parallel_for(blocked_range<int>(0, frame.height), [=](const blocked_range<int> &r) {
+		for (int y = r.begin(); y != r.end(); y++) bmp_gray_row(luma + (size_t)y * width, in + (size_t)y * width, width, 1, width);
+	});
+}
+
+static void filter_frame(EdgeEngine &engine, IncrementalFilter *incremental, int op, SequenceFrame &frame, long long &dirtyTiles, long long &tiles)
+{
+	TRACE_SCOPE("filter", TRACE_STAGE);
+	int width = frame.width, height = frame.height;
+
+	frame.out = engine.acquire(width, height);
+	ImageView<const int> in(frame.in, width, height);
+	if (incremental == NULL) engine.run(op, in, ImageView<int>(frame.out, width, height));
+	else {
+		// the result of the filter is overwritten by the next frame, keep a copy
+		ImageView<const int> result = incremental->run(op, in, THRESHOLD);
+		if (result.data == NULL) frame.ok = false;
+		else {
+			int *out = frame.out;
+			parallel_for(blocked_range<int>(0, height), [=](const blocked_range<int> &r) {
+				for (int y = r.begin(); y != r.end(); y++) memcpy(out + (size_t)y * width, result.row(y), width * sizeof(int));
+			});
+			dirtyTiles += incremental->dirtyTiles();
+			tiles += incremental->tileCount();
+		}
+	}
+
+	pool_free_image(frame.in, width, height);
+	frame.in = NULL;
+}
+
+static void put_le(unsigned char *at, unsigned int value, int bytes)
+{
+	for (int k = 0; k < bytes; k++) at[k] = (unsigned char)(value >> (8 * k));
+}
+
+/**
+* @brief Encodes the output as a gray 24 bit BMP, byte for byte what
+* BitmapRawConverter::pixelsToBitmap writes.
+*/
+static void encode_bmp(const int *pixels, int width, int height, vector<unsigned char> &file)
+{
+	size_t rowBytes = ((size_t)3 * width + 3) & ~(size_t)3;
+	size_t imageBytes = rowBytes * height;
+	file.assign(54, 0);
+	file.resize(54 + imageBytes);
+
+	unsigned char *header = &file[0];
+	header[0] = 'B';
+	header[1] = 'M';
+	put_le(header + 2, (unsigned int)(54 + imageBytes), 4);
+	put_le(header + 10, 54, 4);
+	put_le(header + 14, 40, 4);
+	put_le(header + 18, width, 4);
+	put_le(header + 22, height, 4);
+	put_le(header + 26, 1, 2);
+	put_le(header + 28, 24, 2);
+	put_le(header + 34, (unsigned int)imageBytes, 4);
+	put_le(header + 38, DefaultXPelsPerMeter, 4);
+	put_le(header + 42, DefaultYPelsPerMeter, 4);
+
+	// rows are stored bottom up, padding stays zero
+	unsigned char *rows = &file[54];
+	parallel_for(blocked_range<int>(0, height), [=](const blocked_range<int> &r) {
+		for (int y = r.begin(); y != r.end(); y++) {
+			const int *src = pixels + (size_t)y * width;
+			unsigned char *dst = rows + (size_t)(height - 1 - y) * rowBytes;
+			for (int x = 0; x < width; x++) dst[3 * x] = dst[3 * x + 1] = dst[3 * x + 2] = (unsigned char)src[x];
+		}
+	});
+}
+
+/**
+* @brief Packs the output for writing; runs in parallel with other frames.
+*/
+static void encode_frame(EdgeEngine &engine, const SequenceSink &sink, SequenceFrame &frame)
+{
+	TRACE_SCOPE("encode", TRACE_STAGE);
+	int width = frame.width, height = frame.height;
+
+	if (frame.ok && sink.format == SEQUENCE_FRAMES) encode_bmp(frame.out, width, height, frame.bytes);
+	else if (frame.ok && sink.format != SEQUENCE_NONE) {
+		frame.bytes.resize((size_t)width * height);
+		const int *out = frame.out;
+		unsigned char *dst = &frame.bytes[0];
+		parallel_for(blocked_range<int>(0, height), [=](const blocked_range<int> &r) {
+			for (size_t k = (size_t)r.begin() * width; k < (size_t)r.end() * width; k++) dst[k] = (unsigned char)out[k];
+		});
+	}
+
+	engine.release(frame.out, width, height);
+	frame.out = NULL;
+}
+
+/**
+* @brief Writes the encoded frame, serially and in order.
+*/
+static bool write_frame(SequenceSink &sink, const SequenceSource &source, const SequenceFrame &frame)
+{
+	TRACE_SCOPE("write frame", TRACE_STAGE);
+
+	if (sink.format == SEQUENCE_NONE) return true;
+
+	if (sink.format == SEQUENCE_FRAMES) {
+		string name;
+		if (source.format == SEQUENCE_FRAMES) name = fs::path(frame.name).stem().string() + sink.suffix + ".bmp";
+		else {
+			char number[32];
+			snprintf(number, sizeof(number), "frame%06d", frame.index);
+			name = number + sink.suffix + ".bmp";
+		}
+
+		FILE *file = fopen((fs::path(sink.directory) / name).string().c_str(), "wb");
+		if (file == NULL) return false;
+		bool ok = fwrite(&frame.bytes[0], 1, frame.bytes.size(), file) == frame.bytes.size();
+		return fclose(file) == 0 && ok;
+	}
+
+	// a stream holds frames of one size
+	if (sink.width == 0) {
+		sink.width = frame.width;
+		sink.height = frame.height;
+		if (sink.format == SEQUENCE_Y4M) fprintf(sink.file, "YUV4MPEG2 W%d H%d %s Ip A1:1 Cmono\n", sink.width, sink.height, sink.rate.c_str());
+	}
+	if (frame.width != sink.width || frame.height != sink.height) return false;
+
+	if (sink.format == SEQUENCE_Y4M) fputs("FRAME\n", sink.file);
+	return fwrite(&frame.bytes[0], 1, frame.bytes.size(), sink.file) == frame.bytes.size();
+}
+
+void sequence_default_options(SequenceOptions &options)
+{
+	options.op = OP_PREWITT;
+	options.width = 0;
+	options.height = 0;
+	options.frames = 0;
+	options.tokens = SEQUENCE_DEFAULT_TOKENS;
+	options.incremental = false;
+}
+
+bool sequence_run(const SequenceOptions &options, SequenceReport &report)
+{
+	report.frames = 0;
+	report.failed = 0;
+	report.width = report.height = 0;
+	report.megapixels = 0;
+	report.seconds = report.steadySeconds = 0;
+	report.dirtyTiles = report.tiles = 0;
+	report.times.clear();
+
+	SequenceSource source;
+	SequenceSink sink;
+	if (!open_source(options, source)) return false;
+	if (!open_sink(options, source, sink)) {
+		if (source.file != NULL && source.file != stdin) fclose(source.file);
+		return false;
+	}
+
+	EdgeEngine engine;
+	IncrementalFilter *incremental = options.incremental ? new IncrementalFilter(engine) : NULL;
+	vector<SequenceFrame> slots(max(1, options.tokens));
+	int next = 0;
+	bool writeFailed = false;
+	tick_count startCount = tick_count::now(), firstWritten = startCount, lastWritten = startCount;
+
+	parallel_pipeline(slots.size(),
+		make_filter<void, SequenceFrame *>(filter_mode::serial_in_order, [&](flow_control &fc) -> SequenceFrame * {
+			SequenceFrame &frame = slots[next % slots.size()];
+			frame.start = tick_count::now();
+			frame.index = next;
+			frame.ok = true;
+			frame.in = frame.out = NULL;
+			if (!read_frame(source, frame)) {
+				fc.stop();
+				return NULL;
+			}
+			frame.times.decodeMs = (tick_count::now() - frame.start).seconds() * 1000;
+			next++;
+			return &frame;
+		}) &
+		make_filter<SequenceFrame *, SequenceFrame *>(filter_mode::parallel, [&](SequenceFrame *frame) {
+			tick_count decodeStart = tick_count::now();
+			decode_frame(source, *frame);
+			frame->times.decodeMs += (tick_count::now() - decodeStart).seconds() * 1000;
+			return frame;
+		}) &
+		// an incremental filter compares each frame with the one before, in order
+		make_filter<SequenceFrame *, SequenceFrame *>(incremental ? filter_mode::serial_in_order : filter_mode::parallel, [&](SequenceFrame *frame) {
+			tick_count filterStart = tick_count::now();
+			if (frame->ok) filter_frame(engine, incremental, options.op, *frame, report.dirtyTiles, report.tiles);
+			frame->times.filterMs = (tick_count::now() - filterStart).seconds() * 1000;
+			return frame;
+		}) &
+		make_filter<SequenceFrame *, SequenceFrame *>(filter_mode::parallel, [&](SequenceFrame *frame) {
+			tick_count encodeStart = tick_count::now();
+			if (frame->out != NULL) encode_frame(engine, sink, *frame);
+			frame->times.encodeMs = (tick_count::now() - encodeStart).seconds() * 1000;
+			return frame;
+		}) &
+		make_filter<SequenceFrame *, void>(filter_mode::serial_in_order, [&](SequenceFrame *frame) {
+			tick_count writeStart = tick_count::now();
+			if (frame->in != NULL) pool_free_image(frame->in, frame->width, frame->height);
+			if (frame->ok && !write_frame(sink, source, *frame)) {
+				frame->ok = false;
+				writeFailed = true;
+			}
+
+			lastWritten = tick_count::now();
+			if (report.frames + report.failed == 0) firstWritten = lastWritten;
+			frame->times.encodeMs += (lastWritten - writeStart).seconds() * 1000;
+			frame->times.latencyMs = (lastWritten - frame->start).seconds() * 1000;
+
+			if (!frame->ok) {
+				report.failed++;
+				return;
+			}
+			report.frames++;
+			report.width = frame->width;
+			report.height = frame->height;
+			report.megapixels += (double)frame->width * frame->height / 1e6;
+			report.times.push_back(frame->times);
+		})
+	);
+
+	report.seconds = (tick_count::now() - startCount).seconds();
+	report.steadySeconds = (lastWritten - firstWritten).seconds();
+
+	delete incremental;
+	if (source.file != NULL && source.file != stdin) fclose(source.file);
+	if (sink.file != NULL) {
+		if (fflush(sink.file) != 0) writeFailed = true;
+		if (sink.file != stdout && fclose(sink.file) != 0) writeFailed = true;
+	}
+
+	if (source.truncated) cerr << "ERROR: input ends inside frame " << next << endl;
+	if (writeFailed) cerr << "ERROR: cannot write every frame to " << options.output << endl;
+	return !source.truncated && !writeFailed && report.failed == 0;
+}
+
+static double percentile(vector<double> values, double fraction)
+{
+	if (values.empty()) return 0;
+	sort(values.begin(), values.end());
+	return values[min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+void sequence_print_report(const SequenceReport &report, ostream &out)
+{
+	double seconds = report.seconds > 0 ? report.seconds : 1e-9;
+	vector<double> latency;
+	double decode = 0, filter = 0, encode = 0;
+	for (size_t k = 0; k < report.times.size(); k++) {
+		latency.push_back(report.times[k].latencyMs);
+		decode += report.times[k].decodeMs;
+		filter += report.times[k].filterMs;
+		encode += report.times[k].encodeMs;
+	}
+	double frames = report.times.empty() ? 1 : report.times.size();
+
+	out << "Sequence: " << report.frames << " frames of " << report.width << "x" << report.height;
+	if (report.failed) out << " (" << report.failed << " failed)";
+	out << ", " << report.megapixels << " MP in " << report.seconds * 1000 << " ms." << endl;
+
+	out << "Throughput: " << report.frames / seconds << " fps";
+	// the first frame fills the pipeline, from then on one frame leaves per period
+	if (report.frames > 1 && report.steadySeconds > 0) out << ", sustained " << (report.frames - 1) / report.steadySeconds << " fps";
+	out << ", " << report.megapixels / seconds << " MP/s." << endl;
+
+	out << "Latency: median " << percentile(latency, 0.5) << " ms, p95 " << percentile(latency, 0.95) << " ms, max "
+		<< percentile(latency, 1) << " ms." << endl;
+	out << "Per frame: read+decode " << decode / frames << " ms, filter " << filter / frames << " ms, encode+write "
+		<< encode / frames << " ms." << endl;
+
+	if (report.tiles > 0) {
+		out << "Incremental: " << report.dirtyTiles << " of " << report.tiles << " tiles changed ("
+			<< 100.0 * report.dirtyTiles / report.tiles << " %)." << endl;
+	}
+}
+
+bool sequence_write_times(const SequenceReport &report, const char *filename)
+{
+	ofstream out(filename);
+	if (!out) return false;
+
+	out << "frame,decode_ms,filter_ms,encode_ms,latency_ms" << endl;
+	for (size_t k = 0; k < report.times.size(); k++) {
+		const SequenceFrameTimes &t = report.times[k];
+		out << k << ',' << t.decodeMs << ',' << t.filterMs << ',' << t.encodeMs << ',' << t.latencyMs << endl;
+	}
+	return (bool)out;
+}
@@ -0,0 +1,83 @@
+/*
+ * SequenceProcessor.h
+ *
+ *  Sequence mode: the frames of a video or numbered image sequence are
+ *  filtered in order. Frames flow through a tbb::parallel_pipeline of
+ *  read, decode, filter, encode and write stages, so reading frame N + 2,
+ *  filtering N + 1 and writing N overlap, while every frame is still
+ *  filtered tile by tile. The token count bounds the frames held in memory.
+ *
+ *  Inputs: a directory of BMP / QOG frames (in natural name order,
+ *  frame2 before frame10), a Y4M file, raw 8 bit luma planes or a pipe
+ *  (- for stdin, Y4M or raw), or a generator spec with a frame count.
+ *  Only luma (Y) is filtered, chroma planes are skipped.
+ */
+
+#ifndef SEQUENCEPROCESSOR_H_
+#define SEQUENCEPROCESSOR_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#define SEQUENCE_DEFAULT_TOKENS		4		// read, filter, encode and write of four frames overlap
+
+struct SequenceOptions {
+	std::string input;				// frame directory, .y4m or raw file, - for stdin, or generator spec
+	std::string output;				// frame directory (BMP), .y4m or raw file, - for stdout (Y4M), empty discards
+	int op;
+	int width;						// frame size of raw input
+	int height;
+	int frames;						// frames of a generator, otherwise at most this many, 0 for all
+	int tokens;						// frames in flight
+	bool incremental;				// recompute only tiles changed since the previous frame
+};
+
+/**
+* @brief Times of one frame in ms. Latency runs from the start of its read to
+* the end of its write, including the waits between stages.
+*/
+struct SequenceFrameTimes {
+	double decodeMs;				// read and decode
+	double filterMs;
+	double encodeMs;				// encode and write
+	double latencyMs;
+};
+
+struct SequenceReport {
+	int frames;
+	int failed;
+	int width;						// size of the last frame
+	int height;
+	double megapixels;
+	double seconds;					// whole pipeline
+	double steadySeconds;			// from the first frame written to the last
+	long long dirtyTiles;			// incremental mode only
+	long long tiles;
+	std::vector<SequenceFrameTimes> times;
+};
+
+/**
+* @brief Fills options with default values.
+*/
+void sequence_default_options(SequenceOptions &options);
+
+/**
+* @brief Filters every frame of options.input and fills the report.
+*
+* @return false if input or output cannot be opened (nothing is run) or a
+* frame could not be read or written
+*/
+bool sequence_run(const SequenceOptions &options, SequenceReport &report);
+
+/**
+* @brief Prints frame rate and latency percentiles of a sequence run.
+*/
+void sequence_print_report(const SequenceReport &report, std::ostream &out);
+
+/**
+* @brief Writes per frame times as CSV.
+*/
+bool sequence_write_times(const SequenceReport &report, const char *filename);
+
+#endif /* SEQUENCEPROCESSOR_H_ */
@@ -0,0 +1,242 @@
+/*
+ * ShadowVerify.cpp
+ *
+ *  Sampled background re-check of filter output against the serial arithmetic.
+ */
+
+#include "ShadowVerify.h"
+#include "EdgeFilters.h"
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+#define SHADOW_MAX_REPORTS		10		// mismatches printed, later ones are only counted
+
+double SHADOW_FRACTION = 0;
+
+using namespace std;
+
+struct ShadowTile {
+	int y0;
+	int y1;
+	int bandY0;							// image row of band[0]
+	vector<int> band;					// input rows the windows of the tile read
+	vector<int> produced;				// filter output of rows y0..y1
+};
+
+struct ShadowSample {
+	int op;
+	int engine;
+	int width;
+	int height;
+	int filterSize;
+	int threshold;
+	int distance;
+	vector<ShadowTile> tiles;
+};
+
+static mutex queueMutex;
+static condition_variable queueChanged;
+static deque<ShadowSample *> queue;
+static bool checking = false;
+static bool stopping = false;
+static thread *checker = NULL;
+static ShadowStats stats = {0, 0, 0, 0, 0, 0};
+static int reports = 0;
+static atomic<unsigned long long> sampleCounter(0);
+
+
+/**
+* @brief splitmix64 step, one random stream per captured image
+*/
+static inline unsigned long long next_random(unsigned long long &state)
+{
+	unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+ShadowSample *shadow_capture(int op, int engine, const int *inBuffer, int width, int height, int stride)
+{
+	if (SHADOW_FRACTION <= 0 || checker == NULL) return NULL;
+
+	int radius = op == OP_PREWITT ? (FILTER_SIZE - 1) / 2 : DISTANCE;
+	unsigned long long state = ++sampleCounter * 0xd1b54a32d192ed03ULL;
+	ShadowSample *sample = NULL;
+
+	for (int y0 = 0; y0 < height; y0 += SHADOW_ROWS) {
+		if ((next_random(state) >> 11) * (1.0 / 9007199254740992.0) >= SHADOW_FRACTION) continue;
+
+		if (sample == NULL) {
+			sample = new ShadowSample;
+			sample->op = op;
+			sample->engine = engine;
+			sample->width = width;
+			sample->height = height;
+			sample->filterSize = FILTER_SIZE;
+			sample->threshold = THRESHOLD;
+			sample->distance = DISTANCE;
+		}
+
+		// windows wrap into neighbour rows through linear indices, take every row they can reach
+		ShadowTile tile;
+		tile.y0 = y0;
+		tile.y1 = min(height, y0 + SHADOW_ROWS);
+		long long first = max(0LL, (long long)(tile.y0 - radius) * width - radius);
+		long long last = min((long long)width * height - 1, (long long)(tile.y1 - 1 + radius) * width + width - 1 + radius);
+		tile.bandY0 = (int)(first / width);
+		int bandY1 = (int)(last / width) + 1;
+
+		tile.band.resize((size_t)(bandY1 - tile.bandY0) * width);
+		for (int j = tile.bandY0; j < bandY1; j++) {
+			memcpy(&tile.band[(size_t)(j - tile.bandY0) * width], inBuffer + (size_t)j * stride, width * sizeof(int));
+		}
+		sample->tiles.push_back(tile);
+	}
+	return sample;
+}
+
+void shadow_submit(ShadowSample *sample, const int *outBuffer, int outStride)
+{
+	if (sample == NULL) return;
+
+	for (ShadowTile &tile : sample->tiles) {
+		tile.produced.resize((size_t)(tile.y1 - tile.y0) * sample->width);
+		for (int j = tile.y0; j < tile.y1; j++) {
+			memcpy(&tile.produced[(size_t)(j - tile.y0) * sample->width], outBuffer + (size_t)j * outStride, sample->width * sizeof(int));
+		}
+	}
+
+	lock_guard<mutex> lock(queueMutex);
+	if (queue.size() >= SHADOW_QUEUE_LIMIT) {
+		stats.tilesDropped += sample->tiles.size();
+		delete sample;
+		return;
+	}
+	queue.push_back(sample);
+	queueChanged.notify_all();
+}
+
+/**
+* @brief Recomputes every tile of the sample, off the filter threads.
+*/
+static void shadow_check(ShadowSample *sample)
+{
+	int width = sample->width;
+	long long pixels = 0, mismatched = 0, tilesMismatched = 0;
+	vector<int> expected;
+
+	for (ShadowTile &tile : sample->tiles) {
+		expected.resize((size_t)(tile.y1 - tile.y0) * width);
+		if (sample->op == OP_PREWITT) {
+			filter_band_prewitt(&tile.band[0], tile.bandY0, &expected[0], width, sample->height, 0, tile.y0, width, tile.y1, sample->filterSize, sample->threshold);
+		}
+		else {
+			for (int &value : tile.band) value = value >= sample->threshold ? 0 : 1;
+			filter_band_edge_detection(&tile.band[0], tile.bandY0, &expected[0], width, sample->height, 0, tile.y0, width, tile.y1, sample->distance);
+		}
+
+		long long tileMismatched = 0;
+		size_t firstMismatch = 0;
+		for (size_t k = 0; k < expected.size(); k++) {
+			if (expected[k] == tile.produced[k]) continue;
+			if (tileMismatched == 0) firstMismatch = k;
+			tileMismatched++;
+		}
+		pixels += expected.size();
+		mismatched += tileMismatched;
+		if (tileMismatched == 0) continue;
+
+		tilesMismatched++;
+		lock_guard<mutex> lock(queueMutex);
+		if (reports++ < SHADOW_MAX_REPORTS) {
+			cout << "Shadow verification: MISMATCH " << (sample->op == OP_PREWITT ? "prewitt" : "edge");
+			cout << " " << (sample->engine < 0 ? "edge-engine" : engine_name(sample->engine)) << " " << width << "x" << sample->height;
+			cout << " rows " << tile.y0 << ".." << tile.y1 - 1 << ": " << tileMismatched << " pixels, first at x=" << firstMismatch % width;
+			cout << " y=" << tile.y0 + firstMismatch / width << " expected " << expected[firstMismatch] << ", got " << tile.produced[firstMismatch] << endl;
+		}
+	}
+
+	lock_guard<mutex> lock(queueMutex);
+	stats.images++;
+	stats.tilesChecked += sample->tiles.size();
+	stats.tilesMismatched += tilesMismatched;
+	stats.pixelsChecked += pixels;
+	stats.pixelsMismatched += mismatched;
+}
+
+static void shadow_thread()
+{
+	unique_lock<mutex> lock(queueMutex);
+	while (true) {
+		queueChanged.wait(lock, [] { return stopping || !queue.empty(); });
+		if (queue.empty()) return;
+
+		ShadowSample *sample = queue.front();
+		queue.pop_front();
+		checking = true;
+		lock.unlock();
+
+		shadow_check(sample);
+		delete sample;
+
+		lock.lock();
+		checking = false;
+		queueChanged.notify_all();
+	}
+}
+
+void shadow_start(double fraction)
+{
+	SHADOW_FRACTION = fraction;
+	if (checker != NULL || fraction <= 0) return;
+
+	checker = new thread(shadow_thread);
+	atexit(shadow_finish);
+}
+
+void shadow_from_env()
+{
+	const char *fraction = getenv("EDGE_SHADOW");
+	if (fraction != NULL && fraction[0] != 0) shadow_start(atof(fraction));
+}
+
+void shadow_wait()
+{
+	unique_lock<mutex> lock(queueMutex);
+	queueChanged.wait(lock, [] { return queue.empty() && !checking; });
+}
+
+void shadow_stats(ShadowStats &result)
+{
+	lock_guard<mutex> lock(queueMutex);
+	result = stats;
+}
+
+void shadow_finish()
+{
+	if (checker == NULL) return;
+
+	shadow_wait();
+	{
+		lock_guard<mutex> lock(queueMutex);
+		stopping = true;
+		queueChanged.notify_all();
+	}
+	checker->join();
+	delete checker;
+	checker = NULL;
+
+	cout << "Shadow verification: " << stats.tilesChecked << " tiles (" << stats.pixelsChecked << " pixels) of ";
+	cout << stats.images << " images checked, " << stats.tilesMismatched << " tiles / " << stats.pixelsMismatched << " pixels mismatched";
+	if (stats.tilesDropped) cout << ", " << stats.tilesDropped << " tiles dropped (checker busy)";
+	cout << "." << endl;
+}
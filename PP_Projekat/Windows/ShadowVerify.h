@@ -0,0 +1,83 @@
+/*
+ * ShadowVerify.h
+ *
+ *  Shadow verification of production runs. Before a filter runs, a random
+ *  SHADOW_FRACTION of its tiles (strips of SHADOW_ROWS full rows, so the
+ *  row wrapping border windows are covered too) is chosen and the input
+ *  rows their windows read are copied; afterwards the produced tiles are
+ *  copied and the sample is queued. A background thread recomputes the
+ *  tiles with the serial reference arithmetic and counts mismatches. The
+ *  filter itself only pays for the copies (about SHADOW_FRACTION of the
+ *  image plus window rows); when the checker falls behind, samples are
+ *  dropped and counted instead of slowing the filter down.
+ *
+ *  Covers image_filter and EdgeEngine, i.e. single runs, batch mode and
+ *  benchmarks. Enabled with -shadow FRACTION for a single run or with
+ *  EDGE_SHADOW=FRACTION in every mode; statistics are printed at exit.
+ */
+
+#ifndef SHADOWVERIFY_H_
+#define SHADOWVERIFY_H_
+
+#define SHADOW_ROWS				32
+#define SHADOW_QUEUE_LIMIT		32		// pending samples, more are dropped
+
+/*
+ * fraction of tiles re-checked, 0 disables shadow verification
+ */
+extern double SHADOW_FRACTION;
+
+struct ShadowStats {
+	long long images;					// filter calls that had at least one sampled tile
+	long long tilesChecked;
+	long long tilesDropped;				// sampled, but the queue was full
+	long long tilesMismatched;
+	long long pixelsChecked;
+	long long pixelsMismatched;
+};
+
+struct ShadowSample;
+
+/**
+* @brief Picks tiles and copies their input windows. Call right before the
+* filter, with the input as the filter gets it.
+*
+* @param engine ENGINE_* for reports, -1 for EdgeEngine
+* @param stride ints between starts of two rows
+* @return NULL if shadow verification is off or no tile was picked
+*/
+ShadowSample *shadow_capture(int op, int engine, const int *inBuffer, int width, int height, int stride);
+
+/**
+* @brief Copies the produced tiles and hands the sample to the background
+* thread. Does nothing for NULL.
+*
+* @param outStride ints between starts of two output rows
+*/
+void shadow_submit(ShadowSample *sample, const int *outBuffer, int outStride);
+
+/**
+* @brief Enables shadow verification, starts the checker thread and prints
+* statistics at exit.
+*/
+void shadow_start(double fraction);
+
+/**
+* @brief Calls shadow_start with EDGE_SHADOW if it is set.
+*/
+void shadow_from_env();
+
+/**
+* @brief Waits until every queued sample has been checked.
+*/
+void shadow_wait();
+
+void shadow_stats(ShadowStats &stats);
+
+/**
+* @brief Waits for queued samples and prints the statistics. Does nothing
+* when shadow verification was never started.
+*/
+void shadow_finish();
+
+#endif /* SHADOWVERIFY_H_ */
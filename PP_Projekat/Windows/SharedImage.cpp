@@ -0,0 +1,320 @@
+/*
+ * SharedImage.cpp
+ *
+ *  In-memory image handoff through shared memory segments.
+ */
+
+#include "SharedImage.h"
+#include "EdgeEngine.h"
+#include "EdgeFilters.h"
+#include "IncrementalFilter.h"
+#include "BmpDecoder.h"
+#include "ImagePool.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+using namespace tbb;
+
+static const char *formatNames[SHARED_FORMAT_COUNT] = {"gray8", "bgr24", "bgra32", "gray32"};
+static const int formatBytes[SHARED_FORMAT_COUNT] = {1, 3, 4, 4};
+
+
+const char *shared_format_name(int format)
+{
+	return format >= 0 && format < SHARED_FORMAT_COUNT ? formatNames[format] : "unknown";
+}
+
+int shared_format_from_name(const char *name)
+{
+	for (int format = 0; format < SHARED_FORMAT_COUNT; format++) {
+		if (strcmp(name, formatNames[format]) == 0) return format;
+	}
+	return -1;
+}
+
+int shared_bytes_per_pixel(int format)
+{
+	return format >= 0 && format < SHARED_FORMAT_COUNT ? formatBytes[format] : 0;
+}
+
+#ifndef _WIN32
+
+/**
+* @brief Whether name is /proc/PID/fd/N of process peerPid and a regular file (memfd or shm segment).
+*/
+static bool peer_descriptor(const char *name, int peerPid)
+{
+	int pid, descriptor, length = 0;
+	if (peerPid <= 0 || sscanf(name, "/proc/%d/fd/%d%n", &pid, &descriptor, &length) != 2 || name[length] != '\0') return false;
+
+	// checked before open, opening a device or a fifo may already have side effects
+	struct stat info;
+	return pid == peerPid && stat(name, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+bool shared_map(const char *name, bool writable, int peerPid, SharedMapping &mapping)
+{
+	mapping.base = NULL;
+	mapping.size = 0;
+
+	int flags = writable ? O_RDWR : O_RDONLY;
+	int fd;
+	if (strncmp(name, "/proc/", 6) == 0) {
+		if (!peer_descriptor(name, peerPid)) return false;
+		fd = open(name, flags | O_CLOEXEC);
+	}
+	else if (name[0] == '/' && strchr(name + 1, '/') == NULL) fd = shm_open(name, flags, 0);
+	else return false;
+	if (fd < 0) return false;
+
+	struct stat info;
+	bool ok = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0;
+	if (ok) {
+		void *base = mmap(NULL, info.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		ok = base != MAP_FAILED;
+		if (ok) {
+			mapping.base = base;
+			mapping.size = info.st_size;
+		}
+	}
+	// the mapping keeps the segment alive
+	close(fd);
+	return ok;
+}
+
+void shared_unmap(SharedMapping &mapping)
+{
+	if (mapping.base != NULL) munmap(mapping.base, mapping.size);
+	mapping.base = NULL;
+	mapping.size = 0;
+}
+
+#else
+
+bool shared_map(const char *name, bool writable, int peerPid, SharedMapping &mapping)
+{
+	mapping.base = NULL;
+	mapping.size = 0;
+	return false;
+}
+
+void shared_unmap(SharedMapping &mapping)
+{
+}
+
+#endif
+
+bool shared_image_at(const SharedMapping &mapping, size_t offset, int format, int width, int height, size_t stride, SharedImage &image)
+{
+	int bytes = shared_bytes_per_pixel(format);
+	if (bytes == 0 || width <= 0 || height <= 0 || mapping.base == NULL) return false;
+
+	size_t rowBytes = (size_t)width * bytes;
+	if (stride == 0) stride = rowBytes;
+	if (stride < rowBytes) return false;
+
+	// stride comes from the client, divide instead of multiplying so a huge one cannot wrap
+	if (offset > mapping.size || mapping.size - offset < rowBytes) return false;
+	if ((size_t)(height - 1) > (mapping.size - offset - rowBytes) / stride) return false;
+
+	image.data = (unsigned char *)mapping.base + offset;
+	image.format = format;
+	image.width = width;
+	image.height = height;
+	image.stride = stride;
+	return true;
+}
+
+/**
+* @brief Stride in ints if the filters can work on the image in place.
+*
+* @return 0 if the image needs a converted copy
+*/
+static int direct_stride(const SharedImage &image)
+{
+	if (image.format != SHARED_GRAY32) return 0;
+	if ((size_t)image.data % sizeof(int) != 0 || image.stride % sizeof(int) != 0) return 0;
+	if (image.stride / sizeof(int) > (size_t)INT_MAX) return 0;
+	return (int)(image.stride / sizeof(int));
+}
+
+/**
+* @brief Converts rectangle r of in into the same pixels of work.
+*/
+static void import_rect(const SharedImage &in, ImageView<int> work, const RoiRect &r)
+{
+	int bytes = shared_bytes_per_pixel(in.format);
+	for (int j = r.y0; j < r.y1; j++) {
+		const unsigned char *src = in.data + (size_t)j * in.stride + (size_t)r.x0 * bytes;
+		int *dst = work.row(j) + r.x0;
+		// the decoder may read ahead within a row, never past the last pixel of the image
+		size_t readable = j == in.height - 1 ? (size_t)(in.width - r.x0) * bytes : in.stride - (size_t)r.x0 * bytes;
+		if (in.format == SHARED_GRAY32) memcpy(dst, src, (r.x1 - r.x0) * sizeof(int));
+		else bmp_gray_row(src, dst, r.x1 - r.x0, bytes, readable);
+	}
+}
+
+/**
+* @brief Writes rectangle r of result into the same pixels of out.
+*/
+static void export_rect(ImageView<const int> result, SharedImage &out, const RoiRect &r)
+{
+	for (int j = r.y0; j < r.y1; j++) {
+		const int *src = result.row(j) + r.x0;
+		unsigned char *dst = out.data + (size_t)j * out.stride;
+		if (out.format == SHARED_GRAY32) memcpy(dst + (size_t)r.x0 * sizeof(int), src, (r.x1 - r.x0) * sizeof(int));
+		else for (int i = 0; i < r.x1 - r.x0; i++) dst[r.x0 + i] = (unsigned char)min(255, max(0, src[i]));
+	}
+}
+
+static void import_image(const SharedImage &in, ImageView<int> work)
+{
+	TRACE_SCOPE("shm import", TRACE_STAGE);
+	parallel_for(blocked_range<int>(0, in.height), [&](const blocked_range<int> &r) {
+		import_rect(in, work, {0, r.begin(), in.width, r.end()});
+	});
+}
+
+static void export_image(ImageView<const int> result, SharedImage &out)
+{
+	TRACE_SCOPE("shm export", TRACE_STAGE);
+	parallel_for(blocked_range<int>(0, out.height), [&](const blocked_range<int> &r) {
+		export_rect(result, out, {0, r.begin(), out.width, r.end()});
+	});
+}
+
+bool shared_filter(EdgeEngine &engine, int op, const SharedImage &in, SharedImage &out, int threshold)
+{
+	if (shared_bytes_per_pixel(in.format) == 0) return false;
+	if (out.format != SHARED_GRAY8 && out.format != SHARED_GRAY32) return false;
+	if (in.width != out.width || in.height != out.height || in.width <= 0 || in.height <= 0) return false;
+
+	int width = in.width, height = in.height;
+	int inDirect = direct_stride(in), outDirect = direct_stride(out);
+	int stride = image_stride(width);
+	bool inPlaceIn = inDirect != 0;
+	bool inPlaceOut = outDirect != 0;
+
+	ImageView<int> work = inPlaceIn ? ImageView<int>((int *)in.data, width, height, inDirect) : ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+	ImageView<int> result = inPlaceOut ? ImageView<int>((int *)out.data, width, height, outDirect) : ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+	if (work.data == NULL || result.data == NULL) {
+		if (!inPlaceIn) pool_free_image(work.data, stride, height);
+		if (!inPlaceOut) pool_free_image(result.data, stride, height);
+		return false;
+	}
+
+	if (!inPlaceIn) import_image(in, work);
+
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		engine.run(op, work, result, threshold);
+	}
+
+	if (!inPlaceOut) export_image(result, out);
+
+	if (!inPlaceIn) pool_free_image(work.data, stride, height);
+	if (!inPlaceOut) pool_free_image(result.data, stride, height);
+	return true;
+}
+
+bool shared_filter_regions(EdgeEngine &engine, int op, const SharedImage &in, SharedImage &out, int outX, int outY,
+		const RoiRect *rects, int count, int threshold)
+{
+	if (shared_bytes_per_pixel(in.format) == 0) return false;
+	if (out.format != SHARED_GRAY8 && out.format != SHARED_GRAY32) return false;
+	if (in.width <= 0 || in.height <= 0 || out.width <= 0 || out.height <= 0) return false;
+
+	int width = in.width, height = in.height;
+	vector<RoiRect> clipped, pieces, reads, readPieces;
+	for (int k = 0; k < count; k++) {
+		RoiRect rect = rects[k];
+		if (!roi_clip(rect, width, height)) continue;
+		if (rect.x0 < outX || rect.y0 < outY || rect.x1 > outX + out.width || rect.y1 > outY + out.height) return false;
+		clipped.push_back(rect);
+	}
+	roi_disjoint(clipped.data(), (int)clipped.size(), pieces);
+	for (size_t k = 0; k < pieces.size(); k++) roi_reads(pieces[k], width, height, engine.radius(op), reads);
+	roi_disjoint(reads.data(), (int)reads.size(), readPieces);
+
+	int inDirect = direct_stride(in), outDirect = direct_stride(out);
+	int stride = image_stride(width), outStride = image_stride(out.width);
+	bool inPlaceIn = inDirect != 0;
+	bool inPlaceOut = outDirect != 0;
+
+	// pooled buffers are only touched where the rectangles read and write
+	ImageView<int> work = inPlaceIn ? ImageView<int>((int *)in.data, width, height, inDirect) : ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+	ImageView<int> result = inPlaceOut ? ImageView<int>((int *)out.data, out.width, out.height, outDirect) : ImageView<int>(pool_alloc_image(outStride, out.height), out.width, out.height, outStride);
+	if (work.data == NULL || result.data == NULL) {
+		if (!inPlaceIn) pool_free_image(work.data, stride, height);
+		if (!inPlaceOut) pool_free_image(result.data, outStride, out.height);
+		return false;
+	}
+
+	if (!inPlaceIn) {
+		TRACE_SCOPE("shm import", TRACE_STAGE);
+		parallel_for(blocked_range<size_t>(0, readPieces.size()), [&](const blocked_range<size_t> &r) {
+			for (size_t k = r.begin(); k != r.end(); k++) import_rect(in, work, readPieces[k]);
+		});
+	}
+
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		engine.runRegions(op, work, result, outX, outY, pieces.data(), (int)pieces.size(), threshold);
+	}
+
+	if (!inPlaceOut) {
+		TRACE_SCOPE("shm export", TRACE_STAGE);
+		parallel_for(blocked_range<size_t>(0, pieces.size()), [&](const blocked_range<size_t> &r) {
+			for (size_t k = r.begin(); k != r.end(); k++) {
+				const RoiRect &p = pieces[k];
+				export_rect(result, out, {p.x0 - outX, p.y0 - outY, p.x1 - outX, p.y1 - outY});
+			}
+		});
+	}
+
+	if (!inPlaceIn) pool_free_image(work.data, stride, height);
+	if (!inPlaceOut) pool_free_image(result.data, outStride, out.height);
+	return true;
+}
+
+bool shared_filter_incremental(IncrementalFilter &filter, int op, const SharedImage &in, SharedImage &out, int threshold)
+{
+	if (shared_bytes_per_pixel(in.format) == 0) return false;
+	if (out.format != SHARED_GRAY8 && out.format != SHARED_GRAY32) return false;
+	if (in.width != out.width || in.height != out.height || in.width <= 0 || in.height <= 0) return false;
+
+	int width = in.width, height = in.height;
+	int inDirect = direct_stride(in);
+	int stride = image_stride(width);
+	bool inPlaceIn = inDirect != 0;
+
+	ImageView<int> work = inPlaceIn ? ImageView<int>((int *)in.data, width, height, inDirect) : ImageView<int>(pool_alloc_image(stride, height), width, height, stride);
+	if (work.data == NULL) return false;
+	if (!inPlaceIn) import_image(in, work);
+
+	// the result stays in the filter for the next frame, out always gets a copy
+	ImageView<const int> result;
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		result = filter.run(op, work, threshold);
+	}
+	if (result.data != NULL) export_image(result, out);
+
+	if (!inPlaceIn) pool_free_image(work.data, stride, height);
+	return result.data != NULL;
+}
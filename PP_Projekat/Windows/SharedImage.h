@@ -0,0 +1,109 @@
+/*
+ * SharedImage.h
+ *
+ *  Images handed over in memory by an embedding caller: a POSIX shared
+ *  memory segment or memfd (or any mapped block) holding raw 8 bit gray,
+ *  BGR, BGRA or 32 bit gray pixels with a row stride in bytes. The filter
+ *  result is written straight into a caller provided segment, no file and
+ *  no BMP codec is involved.
+ *
+ *  The kernels work on int pixels, so 8 bit inputs go through one SIMD
+ *  conversion pass into a pooled buffer (the same row kernels the BMP
+ *  decoder uses) and 8 bit outputs through one packing pass. 32 bit gray
+ *  images are read or written by the filter directly, without any copy.
+ */
+
+#ifndef SHAREDIMAGE_H_
+#define SHAREDIMAGE_H_
+
+#include <stddef.h>
+#include "RegionOfInterest.h"
+
+#define SHARED_GRAY8			0
+#define SHARED_BGR24			1
+#define SHARED_BGRA32			2
+#define SHARED_GRAY32			3		// native int gray values, 0..255
+#define SHARED_FORMAT_COUNT		4
+
+class EdgeEngine;
+class IncrementalFilter;
+
+/**
+* @brief Non-owning description of pixels in memory.
+*/
+struct SharedImage {
+	unsigned char *data;				// first pixel of the first row
+	int format;							// SHARED_*
+	int width;
+	int height;
+	size_t stride;						// bytes between starts of two rows
+};
+
+/**
+* @brief A mapped segment, released with shared_unmap.
+*/
+struct SharedMapping {
+	void *base;
+	size_t size;
+};
+
+const char *shared_format_name(int format);
+
+/**
+* @return SHARED_* or -1 for an unknown name (gray8, bgr24, bgra32, gray32)
+*/
+int shared_format_from_name(const char *name);
+
+int shared_bytes_per_pixel(int format);
+
+/**
+* @brief Maps a segment: a POSIX shared memory name (/NAME, opened with shm_open)
+* or /proc/PID/fd/N, a memfd or segment held by process peerPid. Other paths,
+* devices and anything but regular files are refused.
+*
+* @param writable map read-write, otherwise read-only
+* @param peerPid process whose descriptors may be named, 0 for none
+* @return false if the segment is refused or cannot be opened or mapped
+*/
+bool shared_map(const char *name, bool writable, int peerPid, SharedMapping &mapping);
+
+void shared_unmap(SharedMapping &mapping);
+
+/**
+* @brief Describes an image at offset in a mapped segment. A stride of 0 means
+* packed rows.
+*
+* @return false if the image does not fit into the segment
+*/
+bool shared_image_at(const SharedMapping &mapping, size_t offset, int format, int width, int height, size_t stride, SharedImage &image);
+
+/**
+* @brief Runs op (OP_PREWITT / OP_EDGE) on engine with the given threshold. The
+* input is only read, the output must have the size of the input and be
+* SHARED_GRAY8 or SHARED_GRAY32.
+*
+* @return false for unsupported formats or sizes
+*/
+bool shared_filter(EdgeEngine &engine, int op, const SharedImage &in, SharedImage &out, int threshold);
+
+/**
+* @brief Same as shared_filter on rectangles of interest only: converts just the
+* pixels their windows read and writes just the rectangles, other pixels of out
+* are left unchanged.
+*
+* @param out the full image or a crop holding every rectangle, its pixel (0, 0)
+* is image pixel (outX, outY)
+* @return false for unsupported formats or a rectangle outside out
+*/
+bool shared_filter_regions(EdgeEngine &engine, int op, const SharedImage &in, SharedImage &out, int outX, int outY,
+		const RoiRect *rects, int count, int threshold);
+
+/**
+* @brief Same as shared_filter for the next frame of a sequence, only the tiles
+* that changed since the previous frame of filter are recomputed.
+*
+* @return false for unsupported formats or sizes, or out of memory
+*/
+bool shared_filter_incremental(IncrementalFilter &filter, int op, const SharedImage &in, SharedImage &out, int threshold);
+
+#endif /* SHAREDIMAGE_H_ */
@@ -0,0 +1,450 @@
+/*
+ * SimdFilters.cpp
+ *
+ *  Vectorized Prewitt and edge detection.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include "EdgeFilters.h"
+#include "SimdFilters.h"
+#include "Trace.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_FILTERS_AVX2
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define SIMD_FILTERS_SSE4
+#endif
+
+using namespace std;
+using namespace tbb;
+
+
+void simd_kernel_prewitt(SimdKernel &kernel)
+{
+	simd_kernel_prewitt_weights(kernel, FILTER_SIZE, filterHor, filterVer, THRESHOLD);
+}
+
+void simd_kernel_prewitt_weights(SimdKernel &kernel, int filterSize, const int *hor, const int *ver, int threshold)
+{
+	int offset = (filterSize - 1) / 2;
+	int count = 0;
+
+	for (int m = 0; m < filterSize; m++) {
+		for (int n = 0; n < filterSize; n++) {
+			int wx = hor[m * filterSize + n];
+			int wy = ver[m * filterSize + n];
+			if (wx == 0 && wy == 0) continue;
+			kernel.taps[count].dx = n - offset;
+			kernel.taps[count].dy = m - offset;
+			kernel.taps[count].wx = wx;
+			kernel.taps[count].wy = wy;
+			kernel.taps[count].offset = 0;
+			count++;
+		}
+	}
+	kernel.tapCount = count;
+	kernel.radius = offset;
+	kernel.filterSize = filterSize;
+	kernel.filterHor = hor;
+	kernel.filterVer = ver;
+	kernel.threshold = threshold;
+}
+
+void simd_kernel_edge_detection(SimdKernel &kernel)
+{
+	simd_kernel_edge_distance(kernel, DISTANCE, THRESHOLD);
+}
+
+void simd_kernel_edge_distance(SimdKernel &kernel, int distance, int threshold)
+{
+	int iter = distance * 2 + 1;
+	int count = 0;
+
+	// the serial version skips the top left corner of the window
+	for (int m = 0; m < iter; m++) {
+		for (int n = 0; n < iter; n++) {
+			if (m == 0 && n == 0) continue;
+			kernel.taps[count].dx = n - distance;
+			kernel.taps[count].dy = m - distance;
+			kernel.taps[count].wx = 1;
+			kernel.taps[count].wy = 1;
+			kernel.taps[count].offset = 0;
+			count++;
+		}
+	}
+	kernel.tapCount = count;
+	kernel.radius = distance;
+	kernel.filterSize = iter;
+	kernel.filterHor = NULL;
+	kernel.filterVer = NULL;
+	kernel.threshold = threshold;
+}
+
+void simd_kernel_bind(SimdKernel &kernel, int stride)
+{
+	for (int t = 0; t < kernel.tapCount; t++) {
+		kernel.taps[t].offset = (long long)kernel.taps[t].dy * stride + kernel.taps[t].dx;
+	}
+}
+
+/**
+* @brief Prewitt over a row segment where every tap is inside the image.
+*
+* @param out output pixel of column xa
+*/
+static void prewitt_interior_row(const int *in, int *out, const FilterTap *taps, int tapCount, int threshold, int xa, int xb)
+{
+	int x = xa;
+
+#if defined(SIMD_FILTERS_AVX2)
+	const __m256i limit = _mm256_set1_epi32(threshold - 1);
+	const __m256i white = _mm256_set1_epi32(255);
+	for (; x + 8 <= xb; x += 8) {
+		__m256i gx = _mm256_setzero_si256();
+		__m256i gy = _mm256_setzero_si256();
+		for (int t = 0; t < tapCount; t++) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(in + x + taps[t].offset));
+			gx = _mm256_add_epi32(gx, _mm256_mullo_epi32(v, _mm256_set1_epi32(taps[t].wx)));
+			gy = _mm256_add_epi32(gy, _mm256_mullo_epi32(v, _mm256_set1_epi32(taps[t].wy)));
+		}
+		__m256i g = _mm256_add_epi32(_mm256_abs_epi32(gx), _mm256_abs_epi32(gy));
+		_mm256_storeu_si256((__m256i *)(out + x - xa), _mm256_and_si256(_mm256_cmpgt_epi32(g, limit), white));
+	}
+#elif defined(SIMD_FILTERS_SSE4)
+	const __m128i limit = _mm_set1_epi32(threshold - 1);
+	const __m128i white = _mm_set1_epi32(255);
+	for (; x + 4 <= xb; x += 4) {
+		__m128i gx = _mm_setzero_si128();
+		__m128i gy = _mm_setzero_si128();
+		for (int t = 0; t < tapCount; t++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(in + x + taps[t].offset));
+			gx = _mm_add_epi32(gx, _mm_mullo_epi32(v, _mm_set1_epi32(taps[t].wx)));
+			gy = _mm_add_epi32(gy, _mm_mullo_epi32(v, _mm_set1_epi32(taps[t].wy)));
+		}
+		__m128i g = _mm_add_epi32(_mm_abs_epi32(gx), _mm_abs_epi32(gy));
+		_mm_storeu_si128((__m128i *)(out + x - xa), _mm_and_si128(_mm_cmpgt_epi32(g, limit), white));
+	}
+#endif
+
+	for (; x < xb; x++) {
+		int Gx = 0, Gy = 0;
+		for (int t = 0; t < tapCount; t++) {
+			Gx += in[x + taps[t].offset] * taps[t].wx;
+			Gy += in[x + taps[t].offset] * taps[t].wy;
+		}
+		out[x - xa] = abs(Gx) + abs(Gy) >= threshold ? 255 : 0;
+	}
+}
+
+/**
+* @brief Edge detection over a row segment of a thresholded (0/1) image where
+* every tap is inside the image. Pixel is an edge if its window holds both values.
+*
+* @param out output pixel of column xa
+*/
+static void edge_interior_row(const int *in, int *out, const FilterTap *taps, int tapCount, int xa, int xb)
+{
+	int x = xa;
+
+	// DISTANCE 0 leaves no taps, the serial version then sees P = 0, O = 1 and marks an edge
+	if (tapCount == 0) {
+		for (; x < xb; x++) out[x - xa] = 255;
+		return;
+	}
+
+#if defined(SIMD_FILTERS_AVX2)
+	for (; x + 8 <= xb; x += 8) {
+		__m256i any = _mm256_setzero_si256();
+		__m256i all = _mm256_set1_epi32(1);
+		for (int t = 0; t < tapCount; t++) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(in + x + taps[t].offset));
+			any = _mm256_or_si256(any, v);
+			all = _mm256_and_si256(all, v);
+		}
+		__m256i edge = _mm256_andnot_si256(all, any);
+		_mm256_storeu_si256((__m256i *)(out + x - xa), _mm256_sub_epi32(_mm256_slli_epi32(edge, 8), edge));
+	}
+#elif defined(SIMD_FILTERS_SSE4)
+	for (; x + 4 <= xb; x += 4) {
+		__m128i any = _mm_setzero_si128();
+		__m128i all = _mm_set1_epi32(1);
+		for (int t = 0; t < tapCount; t++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(in + x + taps[t].offset));
+			any = _mm_or_si128(any, v);
+			all = _mm_and_si128(all, v);
+		}
+		__m128i edge = _mm_andnot_si128(all, any);
+		_mm_storeu_si128((__m128i *)(out + x - xa), _mm_sub_epi32(_mm_slli_epi32(edge, 8), edge));
+	}
+#endif
+
+	for (; x < xb; x++) {
+		int any = 0, all = 1;
+		for (int t = 0; t < tapCount; t++) {
+			any |= in[x + taps[t].offset];
+			all &= in[x + taps[t].offset];
+		}
+		out[x - xa] = (any & ~all) ? 255 : 0;
+	}
+}
+
+/**
+* @brief Splits rectangle into the part where the whole window is inside the
+* image (vectorized) and the border strips (serial arithmetic).
+*
+* @param radius window radius
+* @param border region kernel used for border strips
+* @param interior row kernel used for the interior
+*/
+template <typename Border, typename Interior>
+static void split_region(int width, int height, int radius, int x0, int y0, int x1, int y1, Border border, Interior interior)
+{
+	// pixel 0 is skipped by check_if_border_case, so row "radius" still touches it
+	int ix0 = max(x0, radius), ix1 = min(x1, width - radius);
+	int iy0 = max(y0, radius + 1), iy1 = min(y1, height - radius);
+
+	if (ix0 >= ix1 || iy0 >= iy1) {
+		border(x0, y0, x1, y1);
+		return;
+	}
+
+	if (y0 < iy0) border(x0, y0, x1, iy0);
+	if (iy1 < y1) border(x0, iy1, x1, y1);
+	if (x0 < ix0) border(x0, iy0, ix0, iy1);
+	if (ix1 < x1) border(ix1, iy0, x1, iy1);
+
+	for (int j = iy0; j < iy1; j++) interior(j, ix0, ix1);
+}
+
+/**
+* @brief Prewitt over one rectangle of a view, kernel must be bound to in.stride
+*
+* @param outX image column of the first out column
+* @param outY image row of the first out row
+*/
+void simd_kernel_region_prewitt(const SimdKernel &kernel, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int outX, int outY)
+{
+	split_region(in.width, in.height, kernel.radius, x0, y0, x1, y1,
+		[&](int bx0, int by0, int bx1, int by1) {
+			filter_region_prewitt_view(in, out, bx0, by0, bx1, by1, kernel.filterSize, kernel.filterHor, kernel.filterVer, kernel.threshold, outX, outY);
+		},
+		[&](int j, int xa, int xb) {
+			prewitt_interior_row(in.row(j), out.row(j - outY) + (xa - outX), kernel.taps, kernel.tapCount, kernel.threshold, xa, xb);
+		});
+}
+
+/**
+* @brief Edge detection over one rectangle of a thresholded view, kernel must be bound to in.stride,
+* out is placed as in simd_kernel_region_prewitt
+*/
+void simd_kernel_region_edge_detection(const SimdKernel &kernel, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int outX, int outY)
+{
+	split_region(in.width, in.height, kernel.radius, x0, y0, x1, y1,
+		[&](int bx0, int by0, int bx1, int by1) {
+			filter_region_edge_detection_view(in, out, bx0, by0, bx1, by1, kernel.radius, outX, outY);
+		},
+		[&](int j, int xa, int xb) {
+			edge_interior_row(in.row(j), out.row(j - outY) + (xa - outX), kernel.taps, kernel.tapCount, xa, xb);
+		});
+}
+
+void simd_region_prewitt(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1)
+{
+	SimdKernel kernel;
+	simd_kernel_prewitt(kernel);
+	simd_kernel_bind(kernel, width);
+	simd_kernel_region_prewitt(kernel, ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height), x0, y0, x1, y1);
+}
+
+void simd_region_edge_detection(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1)
+{
+	SimdKernel kernel;
+	simd_kernel_edge_detection(kernel);
+	simd_kernel_bind(kernel, width);
+	simd_kernel_region_edge_detection(kernel, ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height), x0, y0, x1, y1);
+}
+
+static void threshold_span(const int *src, int *dst, long long count, int threshold)
+{
+	long long k = 0;
+
+#if defined(SIMD_FILTERS_AVX2)
+	const __m256i limit = _mm256_set1_epi32(threshold);
+	const __m256i one = _mm256_set1_epi32(1);
+	for (; k + 8 <= count; k += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + k));
+		_mm256_storeu_si256((__m256i *)(dst + k), _mm256_and_si256(_mm256_cmpgt_epi32(limit, v), one));
+	}
+#endif
+
+	for (; k < count; k++) dst[k] = src[k] >= threshold ? 0 : 1;
+}
+
+void simd_threshold_edge_copy(ImageView<const int> source, ImageView<int> target, int y0, int y1, int threshold)
+{
+	int width = source.width;
+
+	// dense rows are one continuous span, padded rows are done one by one
+	if (source.dense() && target.dense()) {
+		threshold_span(source.row(y0), target.row(y0), (long long)(y1 - y0) * width, threshold);
+		return;
+	}
+	for (int j = y0; j < y1; j++) {
+		threshold_span(source.row(j), target.row(j), width, threshold);
+	}
+}
+
+void simd_column_range(const int *row, int *low, int *high, int count)
+{
+	int x = 0;
+
+#if defined(SIMD_FILTERS_AVX2)
+	for (; x + 8 <= count; x += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(row + x));
+		_mm256_storeu_si256((__m256i *)(low + x), _mm256_min_epi32(_mm256_loadu_si256((const __m256i *)(low + x)), v));
+		_mm256_storeu_si256((__m256i *)(high + x), _mm256_max_epi32(_mm256_loadu_si256((const __m256i *)(high + x)), v));
+	}
+#elif defined(SIMD_FILTERS_SSE4)
+	for (; x + 4 <= count; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+		_mm_storeu_si128((__m128i *)(low + x), _mm_min_epi32(_mm_loadu_si128((const __m128i *)(low + x)), v));
+		_mm_storeu_si128((__m128i *)(high + x), _mm_max_epi32(_mm_loadu_si128((const __m128i *)(high + x)), v));
+	}
+#endif
+
+	for (; x < count; x++) {
+		low[x] = min(low[x], row[x]);
+		high[x] = max(high[x], row[x]);
+	}
+}
+
+void simd_row_range(const int *row, int count, int &low, int &high)
+{
+	int x = 0;
+
+#if defined(SIMD_FILTERS_AVX2)
+	if (count >= 8) {
+		__m256i lo = _mm256_loadu_si256((const __m256i *)row), hi = lo;
+		for (x = 8; x + 8 <= count; x += 8) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(row + x));
+			lo = _mm256_min_epi32(lo, v);
+			hi = _mm256_max_epi32(hi, v);
+		}
+		__m128i lo4 = _mm_min_epi32(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+		__m128i hi4 = _mm_max_epi32(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+		lo4 = _mm_min_epi32(lo4, _mm_shuffle_epi32(lo4, _MM_SHUFFLE(1, 0, 3, 2)));
+		hi4 = _mm_max_epi32(hi4, _mm_shuffle_epi32(hi4, _MM_SHUFFLE(1, 0, 3, 2)));
+		lo4 = _mm_min_epi32(lo4, _mm_shuffle_epi32(lo4, _MM_SHUFFLE(2, 3, 0, 1)));
+		hi4 = _mm_max_epi32(hi4, _mm_shuffle_epi32(hi4, _MM_SHUFFLE(2, 3, 0, 1)));
+		low = min(low, _mm_cvtsi128_si32(lo4));
+		high = max(high, _mm_cvtsi128_si32(hi4));
+	}
+#elif defined(SIMD_FILTERS_SSE4)
+	if (count >= 4) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)row), hi = lo;
+		for (x = 4; x + 4 <= count; x += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+			lo = _mm_min_epi32(lo, v);
+			hi = _mm_max_epi32(hi, v);
+		}
+		lo = _mm_min_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+		hi = _mm_max_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+		lo = _mm_min_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+		hi = _mm_max_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+		low = min(low, _mm_cvtsi128_si32(lo));
+		high = max(high, _mm_cvtsi128_si32(hi));
+	}
+#endif
+
+	for (; x < count; x++) {
+		low = min(low, row[x]);
+		high = max(high, row[x]);
+	}
+}
+
+void simd_threshold_edge_input(int *buffer, int width, int height, int y0, int y1)
+{
+	ImageView<int> image(buffer, width, height);
+	simd_threshold_edge_copy(image, image, y0, y1, THRESHOLD);
+}
+
+/**
+* @brief Single threaded vectorized Prewitt filter
+*/
+void filter_simd_prewitt(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_simd_prewitt(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_simd_prewitt(ImageView<const int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_prewitt(kernel);
+	simd_kernel_bind(kernel, in.stride);
+	simd_kernel_region_prewitt(kernel, in, out, 0, 0, in.width, in.height);
+}
+
+/**
+* @brief Vectorized Prewitt filter over tiles in parallel
+*/
+void filter_simd_tiled_prewitt(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_simd_tiled_prewitt(ImageView<const int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_simd_tiled_prewitt(ImageView<const int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_prewitt(kernel);
+	simd_kernel_bind(kernel, in.stride);
+
+	parallel_for_tiles(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_prewitt(kernel, in, out, x0, y0, x1, y1);
+	});
+}
+
+/**
+* @brief Single threaded vectorized edge detection, inBuffer is thresholded in place
+*/
+void filter_simd_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_simd_edge_detection(ImageView<int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_simd_edge_detection(ImageView<int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_edge_detection(kernel);
+	simd_kernel_bind(kernel, in.stride);
+
+	simd_threshold_edge_copy(in, in, 0, in.height, THRESHOLD);
+	simd_kernel_region_edge_detection(kernel, in, out, 0, 0, in.width, in.height);
+}
+
+/**
+* @brief Vectorized edge detection over tiles in parallel
+*/
+void filter_simd_tiled_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+{
+	filter_simd_tiled_edge_detection(ImageView<int>(inBuffer, width, height), ImageView<int>(outBuffer, width, height));
+}
+
+void filter_simd_tiled_edge_detection(ImageView<int> in, ImageView<int> out)
+{
+	SimdKernel kernel;
+	simd_kernel_edge_detection(kernel);
+	simd_kernel_bind(kernel, in.stride);
+
+	parallel_for(blocked_range<int>(0, in.height, CUTOFF), [&](const blocked_range<int> &r) {
+		TRACE_SCOPE("threshold", TRACE_TASK);
+		simd_threshold_edge_copy(in, in, r.begin(), r.end(), THRESHOLD);
+	});
+	parallel_for_tiles(in.width, in.height, [&](int x0, int y0, int x1, int y1) {
+		simd_kernel_region_edge_detection(kernel, in, out, x0, y0, x1, y1);
+	});
+}
@@ -0,0 +1,83 @@
+/*
+ * SimdFilters.h
+ *
+ *  Vectorized Prewitt and edge detection. Interior pixels, whose whole
+ *  window lies inside the image, are computed 8 (AVX2) or 4 (SSE4.1)
+ *  at a time from a list of non-zero kernel taps. Border pixels keep the
+ *  exact index based border handling of the serial versions, so results
+ *  are identical to filter_serial_prewitt / filter_serial_edge_detection.
+ */
+
+#ifndef SIMDFILTERS_H_
+#define SIMDFILTERS_H_
+
+#include "EdgeFilters.h"
+
+#define MAX_TAPS				(MAX_FILTER_SIZE * MAX_FILTER_SIZE)
+
+/**
+* @brief Non-zero kernel entry: position relative to the output pixel, weights
+* and the linear offset of that position for the bound row stride.
+*/
+struct FilterTap {
+	long long offset;
+	int dx;
+	int dy;
+	int wx;
+	int wy;
+};
+
+/**
+* @brief Kernel table of one operator, built once from the current FILTER_SIZE /
+* DISTANCE and bound to the row stride of an image before use. Carries every
+* parameter the operator needs, so filters running from a kernel do not read
+* the globals.
+*/
+struct SimdKernel {
+	FilterTap taps[MAX_TAPS];
+	int tapCount;
+	int radius;
+	int filterSize;
+	const int *filterHor;			// full weight tables for the border pixels, NULL for edge detection
+	const int *filterVer;
+	int threshold;
+};
+
+void simd_kernel_prewitt(SimdKernel &kernel);
+void simd_kernel_edge_detection(SimdKernel &kernel);
+void simd_kernel_prewitt_weights(SimdKernel &kernel, int filterSize, const int *hor, const int *ver, int threshold);
+void simd_kernel_edge_distance(SimdKernel &kernel, int distance, int threshold);
+void simd_kernel_bind(SimdKernel &kernel, int stride);
+void simd_kernel_region_prewitt(const SimdKernel &kernel, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int outX = 0, int outY = 0);
+void simd_kernel_region_edge_detection(const SimdKernel &kernel, ImageView<const int> in, ImageView<int> out, int x0, int y0, int x1, int y1, int outX = 0, int outY = 0);
+
+void simd_region_prewitt(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1);
+void simd_region_edge_detection(int *inBuffer, int *outBuffer, int width, int height, int x0, int y0, int x1, int y1);
+void simd_threshold_edge_input(int *buffer, int width, int height, int y0, int y1);
+void simd_threshold_edge_copy(ImageView<const int> source, ImageView<int> target, int y0, int y1, int threshold);
+
+/**
+* @brief Column wise running range: low[x] = min(low[x], row[x]), high[x] = max(high[x], row[x]).
+*/
+void simd_column_range(const int *row, int *low, int *high, int count);
+
+/**
+* @brief Widens low..high to hold the count values of row.
+*/
+void simd_row_range(const int *row, int count, int &low, int &high);
+
+void filter_simd_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+void filter_simd_tiled_prewitt(int *inBuffer, int *outBuffer, int width, int height);
+void filter_simd_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+void filter_simd_tiled_edge_detection(int *inBuffer, int *outBuffer, int width, int height);
+
+/*
+ * Same filters on views, e.g. an ImageBuffer with padded rows or a rectangle
+ * of a larger image; input and output strides may differ.
+ */
+void filter_simd_prewitt(ImageView<const int> in, ImageView<int> out);
+void filter_simd_tiled_prewitt(ImageView<const int> in, ImageView<int> out);
+void filter_simd_edge_detection(ImageView<int> in, ImageView<int> out);
+void filter_simd_tiled_edge_detection(ImageView<int> in, ImageView<int> out);
+
+#endif /* SIMDFILTERS_H_ */
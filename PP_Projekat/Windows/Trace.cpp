@@ -0,0 +1,173 @@
+/*
+ * Trace.cpp
+ *
+ *  Scoped stage / task timers with Chrome trace export.
+ */
+
+#include "Trace.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include <tbb/tick_count.h>
+#include <tbb/enumerable_thread_specific.h>
+
+using namespace std;
+using namespace tbb;
+
+bool TRACE_ENABLED = false;
+
+struct TraceEvent {
+	const char *name;
+	const char *category;
+	double start;				// microseconds since trace_start
+	double end;
+	int thread;
+};
+
+struct TraceBuffer {
+	int thread = -1;
+	vector<TraceEvent> events;
+};
+
+static enumerable_thread_specific<TraceBuffer> buffers;
+static atomic<int> nextThread(0);
+static tick_count origin = tick_count::now();
+static string outputPath;
+static bool finishRegistered = false;
+
+
+double trace_now()
+{
+	return (tick_count::now() - origin).seconds() * 1e6;
+}
+
+void trace_record(const char *name, const char *category, double start, double end)
+{
+	TraceBuffer &buffer = buffers.local();
+	if (buffer.thread < 0) buffer.thread = nextThread++;
+
+	TraceEvent event = {name, category, start, end, buffer.thread};
+	buffer.events.push_back(event);
+}
+
+void trace_start(const char *path)
+{
+	for (TraceBuffer &buffer : buffers) buffer.events.clear();
+	outputPath = path != NULL ? path : "";
+	origin = tick_count::now();
+	TRACE_ENABLED = true;
+
+	if (!finishRegistered) {
+		atexit(trace_finish);
+		finishRegistered = true;
+	}
+}
+
+void trace_from_env()
+{
+	const char *path = getenv("EDGE_TRACE");
+	if (path != NULL && path[0] != 0) trace_start(path);
+}
+
+/**
+* @brief All events of all threads, ordered by start time.
+*/
+static vector<TraceEvent> trace_events()
+{
+	vector<TraceEvent> events;
+	for (const TraceBuffer &buffer : buffers) events.insert(events.end(), buffer.events.begin(), buffer.events.end());
+	sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+	return events;
+}
+
+bool trace_write_chrome(const char *path)
+{
+	ofstream out(path);
+	if (!out) {
+		cout << "ERROR: cannot write " << path << endl;
+		return false;
+	}
+
+	vector<TraceEvent> events = trace_events();
+	out << fixed << setprecision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	for (size_t k = 0; k < events.size(); k++) {
+		const TraceEvent &e = events[k];
+		out << "  {\"name\": \"" << e.name << "\", \"cat\": \"" << e.category << "\", \"ph\": \"X\"";
+		out << ", \"ts\": " << e.start << ", \"dur\": " << e.end - e.start;
+		out << ", \"pid\": 1, \"tid\": " << e.thread << "}" << (k + 1 < events.size() ? "," : "") << endl;
+	}
+	out << "]}" << endl;
+	return true;
+}
+
+struct TraceStats {
+	string category;
+	string name;
+	double first;
+	int count;
+	double total;
+	double max;
+};
+
+void trace_print_summary()
+{
+	vector<TraceEvent> events = trace_events();
+	if (events.empty()) return;
+
+	map<pair<string, string>, TraceStats> byName;
+	double wallStart = events[0].start, wallEnd = events[0].end;
+	for (const TraceEvent &e : events) {
+		double duration = e.end - e.start;
+		TraceStats &stats = byName[make_pair(string(e.category), string(e.name))];
+		if (stats.count == 0) {
+			stats.category = e.category;
+			stats.name = e.name;
+			stats.first = e.start;
+		}
+		stats.count++;
+		stats.total += duration;
+		stats.max = max(stats.max, duration);
+		wallEnd = max(wallEnd, e.end);
+	}
+
+	// stages in the order they first ran, tasks after them
+	vector<TraceStats> rows;
+	for (const auto &entry : byName) rows.push_back(entry.second);
+	sort(rows.begin(), rows.end(), [](const TraceStats &a, const TraceStats &b) {
+		bool aStage = a.category == TRACE_STAGE, bStage = b.category == TRACE_STAGE;
+		if (aStage != bStage) return aStage;
+		return a.first < b.first;
+	});
+
+	double wall = max(1e-3, wallEnd - wallStart);
+	cout << endl << "Trace summary (" << wall / 1000 << " ms wall, " << nextThread << " threads):" << endl;
+	cout << left << setw(8) << "kind" << setw(20) << "name" << right << setw(8) << "count";
+	cout << setw(12) << "total ms" << setw(12) << "mean ms" << setw(12) << "max ms" << setw(9) << "% wall" << endl;
+
+	ios_base::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << fixed << setprecision(3);
+	for (const TraceStats &row : rows) {
+		cout << left << setw(8) << row.category << setw(20) << row.name << right << setw(8) << row.count;
+		cout << setw(12) << row.total / 1000 << setw(12) << row.total / row.count / 1000 << setw(12) << row.max / 1000;
+		cout << setw(8) << setprecision(1) << row.total / wall * 100 << "%" << setprecision(3) << endl;
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
+
+void trace_finish()
+{
+	if (!TRACE_ENABLED) return;
+	TRACE_ENABLED = false;
+
+	trace_print_summary();
+	if (!outputPath.empty() && trace_write_chrome(outputPath.c_str())) cout << "Trace written to " << outputPath << endl;
+}
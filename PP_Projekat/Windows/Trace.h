@@ -0,0 +1,80 @@
+/*
+ * Trace.h
+ *
+ *  Built-in timing of pipeline stages and parallel tasks. A TraceScope
+ *  records the time between its construction and destruction into a
+ *  buffer of the calling thread; with tracing disabled it only tests a
+ *  flag. Recorded events are written as Chrome trace event JSON (open it
+ *  in chrome://tracing or ui.perfetto.dev) or summarized as a table.
+ *
+ *  Tracing is off by default. -trace FILE turns it on for a single run,
+ *  EDGE_TRACE=FILE for every mode, including the legacy command line and
+ *  batch mode; the trace is written and summarized at exit.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#define TRACE_STAGE				"stage"		// pipeline step on the calling thread
+#define TRACE_TASK				"task"		// tile, band or leaf task of a parallel engine
+
+#define TRACE_CONCAT_(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, category)	TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category)
+
+extern bool TRACE_ENABLED;
+
+/**
+* @brief Microseconds since tracing was enabled.
+*/
+double trace_now();
+
+/**
+* @brief Stores one event. name and category must outlive the trace (string literals).
+*/
+void trace_record(const char *name, const char *category, double start, double end);
+
+class TraceScope {
+public:
+	TraceScope(const char *name, const char *category) : name(name), category(category), start(TRACE_ENABLED ? trace_now() : -1) {}
+	~TraceScope() { if (start >= 0) trace_record(name, category, start, trace_now()); }
+
+private:
+	const char *name;
+	const char *category;
+	double start;
+};
+
+/**
+* @brief Enables tracing and restarts the clock, events recorded so far are
+* dropped. At exit the trace is written to path and summarized.
+*
+* @param path Chrome trace output, NULL only prints the summary
+*/
+void trace_start(const char *path);
+
+/**
+* @brief Calls trace_start with EDGE_TRACE if it is set.
+*/
+void trace_from_env();
+
+/**
+* @brief Writes all events as Chrome trace event JSON.
+*
+* @return false if path cannot be written
+*/
+bool trace_write_chrome(const char *path);
+
+/**
+* @brief Prints count, total, mean and maximum per event name. Task totals
+* are summed over threads, so they can exceed the wall time.
+*/
+void trace_print_summary();
+
+/**
+* @brief Writes the trace to the path given to trace_start and prints the
+* summary, then disables tracing. Does nothing when tracing is disabled.
+*/
+void trace_finish();
+
+#endif /* TRACE_H_ */
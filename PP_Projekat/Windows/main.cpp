@@ -1,292 +1,1050 @@
 #include <iostream>
+#include <stdio.h>
 #include <stdlib.h>
-#include <tbb/task_group.h>
+#include <string.h>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <memory>
 #include <tbb/tick_count.h>
+#include <tbb/global_control.h>
 #include "BitmapRawConverter.h"
+#include "EdgeFilters.h"
+#include "BatchProcessor.h"
+#include "SequenceProcessor.h"
+#include "GrayCodec.h"
+#include "AutoTuner.h"
+#include "NumaPlacement.h"
+#include "ImagePool.h"
+#include "ImageBuffer.h"
+#include "Benchmark.h"
+#include "ImageGenerator.h"
+#include "Scaling.h"
+#include "Trace.h"
+#include "Differential.h"
+#include "ShadowVerify.h"
+#include "Daemon.h"
+#include "EdgeEngine.h"
+#include "RegionOfInterest.h"
 
 #define __ARG_NUM__				8
-#define FILTER_SIZE				7
-#define THRESHOLD				128
-extern int CUTOFF = 200;
-extern int DISTANCE = 1;
 
 using namespace std;
 using namespace tbb;
 
 
-// Prewitt operators
-int filterHor[FILTER_SIZE * FILTER_SIZE] = {-1, 0, 1, -1, 0, 1, -1, 0, 1};
-int filterVer[FILTER_SIZE * FILTER_SIZE] = {-1, -1, -1, 0, 0, 0, 1, 1, 1};
+/**
+* @brief Function for running test.
+*
+* @param testNr test identification, 1: for serial version, 2: for parallel version
+* @param ioFile input/output file, firstly it's holding buffer from input image and than to hold filtered data
+* @param outFileName output file name
+* @param outBuffer buffer of output image
+* @param width image width
+* @param height image height
+*/
 
 
-/*
-* @brief checking if index is in range of matrix indices
-* 
-* @param index index that we need to chech
-* @param height image height
-* @param width image width
+void run_test_nr(int testNr, BitmapRawConverter* ioFile, char* outFileName, int* outBuffer, unsigned int width, unsigned int height)
+{
+	tick_count startCount = tick_count::now();
+	double traceStart = trace_now();
+
+	switch (testNr)
+	{
+		case 1:
+			cout << "Running serial version of edge detection using Prewitt operator" << endl;
+			filter_serial_prewitt(ioFile->getBuffer(), outBuffer, width, height);
+			break;
+		case 2:
+			cout << "Running parallel version of edge detection using Prewitt operator" << endl;
+			filter_parallel_prewitt(0, 0, width, height, ioFile->getBuffer(), outBuffer, width, height);
+			break;
+		case 3:
+			cout << "Running serial version of edge detection" << endl;
+			filter_serial_edge_detection(ioFile->getBuffer(), outBuffer, width, height);
+			break;
+		case 4:
+			cout << "Running parallel version of edge detection" << endl;
+			filter_parallel_edge_detection(ioFile->getBuffer(), outBuffer, width, height);
+			break;
+		default:
+			cout << "ERROR: invalid test case, must be 1, 2, 3 or 4!";
+			break;
+	}
+	tick_count endCount = tick_count::now();
+	if (TRACE_ENABLED) trace_record("filter", TRACE_STAGE, traceStart, trace_now());
+	cout << "Elapsed time: " << (endCount - startCount).seconds() * 1000 << " ms." << endl;
+
+	ioFile->setBuffer(outBuffer);
+	if (!ioFile->pixelsToFile(outFileName)) cout << "ERROR: cannot write " << outFileName << endl;
+}
+
+/**
+* @brief Print program usage.
 */
-bool check_if_border_case(int index, int height, int width) {
-	if ((index <= 0) || (index >= width * height)) return true;
-	return false;
+void usage()
+{
+	cout << "\nERROR: call program like: " << endl << endl;
+	cout << "ProjekatPP.exe [options] input.bmp output.bmp" << endl << endl;
+	cout << "  -op prewitt|edge        operator (default prewitt)" << endl;
+	cout << "  -engine NAME            serial, parallel, tiled, simd, simd-tiled, numa, simd-flat" << endl;
+	cout << "                          (default simd-tiled); simd-flat fills flat blocks without the kernel" << endl;
+	cout << "  -threads N              number of worker threads (default all cores)" << endl;
+	cout << "  -threshold T            Prewitt/edge threshold (default 128)" << endl;
+	cout << "  -kernel K               Prewitt kernel size, odd, up to " << MAX_FILTER_SIZE << " (default 7)" << endl;
+	cout << "  -distance D             edge detection window radius (default 1)" << endl;
+	cout << "  -cutoff C               task/tile size of parallel engines (default 200)" << endl;
+	cout << "  -format bmp|qog         output format (default from output extension)" << endl;
+	cout << "  -profile FILE           tuning profile (default " << TUNE_DEFAULT_PROFILE << "), used unless -cutoff is given" << endl;
+	cout << "  -stride auto|dense|N    row stride of image buffers in pixels (default auto: 64 byte" << endl;
+	cout << "                          aligned rows, padded when the row size is a multiple of 2 KB)" << endl;
+	cout << "  -hugepages              back large buffers with transparent huge pages" << endl;
+	cout << "  -trace trace.json       time stages and tasks, print a summary and write a Chrome trace" << endl;
+	cout << "  -shadow F               re-check fraction F of the output (e.g. 0.01) with the serial" << endl;
+	cout << "                          arithmetic on a background thread, count mismatches" << endl;
+	cout << "  -verify                 compare result with the serial version" << endl;
+	cout << "  -roi X,Y,WxH            filter only this rectangle (repeatable); the input is read only" << endl;
+	cout << "                          around the rectangles, the output is black elsewhere (simd-tiled only)" << endl;
+	cout << "  -crop                   with -roi, write only the bounding box of the rectangles" << endl << endl;
+	cout << "Auto-tuning (writes best CUTOFF / tile shape / tile order per image size class): " << endl << endl;
+	cout << "ProjekatPP.exe -tune [profile] [tiled|simd-tiled] [repetitions]" << endl << endl;
+	cout << "Benchmark (comma separated lists, sizes in MP, aspects as width/height): " << endl << endl;
+	cout << "ProjekatPP.exe -bench [-sizes 1,4,16] [-aspects 1,1.333] [-cutoffs 64,200] [-distances 1,2]" << endl;
+	cout << "    [-kernels 3,7] [-threads 1,N] [-engines all] [-ops prewitt,edge] [-reps 5] [-warmup 1]" << endl;
+	cout << "    [-reference 4] [-stride auto|dense|N] [-pattern mixed|edges|flat|noise|stripes|checker]" << endl;
+	cout << "    [-seed S] [-counters on|off] [-csv results.csv] [-json results.json]" << endl;
+	cout << "    -counters on adds cycles, instructions, L1D/LLC/dTLB and branch misses per pixel" << endl;
+	cout << "    (Linux perf_event_open, skipped when unavailable)" << endl << endl;
+	cout << "ProjekatPP.exe -bench-compare baseline.csv current.csv [tolerancePercent, default 10]" << endl << endl;
+	cout << "Strong / weak scaling (speedup, efficiency and serial fraction per thread count): " << endl << endl;
+	cout << "ProjekatPP.exe -scaling [-mode strong|weak|both] [-size 4] [-per-thread 1] [-aspect 1]" << endl;
+	cout << "    [-threads 1,2,4,N] [-engines parallel,tiled,simd-tiled,numa] [-ops prewitt,edge]" << endl;
+	cout << "    [-reps 5] [-warmup 1] [-stride auto|dense|N] [-pattern mixed] [-seed S] [-csv scaling.csv]" << endl << endl;
+	cout << "Differential test of engines against the serial version on random images and parameters: " << endl << endl;
+	cout << "ProjekatPP.exe -fuzz [-iterations 2000] [-seed S] [-max-side 300] [-max-failures 10]" << endl;
+	cout << "    [-engines all] [-ops prewitt,edge] [-paths dense,strided,edge-engine,view,regions,incremental]" << endl;
+	cout << "    [-minimize on|off]" << endl;
+	cout << "    [-case SEED]      rerun one reported case (with the same -engines/-ops/-paths)" << endl << endl;
+	cout << "Daemon on a Unix domain socket (warm workers and buffers, one request per line): " << endl << endl;
+	cout << "ProjekatPP.exe -daemon [socket, default " << DAEMON_DEFAULT_SOCKET << "] [-threads N] [-cutoff C]" << endl;
+	cout << "    [-kernel K] [-distance D] [-threshold T] [-outdir DIR, file outputs only below DIR, default .]" << endl;
+	cout << "ProjekatPP.exe -send socket JOB [id=ID] op=prewitt|edge input=FILE|GENSPEC [output=FILE|-]" << endl;
+	cout << "    [format=bmp|qog] [kernel=K] [distance=D] [threshold=T] [stream=NAME]" << endl;
+	cout << "    shared memory: input=shm:NAME width=W height=H [in_format=gray8|bgr24|bgra32|gray32]" << endl;
+	cout << "    [in_stride=BYTES] [in_offset=BYTES] output=shm:NAME [out_format=gray8|gray32] [out_stride=] [out_offset=]" << endl;
+	cout << "    stream=NAME: frames of one sequence, only tiles changed since its last frame are recomputed" << endl;
+	cout << "ProjekatPP.exe -send socket PING|STATS|SHUTDOWN|CLOSE stream=NAME" << endl << endl;
+	cout << "Comparison of all four versions: " << endl << endl;
+	cout << "ProjekatPP.exe";
+	cout << " input.bmp";
+	cout << " outputSerialPrewitt.bmp";
+	cout << " outputParallelPrewitt.bmp";
+	cout << " outputSerialEdge.bmp";
+	cout << " outputParallelEdge.bmp";
+	cout << " CUTOFF DISTANCE" << endl << endl;
+	cout << "Output files ending with .qog are written with the lossless QOG codec." << endl;
+	cout << "Inputs can be generated in memory instead of read: gen:PATTERN:WIDTHxHEIGHT[:SEED]," << endl;
+	cout << "e.g. gen:edges:4001x3001:7; output - discards the result." << endl << endl;
+	cout << "Batch mode: " << endl << endl;
+	cout << "ProjekatPP.exe -batch";
+	cout << " inputDirOrManifest";
+	cout << " outputDir";
+	cout << " prewitt|edge";
+	cout << " [bmp|qog] [maxInFlight] [CUTOFF] [DISTANCE]" << endl << endl;
+	cout << "Sequence mode (frames read, filtered and written in a pipeline, in order): " << endl << endl;
+	cout << "ProjekatPP.exe -sequence frameDir|video.y4m|luma.raw|-|GENSPEC [outputDir|out.y4m|out.raw|-]" << endl;
+	cout << "    [-op prewitt|edge] [-size WxH] [-frames N] [-tokens " << SEQUENCE_DEFAULT_TOKENS << "] [-threads N] [-threshold T]" << endl;
+	cout << "    [-kernel K] [-distance D] [-cutoff C] [-incremental on|off] [-times frames.csv]" << endl;
+	cout << "    - reads Y4M from stdin (raw luma with -size WxH) or writes Y4M to stdout;" << endl;
+	cout << "    only luma is filtered; -tokens bounds the frames in flight; -incremental on" << endl;
+	cout << "    recomputes only tiles changed since the previous frame; -times writes per frame ms" << endl << endl;
+	cout << "EDGE_HUGE_PAGES=1 enables transparent huge pages in every mode." << endl;
+	cout << "EDGE_TRACE=trace.json traces every mode like -trace." << endl;
+	cout << "EDGE_SHADOW=F shadow-verifies single runs, batch mode and benchmarks like -shadow." << endl << endl;
 }
 
+struct RunOptions {
+	char *input;
+	char *output;
+	int op;
+	int engine;
+	int threads;
+	int format;				// 0: from extension, 1: bmp, 2: qog
+	bool verify;
+	bool cutoffSet;
+	string profile;
+	vector<RoiRect> regions;	// -roi rectangles, empty for the whole image
+	bool crop;
+};
 
 /**
-* @brief Serial version of edge detection algorithm implementation using Prewitt operator
-* @param inBuffer buffer of input image
-* @param outBuffer buffer of output image
-* @param width image width
-* @param height image height
+* @brief Sets IMAGE_STRIDE from a -stride value: auto, dense or a pixel count.
+*
+* @return false for a value below IMAGE_STRIDE_AUTO
 */
+bool parse_stride(const char *value)
+{
+	if (strcmp(value, "auto") == 0) IMAGE_STRIDE = IMAGE_STRIDE_AUTO;
+	else if (strcmp(value, "dense") == 0) IMAGE_STRIDE = IMAGE_STRIDE_DENSE;
+	else IMAGE_STRIDE = atoi(value);
+	return IMAGE_STRIDE >= IMAGE_STRIDE_AUTO;
+}
+
+/**
+* @brief Parses single operator command line.
+*
+* @return false if arguments are invalid
+*/
+bool parse_run_options(int argc, char * argv[], RunOptions &options)
+{
+	int positional = 0;
+
+	options.input = NULL;
+	options.output = NULL;
+	options.op = OP_PREWITT;
+	options.engine = ENGINE_SIMD_TILED;
+	options.threads = 0;
+	options.format = 0;
+	options.verify = false;
+	options.cutoffSet = false;
+	options.profile = tuner_profile_path();
+	options.regions.clear();
+	options.crop = false;
+
+	for (int k = 1; k < argc; k++)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+
+		if (strcmp(arg, "-verify") == 0)
+		{
+			options.verify = true;
+			continue;
+		}
+		if (strcmp(arg, "-hugepages") == 0)
+		{
+			pool_set_huge_pages(true);
+			continue;
+		}
+		if (strcmp(arg, "-crop") == 0)
+		{
+			options.crop = true;
+			continue;
+		}
+		if (arg[0] != '-' || arg[1] == 0)
+		{
+			if (positional == 0) options.input = arg;
+			else if (positional == 1) options.output = arg;
+			else return false;
+			positional++;
+			continue;
+		}
+		if (value == NULL) return false;
+		k++;
 
-void filter_serial_prewitt(int *inBuffer, int *outBuffer, int width, int height) 
+		if (strcmp(arg, "-op") == 0)
+		{
+			if (strcmp(value, "prewitt") == 0) options.op = OP_PREWITT;
+			else if (strcmp(value, "edge") == 0) options.op = OP_EDGE;
+			else return false;
+		}
+		else if (strcmp(arg, "-engine") == 0)
+		{
+			options.engine = engine_from_name(value);
+			if (options.engine < 0) return false;
+		}
+		else if (strcmp(arg, "-threads") == 0) options.threads = atoi(value);
+		else if (strcmp(arg, "-stride") == 0)
+		{
+			if (!parse_stride(value)) return false;
+		}
+		else if (strcmp(arg, "-threshold") == 0) THRESHOLD = atoi(value);
+		else if (strcmp(arg, "-kernel") == 0)
+		{
+			FILTER_SIZE = atoi(value);
+			if (FILTER_SIZE < 1 || FILTER_SIZE > MAX_FILTER_SIZE || FILTER_SIZE % 2 == 0) return false;
+		}
+		else if (strcmp(arg, "-distance") == 0)
+		{
+			DISTANCE = atoi(value);
+			if (DISTANCE < 0 || 2 * DISTANCE + 1 > MAX_FILTER_SIZE) return false;
+		}
+		else if (strcmp(arg, "-cutoff") == 0)
+		{
+			CUTOFF = atoi(value);
+			if (CUTOFF < 1) return false;
+			options.cutoffSet = true;
+		}
+		else if (strcmp(arg, "-profile") == 0) options.profile = value;
+		else if (strcmp(arg, "-roi") == 0)
+		{
+			RoiRect rect;
+			if (!roi_parse(value, rect)) return false;
+			options.regions.push_back(rect);
+		}
+		else if (strcmp(arg, "-trace") == 0) trace_start(value);
+		else if (strcmp(arg, "-shadow") == 0)
+		{
+			double fraction = atof(value);
+			if (fraction <= 0 || fraction > 1) return false;
+			shadow_start(fraction);
+		}
+		else if (strcmp(arg, "-format") == 0)
+		{
+			if (strcmp(value, "bmp") == 0) options.format = 1;
+			else if (strcmp(value, "qog") == 0) options.format = 2;
+			else return false;
+		}
+		else return false;
+	}
+
+	if (options.crop && options.regions.empty()) return false;
+	// rectangles run on an EdgeEngine, i.e. the simd-tiled kernels, another -engine would be ignored
+	if (!options.regions.empty() && options.engine != ENGINE_SIMD_TILED) return false;
+	return options.input != NULL && options.output != NULL;
+}
+
+/**
+* @brief Runs exactly one operator with one engine. Input is decoded once,
+* the serial reference is computed only when verification is requested.
+*
+* @param options parsed command line
+*/
+int run_single(RunOptions &options)
 {
-	int offset = (FILTER_SIZE - 1) / 2;
-
-	for (int i = 0; i < width; i++) { 
-		for (int j = 0; j < height; j++) {
-			int Gx = 0, Gy = 0, G = 0;
-			
-			for (int m = 0; m < FILTER_SIZE; m++) {
-				for (int n = 0; n < FILTER_SIZE; n++) {
-					int index = (j - offset + m) * width + (i - offset + n);
-					if (check_if_border_case(index, height, width)) continue;
-					Gx += inBuffer[index] * filterHor[m * FILTER_SIZE + n]; 
-					Gy += inBuffer[index] * filterVer[m * FILTER_SIZE + n];
+	unique_ptr<global_control> threadLimit;
+	if (options.threads > 0)
+	{
+		threadLimit.reset(new global_control(global_control::max_allowed_parallelism, options.threads));
+	}
+
+	BitmapRawConverter ioFile(options.input);
+	if (!ioFile.isLoaded())
+	{
+		cout << "ERROR: cannot decode " << options.input << endl;
+		return 1;
+	}
+	int width = ioFile.getWidth();
+	int height = ioFile.getHeight();
+	size_t pixels = (size_t)width * height;
+
+	TuneProfile profile;
+	if (!options.cutoffSet && tuner_load_profile(options.profile.c_str(), options.engine, profile) && tuner_apply(profile, pixels))
+	{
+		cout << "Tuned CUTOFF=" << CUTOFF << ", aspect=" << TILE_ASPECT << ", order=" << TILE_ORDER << endl;
+	}
+
+	vector<int> reference;
+	vector<int> referenceInput;
+
+	// edge detection thresholds its input in place, reference needs the original
+	if (options.verify) referenceInput.assign(ioFile.getBuffer(), ioFile.getBuffer() + pixels);
+
+	cout << "Running " << (options.op == OP_PREWITT ? "Prewitt" : "edge detection");
+	cout << " with " << engine_name(options.engine) << " engine" << endl;
+
+	// filters run on cache line aligned, padded rows, see -stride
+	ImageBuffer inImage, outImage;
+	ImageBufferGuard inGuard(inImage), outGuard(outImage);
+	if (!image_buffer_alloc(inImage, width, height) || !image_buffer_alloc(outImage, width, height))
+	{
+		cout << "ERROR: cannot allocate " << width << "x" << height << " image." << endl;
+		return 1;
+	}
+	int* outBuffer = numa_alloc_image(width, height);
+	if (outBuffer == NULL)
+	{
+		cout << "ERROR: cannot allocate " << width << "x" << height << " image." << endl;
+		return 1;
+	}
+	{
+		TRACE_SCOPE("load buffer", TRACE_STAGE);
+		image_buffer_load(inImage, ioFile.getBuffer());
+	}
+	if (inImage.stride != width) cout << "Row stride: " << inImage.stride << " pixels" << endl;
+
+	tick_count startCount = tick_count::now();
+	long long flatPixels;
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		flatPixels = image_filter(options.op, options.engine, inImage, outImage);
+	}
+	tick_count endCount = tick_count::now();
+	cout << "Elapsed time: " << (endCount - startCount).seconds() * 1000 << " ms." << endl;
+	if (options.engine == ENGINE_SIMD_FLAT) cout << "Flat blocks: " << flatPixels * 100.0 / pixels << " % of the pixels." << endl;
+
+	{
+		TRACE_SCOPE("store buffer", TRACE_STAGE);
+		image_buffer_store(outImage, outBuffer);
+	}
+	image_buffer_free(inImage);
+	image_buffer_free(outImage);
+
+	int result = 0;
+	if (options.verify)
+	{
+		TRACE_SCOPE("verify", TRACE_STAGE);
+		reference.resize(pixels);
+		if (options.op == OP_PREWITT) filter_serial_prewitt(&referenceInput[0], &reference[0], width, height);
+		else filter_serial_edge_detection(&referenceInput[0], &reference[0], width, height);
+
+		cout << "Verification: ";
+		if (memcmp(outBuffer, &reference[0], pixels * sizeof(int)) != 0)
+		{
+			cout << "FAIL!" << endl;
+			result = 1;
+		}
+		else
+		{
+			cout << "PASS." << endl;
+		}
+	}
+
+	// "-" keeps the whole run in memory, e.g. throughput tests on generated input
+	if (strcmp(options.output, "-") != 0)
+	{
+		ioFile.setBuffer(outBuffer);
+		bool written;
+		if (options.format == 1) written = ioFile.pixelsToBitmap(options.output);
+		else if (options.format == 2) written = ioFile.pixelsToCodec(options.output);
+		else written = ioFile.pixelsToFile(options.output);
+		if (!written)
+		{
+			cout << "ERROR: cannot write " << options.output << endl;
+			result = 1;
+		}
+	}
+
+	numa_free_image(outBuffer, width, height);
+
+	return result;
+}
+
+/**
+* @brief Runs one operator on the -roi rectangles only, with an EdgeEngine (SIMD
+* kernels, the only -engine accepted with -roi is simd-tiled). The output is the whole image, black outside
+* the rectangles, or with -crop their bounding box.
+*
+* @param options parsed command line
+*/
+int run_regions(RunOptions &options)
+{
+	BitmapRawConverter ioFile(options.input);
+	if (!ioFile.isLoaded())
+	{
+		cout << "ERROR: cannot decode " << options.input << endl;
+		return 1;
+	}
+	int width = ioFile.getWidth();
+	int height = ioFile.getHeight();
+	size_t pixels = (size_t)width * height;
+
+	TuneProfile profile;
+	// regions run on an EdgeEngine, whose tiles are those of simd-tiled
+	if (!options.cutoffSet && tuner_load_profile(options.profile.c_str(), ENGINE_SIMD_TILED, profile) && tuner_apply(profile, pixels))
+	{
+		cout << "Tuned CUTOFF=" << CUTOFF << ", aspect=" << TILE_ASPECT << ", order=" << TILE_ORDER << endl;
+	}
+
+	vector<RoiRect> regions, pieces;
+	for (size_t k = 0; k < options.regions.size(); k++)
+	{
+		RoiRect rect = options.regions[k];
+		if (roi_clip(rect, width, height)) regions.push_back(rect);
+	}
+	if (regions.empty())
+	{
+		cout << "ERROR: no rectangle of interest inside the " << width << "x" << height << " image." << endl;
+		return 1;
+	}
+	roi_disjoint(&regions[0], (int)regions.size(), pieces);
+
+	long long area = 0;
+	for (size_t k = 0; k < pieces.size(); k++) area += roi_area(pieces[k]);
+	cout << "Running " << (options.op == OP_PREWITT ? "Prewitt" : "edge detection") << " on " << regions.size();
+	cout << " rectangles, " << area << " of " << pixels << " pixels (" << 100.0 * area / pixels << "%)" << endl;
+
+	RoiRect bounds = options.crop ? roi_bounds(&regions[0], (int)regions.size()) : RoiRect{0, 0, width, height};
+	int outWidth = bounds.x1 - bounds.x0, outHeight = bounds.y1 - bounds.y0;
+	vector<int> output((size_t)outWidth * outHeight, 0);
+
+	EdgeEngine engine(options.threads > 0 ? options.threads : task_arena::automatic);
+	ImageView<const int> in(ioFile.getBuffer(), width, height);
+
+	tick_count startCount = tick_count::now();
+	{
+		TRACE_SCOPE("filter", TRACE_STAGE);
+		engine.runRegions(options.op, in, ImageView<int>(&output[0], outWidth, outHeight), bounds.x0, bounds.y0,
+			&regions[0], (int)regions.size(), THRESHOLD);
+	}
+	tick_count endCount = tick_count::now();
+	cout << "Elapsed time: " << (endCount - startCount).seconds() * 1000 << " ms." << endl;
+
+	int result = 0;
+	if (options.verify)
+	{
+		TRACE_SCOPE("verify", TRACE_STAGE);
+		vector<int> referenceInput(ioFile.getBuffer(), ioFile.getBuffer() + pixels), reference(pixels);
+		if (options.op == OP_PREWITT) filter_serial_prewitt(&referenceInput[0], &reference[0], width, height);
+		else filter_serial_edge_detection(&referenceInput[0], &reference[0], width, height);
+
+		bool equal = true;
+		for (size_t k = 0; k < pieces.size() && equal; k++)
+		{
+			for (int j = pieces[k].y0; j < pieces[k].y1 && equal; j++)
+			{
+				for (int i = pieces[k].x0; i < pieces[k].x1 && equal; i++)
+				{
+					equal = reference[(size_t)j * width + i] == output[(size_t)(j - bounds.y0) * outWidth + i - bounds.x0];
 				}
 			}
-			G = abs(Gx) + abs(Gy);
+		}
+		cout << "Verification: " << (equal ? "PASS." : "FAIL!") << endl;
+		if (!equal) result = 1;
+	}
 
-			// transferring to black or white color
-			if (G >= THRESHOLD) outBuffer[j * width + i] = 255;
-			else outBuffer[j * width + i] = 0;
-			
+	if (strcmp(options.output, "-") != 0)
+	{
+		if (!ioFile.bufferToFile(options.output, &output[0], outWidth, outHeight, options.format))
+		{
+			cout << "ERROR: cannot write " << options.output << endl;
+			result = 1;
 		}
 	}
+
+	return result;
 }
 
+/**
+* @brief Runs auto-tuning and stores the result in a profile file.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-tune"
+*/
+int run_tune(int argc, char * argv[])
+{
+	TuneProfile profile;
+	string path = argc > 2 ? argv[2] : tuner_profile_path();
+	int engine = argc > 3 ? engine_from_name(argv[3]) : ENGINE_SIMD_TILED;
+	int repetitions = argc > 4 ? atoi(argv[4]) : 3;
+
+	if (engine != ENGINE_TILED && engine != ENGINE_SIMD_TILED)
+	{
+		usage();
+		return 0;
+	}
+
+	cout << "Tuning " << engine_name(engine) << " engine on " << tuner_cpu_model() << endl;
+	tuner_run(profile, engine, repetitions);
+
+	if (!tuner_save_profile(path.c_str(), profile)) return 1;
+	cout << "Profile written to " << path << endl;
+
+	return 0;
+}
 
 /**
-* @brief Parallel version of edge detection algorithm implementation using Prewitt operator
-* 
-* @param inBuffer buffer of input image
-* @param outBuffer buffer of output image
-* @param width image width
-* @param height image height
+* @brief Parses comma separated list of numbers (or engine / operator names).
+*
+* @return false if list is empty or holds an unknown name
 */
+template <typename T>
+bool parse_list(const char *text, vector<T> &values, T (*parse)(const string &))
+{
+	stringstream ss(text);
+	string item;
 
+	values.clear();
+	while (getline(ss, item, ','))
+	{
+		T value = parse(item);
+		if (value < 0) return false;
+		values.push_back(value);
+	}
+	return !values.empty();
+}
 
-void filter_parallel_prewitt(int row, int col, int width, int height, int *inBuffer, int *outBuffer, int _width, int _height)
+static int parse_int(const string &item) { return atoi(item.c_str()); }
+static double parse_double(const string &item) { return atof(item.c_str()); }
+static int parse_engine(const string &item) { return engine_from_name(item.c_str()); }
+static int parse_op(const string &item) { return item == "prewitt" ? OP_PREWITT : item == "edge" ? OP_EDGE : -1; }
+static int parse_path(const string &item) { return item == "dense" ? DIFF_PATH_DENSE : item == "strided" ? DIFF_PATH_STRIDED : item == "edge-engine" ? DIFF_PATH_ENGINE : item == "view" ? DIFF_PATH_VIEW : item == "regions" ? DIFF_PATH_REGIONS : item == "incremental" ? DIFF_PATH_INCREMENTAL : -1; }
+
+/**
+* @brief Runs benchmark sweep, optionally writing CSV / JSON results.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-bench"
+*/
+int run_bench(int argc, char * argv[])
 {
-	int offset = (FILTER_SIZE - 1) / 2;
-
-	if (width <= CUTOFF || height <= CUTOFF) {
-		for (int i = 0; i < width; i++) {
-			for (int j = 0; j < height; j++) {
-				int Gx = 0, Gy = 0, G = 0;
-
-				for (int m = 0; m < FILTER_SIZE; m++) {
-					for (int n = 0; n < FILTER_SIZE; n++) {
-						int index = (j + m + col - offset) * _width + (i + n + row - offset);
-						if(check_if_border_case(index, _height, _width)) continue;
-						Gx += inBuffer[index] * filterHor[m * FILTER_SIZE + n];
-						Gy += inBuffer[index] * filterVer[m * FILTER_SIZE + n];
-					}
-				}
-				G = abs(Gx) + abs(Gy);
+	BenchConfig config;
+	const char *csvPath = NULL;
+	const char *jsonPath = NULL;
+	bench_default_config(config);
 
-				// transferring to black or white color
-				if (G >= THRESHOLD) outBuffer[(j + col) * _width + i + row] = 255;
-				else outBuffer[(j + col) * _width + i + row] = 0;
-			}
+	for (int k = 2; k < argc; k += 2)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+		bool ok = true;
+
+		if (value == NULL) ok = false;
+		else if (strcmp(arg, "-sizes") == 0) ok = parse_list(value, config.megapixels, parse_double);
+		else if (strcmp(arg, "-aspects") == 0) ok = parse_list(value, config.aspects, parse_double);
+		else if (strcmp(arg, "-cutoffs") == 0) ok = parse_list(value, config.cutoffs, parse_int);
+		else if (strcmp(arg, "-distances") == 0) ok = parse_list(value, config.distances, parse_int);
+		else if (strcmp(arg, "-kernels") == 0) ok = parse_list(value, config.kernels, parse_int);
+		else if (strcmp(arg, "-threads") == 0) ok = parse_list(value, config.threads, parse_int);
+		else if (strcmp(arg, "-engines") == 0) ok = parse_list(value, config.engines, parse_engine);
+		else if (strcmp(arg, "-ops") == 0) ok = parse_list(value, config.ops, parse_op);
+		else if (strcmp(arg, "-reps") == 0) config.repetitions = max(1, atoi(value));
+		else if (strcmp(arg, "-warmup") == 0) config.warmup = max(0, atoi(value));
+		else if (strcmp(arg, "-reference") == 0) config.referenceMegapixels = atof(value);
+		else if (strcmp(arg, "-pattern") == 0) ok = (config.pattern = generator_pattern_from_name(value)) >= 0;
+		else if (strcmp(arg, "-seed") == 0) config.seed = strtoull(value, NULL, 10);
+		else if (strcmp(arg, "-stride") == 0) ok = parse_stride(value);
+		else if (strcmp(arg, "-csv") == 0) csvPath = value;
+		else if (strcmp(arg, "-json") == 0) jsonPath = value;
+		else if (strcmp(arg, "-counters") == 0)
+		{
+			config.counters = strcmp(value, "on") == 0;
+			ok = config.counters || strcmp(value, "off") == 0;
+		}
+		else ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 0;
 		}
 	}
-	else {
-		task_group t;
-		t.run([&] {filter_parallel_prewitt(row, col, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.run([&] {filter_parallel_prewitt(row + width / 2 , col, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.run([&] {filter_parallel_prewitt(row, col + height / 2, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.run([&] {filter_parallel_prewitt(row + width / 2, col + height / 2, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.wait();
+
+	for (int kernel : config.kernels)
+	{
+		if (kernel < 1 || kernel > MAX_FILTER_SIZE || kernel % 2 == 0)
+		{
+			usage();
+			return 0;
+		}
 	}
+	for (int distance : config.distances)
+	{
+		if (2 * distance + 1 > MAX_FILTER_SIZE)
+		{
+			usage();
+			return 0;
+		}
+	}
+
+	cout << "Benchmark on " << tuner_cpu_model() << endl;
+	vector<BenchResult> results;
+	bench_run(config, results);
+	bench_print_counters(results);
+
+	if (csvPath != NULL && !bench_write_csv(csvPath, results)) return 1;
+	if (jsonPath != NULL && !bench_write_json(jsonPath, config, results)) return 1;
+	return 0;
 }
 
 /**
-* @brief Serial version of edge detection algorithm
-* 
-* @param inBuffer buffer of input image
-* @param outBuffer buffer of output image
-* @param width image width
-* @param height image height
+* @brief Runs strong and / or weak scaling sweep and prints the summary.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-scaling"
 */
-void filter_serial_edge_detection(int *inBuffer, int *outBuffer, int width, int height)	//TODO obrisati
+int run_scaling(int argc, char * argv[])
 {
-	int iter = DISTANCE * 2 + 1;
+	ScalingConfig config;
+	const char *csvPath = NULL;
+	scaling_default_config(config);
+
+	for (int k = 2; k < argc; k += 2)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+		bool ok = true;
 
-	// setting every element to 0 or 1, depending on threshold
-	for (int i = 0; i < width; i++) {
-		for (int j = 0; j < height; j++) {
-			int index = j * width + i;
-			if (inBuffer[index] >= THRESHOLD) inBuffer[index] = 0;
-			else inBuffer[index] = 1;
+		if (value == NULL) ok = false;
+		else if (strcmp(arg, "-mode") == 0)
+		{
+			config.strong = strcmp(value, "weak") != 0;
+			config.weak = strcmp(value, "strong") != 0;
+			ok = strcmp(value, "strong") == 0 || strcmp(value, "weak") == 0 || strcmp(value, "both") == 0;
+		}
+		else if (strcmp(arg, "-size") == 0) ok = (config.strongMegapixels = atof(value)) > 0;
+		else if (strcmp(arg, "-per-thread") == 0) ok = (config.weakMegapixels = atof(value)) > 0;
+		else if (strcmp(arg, "-aspect") == 0) ok = (config.aspect = atof(value)) > 0;
+		else if (strcmp(arg, "-threads") == 0) ok = parse_list(value, config.threads, parse_int);
+		else if (strcmp(arg, "-engines") == 0) ok = parse_list(value, config.engines, parse_engine);
+		else if (strcmp(arg, "-ops") == 0) ok = parse_list(value, config.ops, parse_op);
+		else if (strcmp(arg, "-reps") == 0) config.repetitions = max(1, atoi(value));
+		else if (strcmp(arg, "-warmup") == 0) config.warmup = max(0, atoi(value));
+		else if (strcmp(arg, "-pattern") == 0) ok = (config.pattern = generator_pattern_from_name(value)) >= 0;
+		else if (strcmp(arg, "-seed") == 0) config.seed = strtoull(value, NULL, 10);
+		else if (strcmp(arg, "-stride") == 0) ok = parse_stride(value);
+		else if (strcmp(arg, "-csv") == 0) csvPath = value;
+		else ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 0;
 		}
 	}
 
-	for (int i = 0; i < width ; i++) {
-		for (int j = 0; j < height; j++) {
-			int P = 0, O = 1, G = 0;
+	cout << "Scaling on " << tuner_cpu_model() << endl;
+	vector<ScalingPoint> points;
+	scaling_run(config, points);
+	scaling_print_summary(points);
 
-			for (int m = 0; m < iter; m++) {
-				for (int n = 0; n < iter; n++) {
-					int index = (j - DISTANCE + m) * width + (i - DISTANCE + n);
-					if (check_if_border_case(index, height, width)) continue;
-					if (m == 0 && n == 0) continue;
-					if (inBuffer[index] == 1) P = 1;
-					else if (inBuffer[index] == 0) O = 0;
-				}
-			}
+	if (csvPath != NULL && !scaling_write_csv(csvPath, points)) return 1;
+	return 0;
+}
 
-			G = abs(P) - abs(O);
-			if (G == 0) outBuffer[j * width + i] = 0;
-			else outBuffer[j * width + i] = 255;
+/**
+* @brief Runs randomized differential tests of the engines against the serial version.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-fuzz"
+* @return 1 if any case failed
+*/
+int run_fuzz(int argc, char * argv[])
+{
+	DiffConfig config;
+	bool single = false;
+	unsigned long long caseSeed = 0;
+	diff_default_config(config);
+
+	for (int k = 2; k < argc; k += 2)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+		bool ok = true;
+
+		if (value == NULL) ok = false;
+		else if (strcmp(arg, "-iterations") == 0) ok = (config.iterations = atoi(value)) > 0;
+		else if (strcmp(arg, "-seed") == 0) config.seed = strtoull(value, NULL, 10);
+		else if (strcmp(arg, "-max-side") == 0) ok = (config.maxSide = atoi(value)) > 0;
+		else if (strcmp(arg, "-max-failures") == 0) ok = (config.maxFailures = atoi(value)) > 0;
+		else if (strcmp(arg, "-engines") == 0) ok = parse_list(value, config.engines, parse_engine);
+		else if (strcmp(arg, "-ops") == 0) ok = parse_list(value, config.ops, parse_op);
+		else if (strcmp(arg, "-paths") == 0) ok = parse_list(value, config.paths, parse_path);
+		else if (strcmp(arg, "-minimize") == 0)
+		{
+			config.minimize = strcmp(value, "on") == 0;
+			ok = config.minimize || strcmp(value, "off") == 0;
+		}
+		else if (strcmp(arg, "-case") == 0)
+		{
+			single = true;
+			caseSeed = strtoull(value, NULL, 10);
+		}
+		else ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 0;
 		}
 	}
+
+	if (!single) return diff_run(config) > 0 ? 1 : 0;
+
+	DiffCase c = diff_random_case(config, caseSeed);
+	diff_print_case(c);
+	if (diff_check(c, true))
+	{
+		cout << "PASS." << endl;
+		return 0;
+	}
+	if (config.minimize)
+	{
+		cout << "Minimized to:" << endl;
+		DiffCase small = diff_minimize(c);
+		diff_print_case(small);
+		diff_check(small, true);
+	}
+	cout << "FAIL!" << endl;
+	return 1;
 }
 
-/*
-* @brief parallel version of edge detecion algorithm
-* 
-* @param row row in submatrix 
-* @param col col in submatrix
-* @param width image width
-* @param height image height
-* @param inBuffer buffer of input image
-* @param outBuffer buffer of output image
-* @param _height height of submatrix
-* @param _width width of submatrix
+/**
+* @brief Serves jobs on a Unix domain socket until a client sends SHUTDOWN.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-daemon"
 */
+int run_daemon(int argc, char * argv[])
+{
+	const char *socketPath = DAEMON_DEFAULT_SOCKET;
+	const char *outputDir = NULL;
+	unique_ptr<global_control> threadLimit;
+	int k = 2;
 
-void next_iter_parallel_edge_detection(int row, int col, int width, int height, int* inBuffer, int* outBuffer, int _width, int _height) {
-	int iter = DISTANCE * 2 + 1;
-	
-	if (width <= CUTOFF || height <= CUTOFF) {
-		for (int i = 0; i < width; i++) {
-			for (int j = 0; j < height; j++) {
-				int P = 0, O = 1, G = 0;
-
-				for (int m = 0; m < iter; m++) {
-					for (int n = 0; n < iter; n++) {
-						int index = (j + n + col - DISTANCE) * _width + (i + m + row - DISTANCE);
-						if (check_if_border_case(index, _height, _width)) continue;
-						if (m == 0 && n == 0) continue;
-						if (inBuffer[index] == 1) P = 1;
-						else if (inBuffer[index] == 0) O = 0;
-					}
-				}
+	if (argc > 2 && argv[2][0] != '-') socketPath = argv[k++];
+	for (; k < argc; k += 2)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+		bool ok = true;
 
-				G = abs(P) - abs(O);
-				if (G == 0) outBuffer[(j + col) * _width + i + row] = 0;
-				else outBuffer[(j + col) * _width + i + row] = 255;
-			}
+		if (value == NULL) ok = false;
+		else if (strcmp(arg, "-threads") == 0) ok = atoi(value) > 0;
+		else if (strcmp(arg, "-cutoff") == 0) ok = (CUTOFF = atoi(value)) > 0;
+		else if (strcmp(arg, "-kernel") == 0) ok = (FILTER_SIZE = atoi(value)) >= 1 && FILTER_SIZE <= MAX_FILTER_SIZE && FILTER_SIZE % 2 == 1;
+		else if (strcmp(arg, "-distance") == 0) ok = (DISTANCE = atoi(value)) >= 0 && 2 * DISTANCE + 1 <= MAX_FILTER_SIZE;
+		else if (strcmp(arg, "-threshold") == 0) THRESHOLD = atoi(value);
+		else if (strcmp(arg, "-outdir") == 0) outputDir = value;
+		else ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 0;
+		}
+		if (strcmp(arg, "-threads") == 0)
+		{
+			threadLimit.reset(new global_control(global_control::max_allowed_parallelism, atoi(value)));
 		}
 	}
-	else {
-		task_group t;
-		t.run([&] {next_iter_parallel_edge_detection(row, col, width / 2, height / 2, inBuffer, outBuffer, _width,_height); });
-		t.run([&] {next_iter_parallel_edge_detection(row + width / 2, col, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.run([&] {next_iter_parallel_edge_detection(row, col + height / 2, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.run([&] {next_iter_parallel_edge_detection(row + width / 2, col + height / 2, width / 2, height / 2, inBuffer, outBuffer, _width, _height); });
-		t.wait();
+
+	return daemon_run(socketPath, outputDir);
+}
+
+/**
+* @brief Sends one request line to a running daemon and prints the reply.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-send"
+* @return 1 if the daemon cannot be reached or the reply is an error
+*/
+int run_send(int argc, char * argv[])
+{
+	if (argc < 4)
+	{
+		usage();
+		return 0;
+	}
+
+	string request = argv[3];
+	for (int k = 4; k < argc; k++) request += string(" ") + argv[k];
+
+	string reply;
+	if (!daemon_send(argv[2], request, reply))
+	{
+		cout << "ERROR: cannot reach daemon on " << argv[2] << endl;
+		return 1;
 	}
+	cout << reply << endl;
+	return reply.compare(0, 3, "ERR") == 0 ? 1 : 0;
 }
 
 /**
-* @brief Parallel version of edge detection algorithm
-* 
-* @param inBuffer buffer of input image
-* @param outBuffer buffer of output image
-* @param width image width
-* @param height image height
+* @brief Compares benchmark CSV against a baseline CSV.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-bench-compare"
+* @return 1 if any point is slower than the tolerance allows
 */
-void filter_parallel_edge_detection(int *inBuffer, int *outBuffer, int width, int height)
+int run_bench_compare(int argc, char * argv[])
 {
-	for (int i = 0; i < width; i++) {
-		for (int j = 0; j < height; j++) {
-			int index = j * width + i;
-			if (inBuffer[index] >= THRESHOLD) inBuffer[index] = 0;
-			else inBuffer[index] = 1;
-		}
+	if (argc < 4 || argc > 5)
+	{
+		usage();
+		return 0;
 	}
-	next_iter_parallel_edge_detection(0, 0, width, height, inBuffer, outBuffer, width, height);
+
+	vector<BenchResult> baseline, current;
+	double tolerance = argc > 4 ? atof(argv[4]) / 100 : 0.1;
+	if (!bench_read_csv(argv[2], baseline) || !bench_read_csv(argv[3], current)) return 2;
+
+	return bench_compare(baseline, current, tolerance) > 0 ? 1 : 0;
 }
 
 /**
-* @brief Function for running test.
+* @brief Runs batch mode over a directory or a manifest of images.
 *
-* @param testNr test identification, 1: for serial version, 2: for parallel version
-* @param ioFile input/output file, firstly it's holding buffer from input image and than to hold filtered data
-* @param outFileName output file name
-* @param outBuffer buffer of output image
-* @param width image width
-* @param height image height
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-batch"
 */
+int run_batch(int argc, char * argv[])
+{
+	BatchOptions options;
+	vector<BatchJob> jobs;
+	BatchReport report;
 
+	if (argc < 5 || argc > 9)
+	{
+		usage();
+		return 0;
+	}
 
-void run_test_nr(int testNr, BitmapRawConverter* ioFile, char* outFileName, int* outBuffer, unsigned int width, unsigned int height)
+	batch_default_options(options);
+	options.input = argv[2];
+	options.outputDir = argv[3];
+	options.op = strcmp(argv[4], "edge") == 0 ? OP_EDGE : OP_PREWITT;
+	if (argc > 5) options.extension = strcmp(argv[5], "qog") == 0 ? ".qog" : ".bmp";
+	if (argc > 6) options.maxInFlight = atoi(argv[6]);
+	if (argc > 7) CUTOFF = atoi(argv[7]);
+	if (argc > 8) DISTANCE = atoi(argv[8]);
+	if (CUTOFF < 1 || DISTANCE < 0 || 2 * DISTANCE + 1 > MAX_FILTER_SIZE)
+	{
+		usage();
+		return 0;
+	}
+
+	if (!batch_collect_jobs(options, jobs)) return 1;
+
+	batch_run(options, jobs, report);
+	batch_print_report(report);
+
+	return report.failed ? 1 : 0;
+}
+
+/**
+* @brief Filters a frame sequence and reports frame rate and latency.
+*
+* @param argc number of arguments
+* @param argv arguments, argv[1] is "-sequence"
+*/
+int run_sequence(int argc, char * argv[])
 {
-	tick_count startCount = tick_count::now();
+	SequenceOptions options;
+	SequenceReport report;
+	const char *timesPath = NULL;
+	unique_ptr<global_control> threadLimit;
+	int k = 3;
 
-	switch (testNr)
+	if (argc < 3)
 	{
-		case 1:
-			cout << "Running serial version of edge detection using Prewitt operator" << endl;
-			filter_serial_prewitt(ioFile->getBuffer(), outBuffer, width, height);
-			break;
-		case 2:
-			cout << "Running parallel version of edge detection using Prewitt operator" << endl;
-			filter_parallel_prewitt(0, 0, width, height, ioFile->getBuffer(), outBuffer, width, height);
-			break;
-		case 3:
-			cout << "Running serial version of edge detection" << endl;
-			filter_serial_edge_detection(ioFile->getBuffer(), outBuffer, width, height);
-			break;
-		case 4:
-			cout << "Running parallel version of edge detection" << endl;
-			filter_parallel_edge_detection(ioFile->getBuffer(), outBuffer, width, height);
-			break;
-		default:
-			cout << "ERROR: invalid test case, must be 1, 2, 3 or 4!";
-			break;
+		usage();
+		return 0;
 	}
-	tick_count endCount = tick_count::now();
-	cout << "Elapsed time: " << (endCount - startCount).seconds() * 1000 << " ms." << endl;
 
-	ioFile->setBuffer(outBuffer);
-	ioFile->pixelsToBitmap(outFileName);
+	sequence_default_options(options);
+	options.input = argv[2];
+	if (argc > 3 && (argv[3][0] != '-' || argv[3][1] == 0)) options.output = argv[k++];
+	for (; k < argc; k += 2)
+	{
+		char *arg = argv[k];
+		char *value = k + 1 < argc ? argv[k + 1] : NULL;
+		bool ok = true;
+
+		if (value == NULL) ok = false;
+		else if (strcmp(arg, "-op") == 0) ok = (options.op = parse_op(value)) >= 0;
+		else if (strcmp(arg, "-size") == 0) ok = sscanf(value, "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+		else if (strcmp(arg, "-frames") == 0) ok = (options.frames = atoi(value)) > 0;
+		else if (strcmp(arg, "-tokens") == 0) ok = (options.tokens = atoi(value)) > 0;
+		else if (strcmp(arg, "-threads") == 0) ok = atoi(value) > 0;
+		else if (strcmp(arg, "-threshold") == 0) THRESHOLD = atoi(value);
+		else if (strcmp(arg, "-kernel") == 0) ok = (FILTER_SIZE = atoi(value)) >= 1 && FILTER_SIZE <= MAX_FILTER_SIZE && FILTER_SIZE % 2 == 1;
+		else if (strcmp(arg, "-distance") == 0) ok = (DISTANCE = atoi(value)) >= 0 && 2 * DISTANCE + 1 <= MAX_FILTER_SIZE;
+		else if (strcmp(arg, "-cutoff") == 0) ok = (CUTOFF = atoi(value)) > 0;
+		else if (strcmp(arg, "-times") == 0) timesPath = value;
+		else if (strcmp(arg, "-incremental") == 0)
+		{
+			options.incremental = strcmp(value, "on") == 0;
+			ok = options.incremental || strcmp(value, "off") == 0;
+		}
+		else ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 0;
+		}
+		if (strcmp(arg, "-threads") == 0)
+		{
+			threadLimit.reset(new global_control(global_control::max_allowed_parallelism, atoi(value)));
+		}
+	}
+
+	bool ok = sequence_run(options, report);
+	// with frames on stdout the report goes to stderr
+	if (report.frames + report.failed > 0) sequence_print_report(report, options.output == "-" ? cerr : cout);
+	if (timesPath != NULL && !sequence_write_times(report, timesPath))
+	{
+		cerr << "ERROR: cannot write " << timesPath << endl;
+		ok = false;
+	}
+
+	return ok ? 0 : 1;
 }
 
 /**
-* @brief Print program usage.
+* @brief Legacy command line is exactly seven positional arguments, none of them an option.
 */
-void usage()
+bool is_legacy_command_line(int argc, char * argv[])
 {
-	cout << "\n\ERROR: call program like: " << endl << endl; 
-	cout << "ProjekatPP.exe";
-	cout << " input.bmp";
-	cout << " outputSerialPrewitt.bmp";
-	cout << " outputParallelPrewitt.bmp";
-	cout << " outputSerialEdge.bmp";
-	cout << " outputParallelEdge.bmp" << endl << endl;
+	if (argc != __ARG_NUM__) return false;
+	for (int k = 1; k < argc; k++)
+	{
+		if (argv[k][0] == '-') return false;
+	}
+	return true;
 }
 
 int main(int argc, char * argv[])
 {
+	trace_from_env();
+	shadow_from_env();
 
-	if(argc != __ARG_NUM__)
+	if (argc >= 2 && strcmp(argv[1], "-batch") == 0)
 	{
-		usage();
-		return 0;
+		return run_batch(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-sequence") == 0)
+	{
+		return run_sequence(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-tune") == 0)
+	{
+		return run_tune(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-bench") == 0)
+	{
+		return run_bench(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-bench-compare") == 0)
+	{
+		return run_bench_compare(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-scaling") == 0)
+	{
+		return run_scaling(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-fuzz") == 0)
+	{
+		return run_fuzz(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-daemon") == 0)
+	{
+		return run_daemon(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "-send") == 0)
+	{
+		return run_send(argc, argv);
+	}
+
+	if (!is_legacy_command_line(argc, argv))
+	{
+		RunOptions options;
+		if (!parse_run_options(argc, argv, options))
+		{
+			usage();
+			return 0;
+		}
+		return options.regions.empty() ? run_single(options) : run_regions(options);
 	}
 
 	CUTOFF = atoi(argv[6]);
@@ -305,14 +1063,14 @@ int main(int argc, char * argv[])
 	width = inputFile.getWidth();
 	height = inputFile.getHeight();
 
-	int* outBufferSerialPrewitt = new int[width * height];
-	int* outBufferParallelPrewitt = new int[width * height];
+	int* outBufferSerialPrewitt = pool_alloc_image(width, height);
+	int* outBufferParallelPrewitt = pool_alloc_image(width, height);
 
 	memset(outBufferSerialPrewitt, 0x0, width * height * sizeof(int));
 	memset(outBufferParallelPrewitt, 0x0, width * height * sizeof(int));
 
-	int* outBufferSerialEdge = new int[width * height];
-	int* outBufferParallelEdge = new int[width * height];
+	int* outBufferSerialEdge = pool_alloc_image(width, height);
+	int* outBufferParallelEdge = pool_alloc_image(width, height);
 
 	memset(outBufferSerialEdge, 0x0, width * height * sizeof(int));
 	memset(outBufferParallelEdge, 0x0, width * height * sizeof(int));
@@ -354,11 +1112,11 @@ int main(int argc, char * argv[])
 	}
 
 	// clean up
-	delete outBufferSerialPrewitt;
-	delete outBufferParallelPrewitt;
+	pool_free_image(outBufferSerialPrewitt, width, height);
+	pool_free_image(outBufferParallelPrewitt, width, height);
 
-	delete outBufferSerialEdge;
-	delete outBufferParallelEdge;
+	pool_free_image(outBufferSerialEdge, width, height);
+	pool_free_image(outBufferParallelEdge, width, height);
 
 	return 0;
 } 
\ No newline at end of file